@@ -0,0 +1,118 @@
+/**
+ * @file alert_limiter.c
+ * @brief Token-bucket rate limiter for alerts, one bucket per alert class
+ */
+
+#include "alert_limiter.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "alert_limiter";
+
+// The level is kept as earned time rather than tokens: refill_ms of credit
+// is one alert, and a full bucket holds burst * refill_ms. That keeps the
+// refill exact in integer arithmetic.
+typedef struct {
+    alert_budget_t budget;
+    uint64_t credit_ms;
+    int64_t last_ms;
+    alert_limiter_stats_t stats;
+} bucket_t;
+
+static bucket_t s_buckets[ALERT_CLASS_COUNT];
+static bool s_initialized = false;
+
+esp_err_t alert_limiter_init(const alert_budget_t budgets[ALERT_CLASS_COUNT])
+{
+    for (int i = 0; i < ALERT_CLASS_COUNT; i++) {
+        if (budgets[i].burst > 0 && budgets[i].refill_ms == 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    memset(s_buckets, 0, sizeof(s_buckets));
+    for (int i = 0; i < ALERT_CLASS_COUNT; i++) {
+        s_buckets[i].budget = budgets[i];
+        s_buckets[i].credit_ms = (uint64_t)budgets[i].burst * budgets[i].refill_ms;
+        s_buckets[i].last_ms = -1;
+        ESP_LOGI(TAG, "%s alerts: burst of %u, then one per %lu ms", alert_class_name(i),
+                 budgets[i].burst, (unsigned long)budgets[i].refill_ms);
+    }
+    s_initialized = true;
+
+    return ESP_OK;
+}
+
+static bucket_t *refill(alert_class_t alert_class, int64_t now_ms)
+{
+    if (!s_initialized || alert_class < 0 || alert_class >= ALERT_CLASS_COUNT) {
+        return NULL;
+    }
+
+    bucket_t *b = &s_buckets[alert_class];
+    const uint64_t full = (uint64_t)b->budget.burst * b->budget.refill_ms;
+
+    if (b->last_ms >= 0 && now_ms > b->last_ms) {
+        b->credit_ms += (uint64_t)(now_ms - b->last_ms);
+    }
+    b->credit_ms = b->credit_ms < full ? b->credit_ms : full;
+    b->last_ms = now_ms;
+    return b;
+}
+
+bool alert_limiter_take(alert_class_t alert_class, int64_t now_ms)
+{
+    bucket_t *b = refill(alert_class, now_ms);
+
+    // Without a configuration nothing is limited
+    if (!b) {
+        return !s_initialized;
+    }
+
+    if (b->budget.burst > 0 && b->credit_ms >= b->budget.refill_ms) {
+        b->credit_ms -= b->budget.refill_ms;
+        b->stats.allowed++;
+        return true;
+    }
+
+    b->stats.suppressed++;
+    return false;
+}
+
+void alert_limiter_record_suppressed(alert_class_t alert_class)
+{
+    if (s_initialized && alert_class >= 0 && alert_class < ALERT_CLASS_COUNT) {
+        s_buckets[alert_class].stats.suppressed++;
+    }
+}
+
+uint32_t alert_limiter_wait_ms(alert_class_t alert_class, int64_t now_ms)
+{
+    bucket_t *b = refill(alert_class, now_ms);
+
+    if (!b) {
+        return 0;
+    }
+    if (b->budget.burst == 0) {
+        return UINT32_MAX;
+    }
+    return b->credit_ms >= b->budget.refill_ms ? 0 : (uint32_t)(b->budget.refill_ms - b->credit_ms);
+}
+
+void alert_limiter_get_stats(alert_class_t alert_class, alert_limiter_stats_t *stats)
+{
+    if (alert_class >= 0 && alert_class < ALERT_CLASS_COUNT) {
+        *stats = s_buckets[alert_class].stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+const char *alert_class_name(alert_class_t alert_class)
+{
+    switch (alert_class) {
+        case ALERT_CLASS_MOTION: return "motion";
+        case ALERT_CLASS_FACE:   return "face";
+        default:                 return "unknown";
+    }
+}
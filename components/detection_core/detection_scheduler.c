@@ -0,0 +1,161 @@
+/**
+ * @file detection_scheduler.c
+ * @brief Activity-driven capture rate and face detection policy
+ */
+
+#include "detection_scheduler.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "scheduler";
+
+// Weight of the newest frame in the smoothed change percentage
+#define CHANGE_AVG_ALPHA 0.25f
+
+static scheduler_config_t s_config = {
+    .min_interval_ms = 500,
+    .base_interval_ms = 500,
+    .max_interval_ms = 500,
+    .backoff_percent = 200,
+    .activity_threshold = 2.5f,
+    .face_policy = FACE_POLICY_ALWAYS,
+    .face_hold_ms = 0,
+};
+
+// Written only by the updating task; the interval is a single aligned word,
+// so readers on other tasks always see a whole value
+static scheduler_stats_t s_stats = {
+    .interval_ms = 500,
+};
+static float s_last_change = 0.0f;
+static int64_t s_last_motion_ms = -1;
+
+esp_err_t detection_scheduler_init(const scheduler_config_t *config)
+{
+    if (!config ||
+        config->min_interval_ms > config->base_interval_ms ||
+        config->base_interval_ms > config->max_interval_ms ||
+        config->backoff_percent <= 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_config = *config;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.interval_ms = config->base_interval_ms;
+    s_stats.last_decision = SCHEDULER_DECISION_NONE;
+    s_last_change = 0.0f;
+    s_last_motion_ms = -1;
+
+    ESP_LOGI(TAG, "Scheduler initialized: interval %lu..%lu..%lu ms, backoff %lu%%, face policy %d",
+             (unsigned long)config->min_interval_ms, (unsigned long)config->base_interval_ms,
+             (unsigned long)config->max_interval_ms, (unsigned long)config->backoff_percent,
+             config->face_policy);
+
+    return ESP_OK;
+}
+
+void detection_scheduler_update(float change_percentage, bool motion_detected, int64_t now_ms)
+{
+    uint32_t interval = s_stats.interval_ms;
+    scheduler_decision_t decision;
+
+    s_stats.frames++;
+    s_stats.change_avg += CHANGE_AVG_ALPHA * (change_percentage - s_stats.change_avg);
+
+    if (motion_detected) {
+        s_last_motion_ms = now_ms;
+    }
+
+    bool active = motion_detected || change_percentage >= s_config.activity_threshold;
+
+    if (active && change_percentage > s_last_change) {
+        // Something is moving into the scene: drop straight back from any
+        // back-off to the base rate, then sample faster
+        decision = SCHEDULER_DECISION_SPEED_UP;
+        if (interval > s_config.base_interval_ms) {
+            interval = s_config.base_interval_ms;
+        }
+        interval /= 2;
+        if (interval < s_config.min_interval_ms) {
+            interval = s_config.min_interval_ms;
+        }
+        s_stats.speed_ups++;
+    } else if (active) {
+        decision = SCHEDULER_DECISION_HOLD;
+        if (interval > s_config.base_interval_ms) {
+            interval = s_config.base_interval_ms;
+        }
+        s_stats.holds++;
+    } else {
+        // Static scene: back off exponentially towards the slowest rate
+        decision = SCHEDULER_DECISION_BACK_OFF;
+        uint64_t grown = (uint64_t)interval * s_config.backoff_percent / 100;
+        if (grown <= interval) {
+            grown = interval + 1;
+        }
+        interval = grown > s_config.max_interval_ms ? s_config.max_interval_ms : (uint32_t)grown;
+        s_stats.backoffs++;
+    }
+
+    if (interval != s_stats.interval_ms) {
+        ESP_LOGD(TAG, "Interval %lu -> %lu ms (%s, change %.1f%%)",
+                 (unsigned long)s_stats.interval_ms, (unsigned long)interval,
+                 detection_scheduler_decision_name(decision), change_percentage);
+    }
+
+    s_stats.interval_ms = interval;
+    s_stats.last_decision = decision;
+    s_last_change = change_percentage;
+}
+
+bool detection_scheduler_face_due(bool motion_detected, int64_t now_ms)
+{
+    bool due;
+
+    switch (s_config.face_policy) {
+        case FACE_POLICY_ON_MOTION:
+            due = motion_detected;
+            break;
+
+        case FACE_POLICY_AFTER_MOTION:
+            if (motion_detected) {
+                s_last_motion_ms = now_ms;
+            }
+            due = s_last_motion_ms >= 0 &&
+                  now_ms - s_last_motion_ms <= (int64_t)s_config.face_hold_ms;
+            break;
+
+        case FACE_POLICY_ALWAYS:
+        default:
+            due = true;
+            break;
+    }
+
+    if (due) {
+        s_stats.face_runs++;
+    } else {
+        s_stats.face_skips++;
+    }
+    return due;
+}
+
+uint32_t detection_scheduler_interval_ms(void)
+{
+    return s_stats.interval_ms;
+}
+
+void detection_scheduler_get_stats(scheduler_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+const char *detection_scheduler_decision_name(scheduler_decision_t decision)
+{
+    switch (decision) {
+        case SCHEDULER_DECISION_SPEED_UP: return "speed-up";
+        case SCHEDULER_DECISION_HOLD:     return "hold";
+        case SCHEDULER_DECISION_BACK_OFF: return "back-off";
+        case SCHEDULER_DECISION_NONE:
+        default:                          return "none";
+    }
+}
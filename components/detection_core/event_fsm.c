@@ -0,0 +1,149 @@
+/**
+ * @file event_fsm.c
+ * @brief Event state machine that turns per-frame detections into events
+ */
+
+#include "event_fsm.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "event_fsm";
+
+static event_fsm_config_t s_config = {
+    .confirm_frames = 1,
+    .window_frames = 1,
+    .min_duration_ms = 0,
+    .end_quiet_ms = 0,
+    .cooldown_ms = 0,
+};
+
+static event_state_t s_state = EVENT_STATE_IDLE;
+static uint32_t s_window = 0;          // Bit i set: frame i updates ago triggered
+static int64_t s_candidate_ms = 0;     // First trigger of the candidate
+static int64_t s_last_trigger_ms = 0;
+static uint32_t s_next_id = 1;
+static event_info_t s_event;
+
+static inline int popcount32(uint32_t v)
+{
+    int n = 0;
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+esp_err_t event_fsm_init(const event_fsm_config_t *config)
+{
+    if (!config || config->confirm_frames == 0 ||
+        config->confirm_frames > config->window_frames ||
+        config->window_frames > EVENT_FSM_MAX_WINDOW) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_config = *config;
+    s_state = EVENT_STATE_IDLE;
+    s_window = 0;
+    memset(&s_event, 0, sizeof(s_event));
+
+    ESP_LOGI(TAG, "Events: %u of %u frames, min %lu ms, end after %lu ms quiet, cooldown %lu ms",
+             config->confirm_frames, config->window_frames,
+             (unsigned long)config->min_duration_ms, (unsigned long)config->end_quiet_ms,
+             (unsigned long)config->cooldown_ms);
+
+    return ESP_OK;
+}
+
+static void extend_event(bool motion, bool face, int64_t now_ms)
+{
+    s_last_trigger_ms = now_ms;
+    s_event.duration_ms = (uint32_t)(now_ms - s_event.start_ms);
+    s_event.trigger_frames++;
+    s_event.motion |= motion;
+    s_event.face |= face;
+}
+
+event_action_t event_fsm_update(bool motion, bool face, int64_t now_ms, event_info_t *event)
+{
+    const bool trigger = motion || face;
+    const uint32_t window_mask = s_config.window_frames >= 32 ? UINT32_MAX :
+                                 (1u << s_config.window_frames) - 1;
+    event_action_t action = EVENT_ACTION_NONE;
+
+    s_window = ((s_window << 1) | trigger) & window_mask;
+
+    if (s_state == EVENT_STATE_IDLE && trigger) {
+        s_state = EVENT_STATE_CANDIDATE;
+        s_candidate_ms = now_ms;
+        memset(&s_event, 0, sizeof(s_event));
+        s_event.start_ms = now_ms;
+    }
+
+    switch (s_state) {
+        case EVENT_STATE_IDLE:
+            break;
+
+        case EVENT_STATE_CANDIDATE:
+            if (trigger) {
+                extend_event(motion, face, now_ms);
+            }
+            if (s_window == 0) {
+                ESP_LOGD(TAG, "Candidate dropped after %lu frame(s)",
+                         (unsigned long)s_event.trigger_frames);
+                s_state = EVENT_STATE_IDLE;
+            } else if (popcount32(s_window) >= s_config.confirm_frames &&
+                       now_ms - s_candidate_ms >= (int64_t)s_config.min_duration_ms) {
+                s_state = EVENT_STATE_ACTIVE;
+                s_event.id = s_next_id++;
+                action = EVENT_ACTION_START;
+                ESP_LOGI(TAG, "Event #%lu started", (unsigned long)s_event.id);
+            }
+            break;
+
+        case EVENT_STATE_ACTIVE:
+            if (trigger) {
+                extend_event(motion, face, now_ms);
+            } else if (now_ms - s_last_trigger_ms >= (int64_t)s_config.end_quiet_ms) {
+                s_state = EVENT_STATE_COOLDOWN;
+            }
+            break;
+
+        case EVENT_STATE_COOLDOWN:
+            if (trigger) {
+                // Consecutive triggers merge into the same event
+                s_state = EVENT_STATE_ACTIVE;
+                extend_event(motion, face, now_ms);
+            } else if (now_ms - s_last_trigger_ms >= (int64_t)s_config.end_quiet_ms +
+                                                     (int64_t)s_config.cooldown_ms) {
+                s_state = EVENT_STATE_IDLE;
+                s_window = 0;
+                action = EVENT_ACTION_END;
+                ESP_LOGI(TAG, "Event #%lu ended after %lu ms, %lu frame(s)",
+                         (unsigned long)s_event.id, (unsigned long)s_event.duration_ms,
+                         (unsigned long)s_event.trigger_frames);
+            }
+            break;
+    }
+
+    if (event) {
+        *event = s_event;
+    }
+    return action;
+}
+
+event_state_t event_fsm_state(void)
+{
+    return s_state;
+}
+
+const char *event_fsm_state_name(event_state_t state)
+{
+    switch (state) {
+        case EVENT_STATE_CANDIDATE: return "candidate";
+        case EVENT_STATE_ACTIVE:    return "active";
+        case EVENT_STATE_COOLDOWN:  return "cooldown";
+        case EVENT_STATE_IDLE:
+        default:                    return "idle";
+    }
+}
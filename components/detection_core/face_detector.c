@@ -0,0 +1,610 @@
+/**
+ * @file face_detector.c
+ * @brief Face detection implementation
+ * 
+ * A two-step cascade: skin-toned windows (and regions the caller flags, such
+ * as motion) are proposed cheaply from a summed-area table, then only those
+ * regions, with some context around them, are cropped and passed to the face
+ * network in face_model_*.c. Faces found in several regions are merged.
+ */
+
+#include "face_detector.h"
+#include "skin_lut.h"
+#include "face_model.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "face_detector";
+
+static bool s_initialized = false;
+static int s_min_face_size = 48;
+
+// Skin classification bitmap, one bit per RGB565 value. Kept in internal RAM:
+// it is read once for every pixel of every frame. Pixels are always read low
+// byte first; for frames stored high byte first the table is byte-swapped
+// instead, so the lookup costs the same either way.
+static skin_lut_t *s_skin_lut = NULL;
+static bool s_big_endian = false;
+
+#define MAX_PROPOSALS 16          // Skin windows plus caller regions per frame
+#define ROI_MARGIN_PERCENT 25     // Context added on each side of a proposal
+#define ROI_FULL_FRAME_PERCENT 60 // Regions covering more of the frame run on the whole frame
+#define RESULT_IOU_PERCENT 30     // Faces from different regions overlapping more are merged
+
+/**
+ * @brief Region the network runs on and the proposals inside it
+ */
+typedef struct {
+    face_box_t area;
+    face_box_t hints[MAX_PROPOSALS];
+    int hint_count;
+} face_roi_t;
+
+// Crop buffer for regions, grown to the largest region seen
+static uint8_t *s_roi_buf = NULL;
+static size_t s_roi_capacity = 0;
+
+static face_detector_stats_t s_stats;
+
+esp_err_t face_detector_init(void)
+{
+    if (s_initialized) {
+        return ESP_OK;
+    }
+    
+    ESP_LOGI(TAG, "Initializing face detector...");
+    
+    s_skin_lut = heap_caps_malloc(sizeof(skin_lut_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_skin_lut) {
+        s_skin_lut = heap_caps_malloc(sizeof(skin_lut_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (!s_skin_lut) {
+        ESP_LOGE(TAG, "Failed to allocate skin table");
+        return ESP_ERR_NO_MEM;
+    }
+    skin_lut_build(s_skin_lut, skin_model_rgb, &SKIN_RGB_DEFAULT);
+    if (s_big_endian) {
+        skin_lut_swap_bytes(s_skin_lut);
+    }
+    
+    esp_err_t ret = face_model_init();
+    if (ret != ESP_OK) {
+        heap_caps_free(s_skin_lut);
+        s_skin_lut = NULL;
+        return ret;
+    }
+    
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_initialized = true;
+    ESP_LOGI(TAG, "Face detector initialized (%s)", face_model_name());
+    
+    return ESP_OK;
+}
+
+esp_err_t face_detector_set_skin_model(skin_model_fn model, const void *params)
+{
+    if (!model) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_skin_lut) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint32_t skin_values = skin_lut_build(s_skin_lut, model, params);
+    if (s_big_endian) {
+        skin_lut_swap_bytes(s_skin_lut);
+    }
+    ESP_LOGI(TAG, "Skin table rebuilt: %lu of 65536 colours are skin", (unsigned long)skin_values);
+    
+    return ESP_OK;
+}
+
+void face_detector_set_byte_order(bool big_endian)
+{
+    if (s_skin_lut && big_endian != s_big_endian) {
+        skin_lut_swap_bytes(s_skin_lut);
+    }
+    s_big_endian = big_endian;
+}
+
+// Skin pixels are counted per CELL_SIZE x CELL_SIZE cell and accumulated into
+// a summed-area table, so the skin count of any window of cells is four loads
+#define CELL_SIZE 8
+#define SKIN_WINDOW_MIN_PERCENT 50  // Share of skin pixels that makes a window a candidate
+#define WINDOW_SCALE_STEP 1.25f     // Ratio between successive window sizes
+#define MAX_WINDOW_SIZES 16
+
+// Persistent summed-area table, (grid_w + 1) x (grid_h + 1) entries. Grows
+// with the frame size and is only freed by face_detector_deinit().
+static uint32_t *s_skin_sat = NULL;
+static size_t s_skin_sat_capacity = 0;
+
+static int count_skin_cell(const uint8_t *rgb565_data, int width, int x0, int y0)
+{
+    const skin_lut_t *lut = s_skin_lut;
+    int skin_count = 0;
+    
+    for (int y = y0; y < y0 + CELL_SIZE; y++) {
+        const uint8_t *p = rgb565_data + ((size_t)y * width + x0) * 2;
+        for (int x = 0; x < CELL_SIZE; x++, p += 2) {
+            uint16_t pixel = (p[1] << 8) | p[0];
+            skin_count += skin_lut_test(lut, pixel);
+        }
+    }
+    
+    return skin_count;
+}
+
+/**
+ * @brief Build the summed-area table of per-cell skin pixel counts
+ *
+ * Entry (gx, gy) holds the number of skin pixels in all cells above and to
+ * the left of cell (gx, gy); row 0 and column 0 are zero.
+ */
+static bool build_skin_sat(const uint8_t *rgb565_data, int width, int grid_w, int grid_h)
+{
+    size_t stride = grid_w + 1;
+    size_t needed = stride * (grid_h + 1);
+    
+    if (needed > s_skin_sat_capacity) {
+        heap_caps_free(s_skin_sat);
+        s_skin_sat = heap_caps_malloc(needed * sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!s_skin_sat) {
+            s_skin_sat = heap_caps_malloc(needed * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+        if (!s_skin_sat) {
+            ESP_LOGE(TAG, "Failed to allocate skin table");
+            s_skin_sat_capacity = 0;
+            return false;
+        }
+        s_skin_sat_capacity = needed;
+    }
+    
+    memset(s_skin_sat, 0, stride * sizeof(uint32_t));
+    
+    for (int gy = 0; gy < grid_h; gy++) {
+        uint32_t *row = s_skin_sat + (gy + 1) * stride;
+        const uint32_t *above = row - stride;
+        uint32_t row_sum = 0;
+        
+        row[0] = 0;
+        for (int gx = 0; gx < grid_w; gx++) {
+            row_sum += count_skin_cell(rgb565_data, width, gx * CELL_SIZE, gy * CELL_SIZE);
+            row[gx + 1] = above[gx + 1] + row_sum;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * @brief Skin pixels in the cell rectangle [gx0, gx1) x [gy0, gy1)
+ */
+static inline uint32_t skin_in_cells(size_t stride, int gx0, int gy0, int gx1, int gy1)
+{
+    const uint32_t *top = s_skin_sat + gy0 * stride;
+    const uint32_t *bottom = s_skin_sat + gy1 * stride;
+    return bottom[gx1] - bottom[gx0] - top[gx1] + top[gx0];
+}
+
+/**
+ * @brief Skin pixels of a window not already claimed by accepted faces
+ *
+ * Boxes are cell-aligned, so each overlap is an exact table lookup. This
+ * stops a smaller window from being accepted on the edge of a face that
+ * was already found.
+ */
+static uint32_t unclaimed_skin(size_t stride, const face_box_t *box,
+                               const face_box_t *faces, int face_count)
+{
+    int gx0 = box->x / CELL_SIZE, gy0 = box->y / CELL_SIZE;
+    int gx1 = (box->x + box->w) / CELL_SIZE, gy1 = (box->y + box->h) / CELL_SIZE;
+    int64_t skin = skin_in_cells(stride, gx0, gy0, gx1, gy1);
+    
+    for (int i = 0; i < face_count; i++) {
+        int fx0 = faces[i].x / CELL_SIZE, fy0 = faces[i].y / CELL_SIZE;
+        int fx1 = (faces[i].x + faces[i].w) / CELL_SIZE, fy1 = (faces[i].y + faces[i].h) / CELL_SIZE;
+        int ix0 = gx0 > fx0 ? gx0 : fx0, iy0 = gy0 > fy0 ? gy0 : fy0;
+        int ix1 = gx1 < fx1 ? gx1 : fx1, iy1 = gy1 < fy1 ? gy1 : fy1;
+        
+        if (ix0 < ix1 && iy0 < iy1) {
+            skin -= skin_in_cells(stride, ix0, iy0, ix1, iy1);
+        }
+    }
+    
+    return skin > 0 ? (uint32_t)skin : 0;
+}
+
+/**
+ * @brief Find potential face regions using skin tone detection
+ *
+ * Square windows from the largest that fits down to the minimum face size
+ * are tested at every cell position; a window is a candidate when at least
+ * SKIN_WINDOW_MIN_PERCENT of its pixels are skin-toned. Larger windows are
+ * searched first, and skin already inside an accepted face does not count
+ * towards later candidates.
+ */
+static int find_skin_regions(const uint8_t *rgb565_data, int width, int height,
+                             face_box_t *faces, int max_faces)
+{
+    if (!rgb565_data || !faces) {
+        return 0;
+    }
+    
+    int grid_w = width / CELL_SIZE;
+    int grid_h = height / CELL_SIZE;
+    if (grid_w == 0 || grid_h == 0) {
+        return 0;
+    }
+    
+    if (!build_skin_sat(rgb565_data, width, grid_w, grid_h)) {
+        return 0;
+    }
+    
+    int min_cells = (s_min_face_size + CELL_SIZE - 1) / CELL_SIZE;
+    if (min_cells < 2) {
+        min_cells = 2;
+    }
+    int max_cells = grid_w < grid_h ? grid_w : grid_h;
+    
+    int sizes[MAX_WINDOW_SIZES];
+    int size_count = 0;
+    for (int cells = max_cells; cells >= min_cells && size_count < MAX_WINDOW_SIZES; ) {
+        sizes[size_count++] = cells;
+        int next = (int)(cells / WINDOW_SCALE_STEP);
+        cells = next < cells ? next : cells - 1;
+    }
+    
+    size_t stride = grid_w + 1;
+    int face_count = 0;
+    
+    for (int s = 0; s < size_count && face_count < max_faces; s++) {
+        int cells = sizes[s];
+        uint32_t needed = (uint32_t)cells * cells * CELL_SIZE * CELL_SIZE * SKIN_WINDOW_MIN_PERCENT / 100;
+        
+        for (int gy = 0; gy + cells <= grid_h && face_count < max_faces; gy++) {
+            for (int gx = 0; gx + cells <= grid_w && face_count < max_faces; gx++) {
+                if (skin_in_cells(stride, gx, gy, gx + cells, gy + cells) < needed) {
+                    continue;
+                }
+                
+                face_box_t box = {
+                    .x = gx * CELL_SIZE,
+                    .y = gy * CELL_SIZE,
+                    .w = cells * CELL_SIZE,
+                    .h = cells * CELL_SIZE,
+                    .score = (float)skin_in_cells(stride, gx, gy, gx + cells, gy + cells) /
+                             (cells * cells * CELL_SIZE * CELL_SIZE),
+                };
+                
+                if (face_count == 0 || unclaimed_skin(stride, &box, faces, face_count) >= needed) {
+                    faces[face_count++] = box;
+                }
+            }
+        }
+    }
+    
+    return face_count;
+}
+
+/**
+ * @brief Skin share of a region in frame pixels, from the current table
+ */
+static float region_skin_share(const face_box_t *box, int grid_w, int grid_h)
+{
+    int gx0 = box->x / CELL_SIZE, gy0 = box->y / CELL_SIZE;
+    int gx1 = (box->x + box->w + CELL_SIZE - 1) / CELL_SIZE;
+    int gy1 = (box->y + box->h + CELL_SIZE - 1) / CELL_SIZE;
+    
+    if (gx1 > grid_w) gx1 = grid_w;
+    if (gy1 > grid_h) gy1 = grid_h;
+    if (!s_skin_sat || gx0 >= gx1 || gy0 >= gy1) {
+        return 0.0f;
+    }
+    
+    uint32_t cells = (uint32_t)(gx1 - gx0) * (gy1 - gy0);
+    return (float)skin_in_cells(grid_w + 1, gx0, gy0, gx1, gy1) / (cells * CELL_SIZE * CELL_SIZE);
+}
+
+static bool clip_box(face_box_t *box, int width, int height)
+{
+    int x1 = box->x + box->w, y1 = box->y + box->h;
+    
+    if (box->x < 0) box->x = 0;
+    if (box->y < 0) box->y = 0;
+    if (x1 > width) x1 = width;
+    if (y1 > height) y1 = height;
+    box->w = x1 - box->x;
+    box->h = y1 - box->y;
+    
+    return box->w > 0 && box->h > 0;
+}
+
+static int64_t intersection_area(const face_box_t *a, const face_box_t *b)
+{
+    int ix = (a->x + a->w < b->x + b->w ? a->x + a->w : b->x + b->w) - (a->x > b->x ? a->x : b->x);
+    int iy = (a->y + a->h < b->y + b->h ? a->y + a->h : b->y + b->h) - (a->y > b->y ? a->y : b->y);
+    
+    return (ix > 0 && iy > 0) ? (int64_t)ix * iy : 0;
+}
+
+static void union_box(face_box_t *a, const face_box_t *b)
+{
+    int x1 = a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+    int y1 = a->y + a->h > b->y + b->h ? a->y + a->h : b->y + b->h;
+    
+    a->x = a->x < b->x ? a->x : b->x;
+    a->y = a->y < b->y ? a->y : b->y;
+    a->w = x1 - a->x;
+    a->h = y1 - a->y;
+}
+
+/**
+ * @brief Turn proposals into regions: add context, clip, merge overlaps
+ * @return Number of regions
+ */
+static int build_rois(const face_box_t *proposals, int count, int width, int height, face_roi_t *rois)
+{
+    int roi_count = 0;
+    
+    for (int i = 0; i < count; i++) {
+        face_box_t area = proposals[i];
+        int mx = area.w * ROI_MARGIN_PERCENT / 100;
+        int my = area.h * ROI_MARGIN_PERCENT / 100;
+        
+        area.x -= mx;
+        area.y -= my;
+        area.w += 2 * mx;
+        area.h += 2 * my;
+        if (!clip_box(&area, width, height)) {
+            continue;
+        }
+        
+        rois[roi_count].area = area;
+        rois[roi_count].hints[0] = proposals[i];
+        rois[roi_count].hint_count = 1;
+        roi_count++;
+    }
+    
+    // Overlapping regions would run the network twice over the same pixels
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < roi_count && !merged; i++) {
+            for (int j = i + 1; j < roi_count; j++) {
+                if (intersection_area(&rois[i].area, &rois[j].area) == 0) {
+                    continue;
+                }
+                
+                union_box(&rois[i].area, &rois[j].area);
+                for (int h = 0; h < rois[j].hint_count; h++) {
+                    rois[i].hints[rois[i].hint_count++] = rois[j].hints[h];
+                }
+                rois[j] = rois[--roi_count];
+                merged = true;
+                break;
+            }
+        }
+    }
+    
+    return roi_count;
+}
+
+/**
+ * @brief Copy a region of the frame into the crop buffer
+ */
+static const uint8_t *crop_region(const camera_fb_t *fb, const face_box_t *area)
+{
+    size_t row_bytes = (size_t)area->w * 2;
+    size_t needed = row_bytes * area->h;
+    
+    if (needed > s_roi_capacity) {
+        heap_caps_free(s_roi_buf);
+        s_roi_buf = heap_caps_malloc(needed, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!s_roi_buf) {
+            s_roi_buf = heap_caps_malloc(needed, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (!s_roi_buf) {
+            ESP_LOGE(TAG, "Failed to allocate %u byte region buffer", needed);
+            s_roi_capacity = 0;
+            return NULL;
+        }
+        s_roi_capacity = needed;
+    }
+    
+    const uint8_t *src = fb->buf + ((size_t)area->y * fb->width + area->x) * 2;
+    for (int y = 0; y < area->h; y++) {
+        memcpy(s_roi_buf + y * row_bytes, src + (size_t)y * fb->width * 2, row_bytes);
+    }
+    
+    return s_roi_buf;
+}
+
+/**
+ * @brief Add a face to the result, merging it with an overlapping one
+ *
+ * Faces are kept sorted by score; when the storage is full, the lowest
+ * score is dropped.
+ */
+static void add_face(face_result_t *result, const face_t *face)
+{
+    const face_box_t *box = &face->box;
+    int64_t area = (int64_t)box->w * box->h;
+    
+    for (int i = 0; i < result->count; i++) {
+        const face_box_t *other = &result->faces[i].box;
+        int64_t inter = intersection_area(box, other);
+        int64_t uni = area + (int64_t)other->w * other->h - inter;
+        
+        if (inter * 100 > uni * RESULT_IOU_PERCENT) {
+            if (box->score <= other->score) {
+                return;
+            }
+            // Replace, then restore the order below
+            memmove(&result->faces[i], &result->faces[i + 1], (result->count - i - 1) * sizeof(face_t));
+            result->count--;
+            break;
+        }
+    }
+    
+    int pos = result->count;
+    while (pos > 0 && result->faces[pos - 1].box.score < box->score) {
+        pos--;
+    }
+    if (pos >= result->capacity) {
+        result->dropped++;
+        return;
+    }
+    
+    int tail = result->count - pos;
+    if (result->count == result->capacity) {
+        tail--;
+        result->dropped++;
+    } else {
+        result->count++;
+    }
+    memmove(&result->faces[pos + 1], &result->faces[pos], tail * sizeof(face_t));
+    result->faces[pos] = *face;
+}
+
+esp_err_t face_detector_detect_regions(camera_fb_t *fb, const face_box_t *regions, int region_count,
+                                       face_result_t *result)
+{
+    if (!fb || !result || (result->capacity > 0 && !result->faces)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    result->count = 0;
+    result->dropped = 0;
+    
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // For JPEG images, we can't do face detection without decoding
+    if (fb->format != PIXFORMAT_RGB565) {
+        ESP_LOGD(TAG, "Skipping face detection - image is not RGB565");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    int width = fb->width;
+    int height = fb->height;
+    face_box_t proposals[MAX_PROPOSALS];
+    int count = find_skin_regions(fb->buf, width, height, proposals, MAX_PROPOSALS);
+    
+    for (int i = 0; i < region_count && count < MAX_PROPOSALS; i++) {
+        face_box_t box = regions[i];
+        if (!clip_box(&box, width, height) || box.w < s_min_face_size || box.h < s_min_face_size) {
+            continue;
+        }
+        box.score = region_skin_share(&box, width / CELL_SIZE, height / CELL_SIZE);
+        proposals[count++] = box;
+    }
+    
+    s_stats.frames++;
+    s_stats.proposals += count;
+    s_stats.frame_pixels += (uint64_t)width * height;
+    
+    if (count == 0) {
+        return ESP_OK;
+    }
+    
+    face_roi_t rois[MAX_PROPOSALS];
+    int roi_count = build_rois(proposals, count, width, height, rois);
+    
+    int64_t roi_pixels = 0;
+    for (int i = 0; i < roi_count; i++) {
+        roi_pixels += (int64_t)rois[i].area.w * rois[i].area.h;
+    }
+    
+    // Cropping many regions costs more than one pass over the frame
+    if (roi_pixels * 100 > (int64_t)width * height * ROI_FULL_FRAME_PERCENT) {
+        for (int i = 1; i < roi_count; i++) {
+            for (int h = 0; h < rois[i].hint_count; h++) {
+                rois[0].hints[rois[0].hint_count++] = rois[i].hints[h];
+            }
+        }
+        rois[0].area = (face_box_t){ .x = 0, .y = 0, .w = width, .h = height };
+        roi_count = 1;
+    }
+    
+    for (int r = 0; r < roi_count; r++) {
+        face_roi_t *roi = &rois[r];
+        bool full_frame = roi->area.w == width && roi->area.h == height;
+        const uint8_t *pixels = full_frame ? fb->buf : crop_region(fb, &roi->area);
+        if (!pixels) {
+            continue;
+        }
+        
+        for (int h = 0; h < roi->hint_count; h++) {
+            roi->hints[h].x -= roi->area.x;
+            roi->hints[h].y -= roi->area.y;
+        }
+        
+        face_model_input_t input = {
+            .rgb565 = pixels,
+            .width = roi->area.w,
+            .height = roi->area.h,
+            .hints = roi->hints,
+            .hint_count = roi->hint_count,
+        };
+        face_t found[FACE_MODEL_MAX_RESULTS];
+        int n = face_model_infer(&input, found, FACE_MODEL_MAX_RESULTS);
+        
+        s_stats.model_runs++;
+        s_stats.model_pixels += (uint64_t)roi->area.w * roi->area.h;
+        
+        for (int i = 0; i < n; i++) {
+            found[i].box.x += roi->area.x;
+            found[i].box.y += roi->area.y;
+            if (found[i].has_landmarks) {
+                for (int l = 0; l < FACE_LANDMARK_COUNT; l++) {
+                    found[i].landmarks[l].x += roi->area.x;
+                    found[i].landmarks[l].y += roi->area.y;
+                }
+            }
+            add_face(result, &found[i]);
+        }
+    }
+    
+    if (result->count > 0) {
+        const face_box_t *best = &result->faces[0].box;
+        ESP_LOGI(TAG, "Detected %d face(s), best at (%d,%d) %dx%d score %.2f",
+                 result->count, best->x, best->y, best->w, best->h, best->score);
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t face_detector_detect(camera_fb_t *fb, face_result_t *result)
+{
+    return face_detector_detect_regions(fb, NULL, 0, result);
+}
+
+void face_detector_get_stats(face_detector_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void face_detector_set_min_size(int size)
+{
+    s_min_face_size = size;
+    ESP_LOGI(TAG, "Minimum face size set to %d", size);
+}
+
+void face_detector_deinit(void)
+{
+    face_model_deinit();
+    heap_caps_free(s_roi_buf);
+    s_roi_buf = NULL;
+    s_roi_capacity = 0;
+    heap_caps_free(s_skin_lut);
+    s_skin_lut = NULL;
+    heap_caps_free(s_skin_sat);
+    s_skin_sat = NULL;
+    s_skin_sat_capacity = 0;
+    s_initialized = false;
+    ESP_LOGI(TAG, "Face detector deinitialized");
+}
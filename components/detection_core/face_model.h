@@ -0,0 +1,59 @@
+/**
+ * @file face_model.h
+ * @brief Face detection network backend used by the region-of-interest cascade
+ *
+ * face_detector.c crops each region of interest and hands it to one of two
+ * backends: face_model_espdl.cpp (ESP-DL MSR01 + MNP01) on the target, or
+ * face_model_stub.c on the host and when the network is disabled.
+ */
+
+#ifndef FACE_MODEL_H
+#define FACE_MODEL_H
+
+#include "esp_err.h"
+#include "face_detector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One region handed to the network
+ */
+typedef struct {
+    const uint8_t *rgb565;  ///< Region pixels, camera byte order, width * height
+    int width;
+    int height;
+    const face_box_t *hints; ///< Proposals merged into the region, in region coordinates
+    int hint_count;
+} face_model_input_t;
+
+/**
+ * @brief Load the network
+ */
+esp_err_t face_model_init(void);
+
+/**
+ * @brief Run the network on one region
+ * @param input Region
+ * @param faces Output faces in region coordinates
+ * @param max_faces Capacity of faces
+ * @return Number of faces written
+ */
+int face_model_infer(const face_model_input_t *input, face_t *faces, int max_faces);
+
+/**
+ * @brief Release the network
+ */
+void face_model_deinit(void);
+
+/**
+ * @brief Backend name, for logs
+ */
+const char *face_model_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FACE_MODEL_H
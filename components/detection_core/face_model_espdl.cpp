@@ -0,0 +1,101 @@
+/**
+ * @file face_model_espdl.cpp
+ * @brief ESP-DL two-stage human face detector (MSR01 proposals, MNP01 refinement)
+ */
+
+#include "face_model.h"
+#include "esp_log.h"
+#include "human_face_detect_msr01.hpp"
+#include "human_face_detect_mnp01.hpp"
+#include <new>
+
+static const char *TAG = "face_model";
+
+static HumanFaceDetectMSR01 *s_msr01 = nullptr;
+static HumanFaceDetectMNP01 *s_mnp01 = nullptr;
+
+static inline int clamp_int(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+extern "C" esp_err_t face_model_init(void)
+{
+    if (s_msr01) {
+        return ESP_OK;
+    }
+
+    // Thresholds from the esp-dl human_face_detect example
+    s_msr01 = new (std::nothrow) HumanFaceDetectMSR01(0.1F, 0.5F, 10, 0.2F);
+    s_mnp01 = new (std::nothrow) HumanFaceDetectMNP01(0.5F, 0.3F, 5);
+    if (!s_msr01 || !s_mnp01) {
+        ESP_LOGE(TAG, "Failed to create ESP-DL face models");
+        face_model_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+extern "C" int face_model_infer(const face_model_input_t *input, face_t *faces, int max_faces)
+{
+    if (!s_msr01) {
+        return 0;
+    }
+
+    // The models take a mutable pointer but only read the image
+    uint16_t *pixels = (uint16_t *)input->rgb565;
+    std::vector<int> shape = {input->height, input->width, 3};
+
+    std::list<dl::detect::result_t> &candidates = s_msr01->infer(pixels, shape);
+    if (candidates.empty()) {
+        return 0;
+    }
+    std::list<dl::detect::result_t> &results = s_mnp01->infer(pixels, shape, candidates);
+
+    int count = 0;
+    for (const dl::detect::result_t &r : results) {
+        if (count >= max_faces) {
+            break;
+        }
+
+        int x0 = clamp_int(r.box[0], 0, input->width);
+        int y0 = clamp_int(r.box[1], 0, input->height);
+        int x1 = clamp_int(r.box[2], 0, input->width);
+        int y1 = clamp_int(r.box[3], 0, input->height);
+        if (x1 <= x0 || y1 <= y0) {
+            continue;
+        }
+
+        face_t *face = &faces[count++];
+        face->box.x = x0;
+        face->box.y = y0;
+        face->box.w = x1 - x0;
+        face->box.h = y1 - y0;
+        face->box.score = r.score;
+
+        // MNP01 reports five (x, y) keypoints in face_landmark_t order
+        face->has_landmarks = r.keypoint.size() >= 2 * FACE_LANDMARK_COUNT;
+        if (face->has_landmarks) {
+            for (int i = 0; i < FACE_LANDMARK_COUNT; i++) {
+                face->landmarks[i].x = r.keypoint[2 * i];
+                face->landmarks[i].y = r.keypoint[2 * i + 1];
+            }
+        }
+    }
+
+    return count;
+}
+
+extern "C" void face_model_deinit(void)
+{
+    delete s_mnp01;
+    delete s_msr01;
+    s_mnp01 = nullptr;
+    s_msr01 = nullptr;
+}
+
+extern "C" const char *face_model_name(void)
+{
+    return "esp-dl msr01+mnp01";
+}
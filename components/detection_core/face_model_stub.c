@@ -0,0 +1,37 @@
+/**
+ * @file face_model_stub.c
+ * @brief Stand-in face model for the host build and builds without ESP-DL
+ *
+ * Confirms every proposal as a face, scored by its skin share. Detection
+ * then behaves like the plain skin-tone heuristic, while the cascade around
+ * it (proposal merging, cropping, result merging) runs unchanged.
+ */
+
+#include "face_model.h"
+
+esp_err_t face_model_init(void)
+{
+    return ESP_OK;
+}
+
+int face_model_infer(const face_model_input_t *input, face_t *faces, int max_faces)
+{
+    int count = 0;
+
+    for (int i = 0; i < input->hint_count && count < max_faces; i++) {
+        faces[count].box = input->hints[i];
+        faces[count].has_landmarks = false;
+        count++;
+    }
+
+    return count;
+}
+
+void face_model_deinit(void)
+{
+}
+
+const char *face_model_name(void)
+{
+    return "skin heuristic";
+}
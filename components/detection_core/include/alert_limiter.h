@@ -0,0 +1,94 @@
+/**
+ * @file alert_limiter.h
+ * @brief Token-bucket rate limiter for alerts, one bucket per alert class
+ *
+ * Each class may raise a burst of up to `burst` alerts, after which one more
+ * is allowed every `refill_ms`. Time is passed in by the caller from a
+ * monotonic clock, so the limiter does not depend on wall time. Motion and
+ * face alerts have separate buckets, so a noisy scene cannot use up the
+ * budget of face alerts.
+ */
+
+#ifndef ALERT_LIMITER_H
+#define ALERT_LIMITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ALERT_CLASS_MOTION,    ///< Events with motion only
+    ALERT_CLASS_FACE,      ///< Events with a face, with or without motion
+    ALERT_CLASS_COUNT,
+} alert_class_t;
+
+/**
+ * @brief Budget of one class
+ */
+typedef struct {
+    uint8_t burst;         ///< Alerts allowed back to back (0 disables the class)
+    uint32_t refill_ms;    ///< Time to earn back one alert
+} alert_budget_t;
+
+/**
+ * @brief Counters of one class
+ */
+typedef struct {
+    uint32_t allowed;
+    uint32_t suppressed;
+} alert_limiter_stats_t;
+
+/**
+ * @brief Initialize (or reconfigure) the limiter with full buckets
+ *
+ * State is kept in static storage and used from one task.
+ *
+ * @param budgets One budget per class, indexed by alert_class_t
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if a class with a burst has no refill time
+ */
+esp_err_t alert_limiter_init(const alert_budget_t budgets[ALERT_CLASS_COUNT]);
+
+/**
+ * @brief Take one alert from a class's bucket
+ * @param alert_class Class of the alert
+ * @param now_ms Monotonic time in milliseconds
+ * @return true if the alert may be raised
+ */
+bool alert_limiter_take(alert_class_t alert_class, int64_t now_ms);
+
+/**
+ * @brief Count an alert as suppressed without touching the bucket
+ *
+ * For callers that check alert_limiter_wait_ms() first and drop the alert
+ * themselves, so the counters still match what alert_limiter_take() would
+ * have reported.
+ *
+ * @param alert_class Class of the alert
+ */
+void alert_limiter_record_suppressed(alert_class_t alert_class);
+
+/**
+ * @brief Time until a class has an alert available again
+ * @return Milliseconds, 0 if one is available now
+ */
+uint32_t alert_limiter_wait_ms(alert_class_t alert_class, int64_t now_ms);
+
+/**
+ * @brief Copy the counters of a class
+ */
+void alert_limiter_get_stats(alert_class_t alert_class, alert_limiter_stats_t *stats);
+
+/**
+ * @brief Short name of a class, for logs
+ */
+const char *alert_class_name(alert_class_t alert_class);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALERT_LIMITER_H
@@ -0,0 +1,116 @@
+/**
+ * @file detection_scheduler.h
+ * @brief Activity-driven capture rate and face detection policy
+ */
+
+#ifndef DETECTION_SCHEDULER_H
+#define DETECTION_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief When face detection runs
+ */
+typedef enum {
+    FACE_POLICY_ALWAYS,       ///< Every frame
+    FACE_POLICY_ON_MOTION,    ///< Only frames with motion
+    FACE_POLICY_AFTER_MOTION, ///< Frames with motion and for face_hold_ms after
+} face_policy_t;
+
+/**
+ * @brief Decision taken for the capture interval on the last update
+ */
+typedef enum {
+    SCHEDULER_DECISION_NONE,     ///< No frame seen yet
+    SCHEDULER_DECISION_SPEED_UP, ///< Activity rising, interval halved
+    SCHEDULER_DECISION_HOLD,     ///< Activity steady, interval kept at or below base
+    SCHEDULER_DECISION_BACK_OFF, ///< Static scene, interval grown
+} scheduler_decision_t;
+
+/**
+ * @brief Scheduler configuration
+ */
+typedef struct {
+    uint32_t min_interval_ms;    ///< Fastest capture interval, reached while activity rises
+    uint32_t base_interval_ms;   ///< Starting interval and ceiling while activity lasts
+    uint32_t max_interval_ms;    ///< Slowest capture interval in a static scene
+    uint32_t backoff_percent;    ///< Interval growth per quiet frame (200 doubles it)
+    float activity_threshold;    ///< change_percentage counted as activity
+    face_policy_t face_policy;   ///< When face detection runs
+    uint32_t face_hold_ms;       ///< Hold time for FACE_POLICY_AFTER_MOTION
+} scheduler_config_t;
+
+/**
+ * @brief Current state and decision counters
+ */
+typedef struct {
+    uint32_t interval_ms;              ///< Current capture interval
+    float change_avg;                  ///< Smoothed change_percentage
+    scheduler_decision_t last_decision;
+    uint32_t frames;                   ///< Updates processed
+    uint32_t speed_ups;
+    uint32_t holds;
+    uint32_t backoffs;
+    uint32_t face_runs;                ///< Frames where face detection was due
+    uint32_t face_skips;               ///< Frames where it was skipped
+} scheduler_stats_t;
+
+/**
+ * @brief Initialize (or reconfigure) the scheduler
+ *
+ * The scheduler keeps its state in static storage. Updates and face
+ * decisions must come from one task; the interval and statistics may be read
+ * from any task.
+ *
+ * @param config Configuration
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the intervals are not
+ *         ordered min <= base <= max or backoff_percent is not above 100
+ */
+esp_err_t detection_scheduler_init(const scheduler_config_t *config);
+
+/**
+ * @brief Feed the motion result of an analyzed frame
+ * @param change_percentage Percentage of changed pixels
+ * @param motion_detected Motion flag of the same frame
+ * @param now_ms Monotonic time in milliseconds
+ */
+void detection_scheduler_update(float change_percentage, bool motion_detected, int64_t now_ms);
+
+/**
+ * @brief Decide whether face detection should run on the current frame
+ *
+ * Call once per analyzed frame, after the motion result is known.
+ *
+ * @param motion_detected Motion flag of the frame
+ * @param now_ms Monotonic time in milliseconds
+ * @return true if face detection should run
+ */
+bool detection_scheduler_face_due(bool motion_detected, int64_t now_ms);
+
+/**
+ * @brief Interval to wait before the next capture
+ */
+uint32_t detection_scheduler_interval_ms(void);
+
+/**
+ * @brief Copy the current state and counters
+ * @param stats Output
+ */
+void detection_scheduler_get_stats(scheduler_stats_t *stats);
+
+/**
+ * @brief Short name of a decision, for logs
+ */
+const char *detection_scheduler_decision_name(scheduler_decision_t decision);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DETECTION_SCHEDULER_H
@@ -0,0 +1,103 @@
+/**
+ * @file event_fsm.h
+ * @brief Event state machine that turns per-frame detections into events
+ *
+ * Frames are judged one by one, but alerts are raised per event:
+ *
+ *   idle -> candidate   first triggering frame
+ *   candidate -> active N of the last M frames triggered and the candidate
+ *                       has lasted min_duration_ms: the event starts
+ *   candidate -> idle   the window holds no trigger any more
+ *   active -> cooldown  no trigger for end_quiet_ms: the event has ended
+ *   cooldown -> active  a trigger within cooldown_ms continues the same event
+ *   cooldown -> idle    cooldown_ms without a trigger: the event is closed
+ */
+
+#ifndef EVENT_FSM_H
+#define EVENT_FSM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest confirmation window, in frames */
+#define EVENT_FSM_MAX_WINDOW 32
+
+typedef enum {
+    EVENT_STATE_IDLE,
+    EVENT_STATE_CANDIDATE,
+    EVENT_STATE_ACTIVE,
+    EVENT_STATE_COOLDOWN,
+} event_state_t;
+
+/**
+ * @brief What an update asks the caller to do
+ */
+typedef enum {
+    EVENT_ACTION_NONE,
+    EVENT_ACTION_START,   ///< A new event was confirmed: raise its alert
+    EVENT_ACTION_END,     ///< The event was closed: its duration is final
+} event_action_t;
+
+/**
+ * @brief Configuration
+ */
+typedef struct {
+    uint8_t confirm_frames;    ///< N: triggering frames needed ...
+    uint8_t window_frames;     ///< M: ... among the last M frames (1..EVENT_FSM_MAX_WINDOW)
+    uint32_t min_duration_ms;  ///< Time from the first trigger before an event can start
+    uint32_t end_quiet_ms;     ///< Time without a trigger that ends an active event
+    uint32_t cooldown_ms;      ///< Time after the end in which triggers continue the event
+} event_fsm_config_t;
+
+/**
+ * @brief The current or last event
+ */
+typedef struct {
+    uint32_t id;               ///< Increments per event, starting at 1
+    int64_t start_ms;          ///< First triggering frame
+    uint32_t duration_ms;      ///< First to last triggering frame so far
+    uint32_t trigger_frames;   ///< Triggering frames in the event
+    bool motion;               ///< Some frame of the event had motion
+    bool face;                 ///< Some frame of the event had a face
+} event_info_t;
+
+/**
+ * @brief Initialize (or reconfigure) the state machine
+ *
+ * State is kept in static storage and updated from one task.
+ *
+ * @param config Configuration
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG unless 1 <= N <= M <= EVENT_FSM_MAX_WINDOW
+ */
+esp_err_t event_fsm_init(const event_fsm_config_t *config);
+
+/**
+ * @brief Feed the detections of one analyzed frame
+ * @param motion Motion detected in the frame
+ * @param face Face detected in the frame
+ * @param now_ms Monotonic time in milliseconds
+ * @param event Output: the event the action refers to, or the current one
+ * @return Action for the caller
+ */
+event_action_t event_fsm_update(bool motion, bool face, int64_t now_ms, event_info_t *event);
+
+/**
+ * @brief Current state
+ */
+event_state_t event_fsm_state(void);
+
+/**
+ * @brief Short name of a state, for logs
+ */
+const char *event_fsm_state_name(event_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_FSM_H
@@ -0,0 +1,175 @@
+/**
+ * @file face_detector.h
+ * @brief Face detection: skin and motion proposals confirmed by ESP-DL
+ */
+
+#ifndef FACE_DETECTOR_H
+#define FACE_DETECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "skin_lut.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Faces a single network run reports at most */
+#define FACE_MODEL_MAX_RESULTS 5
+
+/**
+ * @brief Face or region box in frame pixels
+ */
+typedef struct {
+    int x, y, w, h;
+    float score;        ///< Detection confidence (0-1)
+} face_box_t;
+
+/**
+ * @brief Facial landmarks, in the order the ESP-DL models report them
+ */
+typedef enum {
+    FACE_LANDMARK_LEFT_EYE,
+    FACE_LANDMARK_MOUTH_LEFT,
+    FACE_LANDMARK_NOSE,
+    FACE_LANDMARK_RIGHT_EYE,
+    FACE_LANDMARK_MOUTH_RIGHT,
+    FACE_LANDMARK_COUNT
+} face_landmark_t;
+
+typedef struct {
+    int x, y;
+} face_point_t;
+
+/**
+ * @brief One detected face
+ */
+typedef struct {
+    face_box_t box;
+    bool has_landmarks;                            ///< false when the model gives none
+    face_point_t landmarks[FACE_LANDMARK_COUNT];   ///< Frame pixels, indexed by face_landmark_t
+} face_t;
+
+/**
+ * @brief Face detection result backed by caller-owned storage
+ *
+ * The detector writes faces straight into the caller's array, highest score
+ * first, and never allocates for results. When more faces are found than
+ * fit, the lowest scores are dropped.
+ */
+typedef struct {
+    face_t *faces;      ///< Caller storage
+    int capacity;       ///< Entries in faces
+    int count;          ///< Faces detected
+    int dropped;        ///< Faces discarded because the storage was full
+} face_result_t;
+
+/**
+ * @brief Bind a result to caller storage
+ * @param result Result to initialize
+ * @param storage Array of capacity faces, owned by the caller
+ * @param capacity Number of entries in storage
+ */
+static inline void face_result_init(face_result_t *result, face_t *storage, int capacity)
+{
+    result->faces = storage;
+    result->capacity = capacity;
+    result->count = 0;
+    result->dropped = 0;
+}
+
+/**
+ * @brief Cascade counters since face_detector_init()
+ */
+typedef struct {
+    uint32_t frames;        ///< Frames analyzed
+    uint32_t proposals;     ///< Skin windows and caller regions proposed
+    uint32_t model_runs;    ///< Regions the network ran on
+    uint64_t frame_pixels;  ///< Pixels in all analyzed frames
+    uint64_t model_pixels;  ///< Pixels the network ran on
+} face_detector_stats_t;
+
+/**
+ * @brief Initialize face detector
+ * @return ESP_OK on success
+ */
+esp_err_t face_detector_init(void);
+
+/**
+ * @brief Detect faces in camera frame
+ *
+ * Windows that are mostly skin-toned are proposed as regions of interest;
+ * the face network only runs on those regions, never on the whole frame
+ * unless the regions cover most of it.
+ *
+ * @param fb Camera frame buffer (RGB565)
+ * @param result Result bound with face_result_init(); previous faces are replaced
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the frame is not RGB565,
+ *         ESP_ERR_INVALID_STATE before face_detector_init()
+ */
+esp_err_t face_detector_detect(camera_fb_t *fb, face_result_t *result);
+
+/**
+ * @brief Detect faces, also proposing caller-supplied regions
+ *
+ * Regions, typically where motion was found, are searched in addition to
+ * the skin proposals.
+ *
+ * @param fb Camera frame buffer (RGB565)
+ * @param regions Regions in frame pixels (score ignored), may be NULL
+ * @param region_count Number of regions
+ * @param result Result bound with face_result_init(); previous faces are replaced
+ * @return As face_detector_detect()
+ */
+esp_err_t face_detector_detect_regions(camera_fb_t *fb, const face_box_t *regions, int region_count,
+                                       face_result_t *result);
+
+/**
+ * @brief Copy the cascade counters
+ * @param stats Output
+ */
+void face_detector_get_stats(face_detector_stats_t *stats);
+
+/**
+ * @brief Replace the skin colour model
+ *
+ * Rebuilds the 8 KB classification table by evaluating the model for every
+ * RGB565 value (a few milliseconds), so detection cost does not depend on the
+ * model. Call from the task that runs face_detector_detect().
+ *
+ * @param model Colour model, e.g. skin_model_ycbcr
+ * @param params Model parameters, e.g. &SKIN_YCBCR_DEFAULT
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE before face_detector_init()
+ */
+esp_err_t face_detector_set_skin_model(skin_model_fn model, const void *params);
+
+/**
+ * @brief Set the byte order of RGB565 frames
+ *
+ * Skin proposals classify colours by pixel value, so they must read pixels
+ * the way the sensor stores them. May be called before or after
+ * face_detector_init(), from the task that runs face_detector_detect().
+ * The face network is given the frame bytes unchanged.
+ *
+ * @param big_endian true if each pixel's high byte comes first
+ */
+void face_detector_set_byte_order(bool big_endian);
+
+/**
+ * @brief Set minimum face size for detection
+ * @param size Minimum face size in pixels
+ */
+void face_detector_set_min_size(int size);
+
+/**
+ * @brief Deinitialize face detector
+ */
+void face_detector_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FACE_DETECTOR_H
@@ -0,0 +1,47 @@
+/**
+ * @file jpeg_dc.h
+ * @brief 1/8-scale luma thumbnails from baseline JPEG DC coefficients
+ */
+
+#ifndef JPEG_DC_H
+#define JPEG_DC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Build a luma thumbnail with one pixel per 8x8 luma block
+ *
+ * Only the entropy-coded data is walked: AC coefficients are Huffman-decoded
+ * to skip them, but there is no dequantization, IDCT or colour conversion.
+ * Each output pixel is the block mean, DC * Q0 / 8 + 128. A 640x480 frame
+ * gives an 80x60 thumbnail.
+ *
+ * Baseline (SOF0/SOF1) 8-bit Huffman JPEGs with any sampling factors and
+ * restart intervals are supported. The decoder keeps its Huffman tables in
+ * static storage and is not reentrant.
+ *
+ * @param jpeg JPEG data
+ * @param len Length of JPEG data
+ * @param thumb Output buffer
+ * @param thumb_size Size of output buffer
+ * @param width Output: thumbnail width, ceil(image width / 8)
+ * @param height Output: thumbnail height, ceil(image height / 8)
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for progressive or
+ *         arithmetic-coded images, ESP_ERR_INVALID_SIZE if the thumbnail does
+ *         not fit, ESP_FAIL if the stream is malformed
+ */
+esp_err_t jpeg_dc_thumbnail(const uint8_t *jpeg, size_t len,
+                            uint8_t *thumb, size_t thumb_size,
+                            int *width, int *height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JPEG_DC_H
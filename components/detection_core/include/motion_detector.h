@@ -0,0 +1,246 @@
+/**
+ * @file motion_detector.h
+ * @brief Motion detection using frame comparison
+ */
+
+#ifndef MOTION_DETECTOR_H
+#define MOTION_DETECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Edge of a motion grid cell, in pixels of the processed image */
+#define MOTION_CELL_SIZE 16
+
+/** Share of a cell's pixels that must change for the cell to count as moving */
+#define MOTION_CELL_ACTIVE_PERCENT 20
+
+/** Largest blobs kept per frame */
+#define MOTION_MAX_BLOBS 8
+
+/** Zones per configuration */
+#define MOTION_MAX_ZONES 8
+
+/** Rows between the rows sampled by the illumination check */
+#define MOTION_LIGHT_ROW_STEP 4
+
+/** Share of the difference energy a frame-wide gain/offset fit must explain
+ *  for a change to count as lighting rather than motion */
+#define MOTION_LIGHT_EXPLAINED_PERCENT 75
+
+/** Share of unmasked cells that must move for a change to count as lighting
+ *  even when the fit fails (e.g. a dark room whose lights come on) */
+#define MOTION_LIGHT_SPREAD_PERCENT 90
+
+/**
+ * @brief Background model used to decide which pixels changed
+ */
+typedef enum {
+    MOTION_ENGINE_BLEND = 0,  ///< Blended previous frame and a fixed threshold, 1 byte per pixel
+    MOTION_ENGINE_VARIANCE,   ///< Running mean and variance per pixel, 4 bytes per pixel;
+                              ///< the threshold adapts to pixels that flicker
+} motion_engine_t;
+
+/**
+ * @brief Rectangular motion zone, in percent of the image so it survives
+ *        resolution changes
+ *
+ * Zones are rasterized to the motion grid: a cell belongs to the last zone
+ * that contains its centre.
+ */
+typedef struct {
+    uint8_t x, y, w, h;   ///< Rectangle in percent of image width/height
+    uint8_t threshold;    ///< Pixel difference threshold in the zone, 0 for the global one
+    uint8_t weight;       ///< Weight of the zone in change_percentage (100 = normal);
+                          ///< 0 masks the zone: its pixels are not read at all
+} motion_zone_t;
+
+/**
+ * @brief Motion zone configuration
+ */
+typedef struct {
+    uint8_t default_weight;              ///< Weight of cells outside every zone, 0 masks them
+    uint8_t zone_count;
+    motion_zone_t zones[MOTION_MAX_ZONES];
+} motion_zone_config_t;
+
+/**
+ * @brief Motion detection result
+ */
+typedef struct {
+    bool detected;           ///< Motion detected flag
+    float change_percentage; ///< Percentage of changed pixels, weighted by zone
+    uint32_t changed_pixels; ///< Number of changed pixels outside masked zones
+    int blob_count;          ///< Blobs in motion_detector_get_map()
+    bool illumination_change; ///< Frame-wide lighting change: the baseline was
+                              ///< restarted from this frame and detected is false
+    float gain, offset;      ///< Frame = gain * background + offset, when illumination_change
+} motion_result_t;
+
+/**
+ * @brief Connected group of moving cells
+ *
+ * Coordinates are in pixels of the image given to motion_detector_process().
+ */
+typedef struct {
+    int x, y, w, h;          ///< Bounding box of the blob's cells, clipped to the image
+    float cx, cy;            ///< Centroid, weighted by changed pixels per cell
+    uint16_t cells;          ///< Moving cells in the blob
+    uint32_t changed_pixels; ///< Changed pixels in those cells
+} motion_blob_t;
+
+/**
+ * @brief Per-cell motion grid and its blobs for the last processed frame
+ */
+typedef struct {
+    int cell_size;                      ///< MOTION_CELL_SIZE
+    int grid_w;                         ///< Cells per row
+    int grid_h;                         ///< Cell rows
+    const uint16_t *cell_changed;       ///< Changed pixels per cell, row-major
+    int blob_count;
+    motion_blob_t blobs[MOTION_MAX_BLOBS]; ///< Largest first
+} motion_map_t;
+
+/**
+ * @brief Initialize motion detector
+ *
+ * May be called again to change the frame size; the baseline is discarded.
+ *
+ * @param width Image width
+ * @param height Image height
+ * @param threshold Pixel difference threshold (0-255)
+ * @param change_threshold Percentage of pixels that must change
+ * @return ESP_OK on success
+ */
+esp_err_t motion_detector_init(int width, int height, int threshold, float change_threshold);
+
+/**
+ * @brief Select the background model
+ *
+ * Takes effect at the next motion_detector_init(). With
+ * MOTION_ENGINE_VARIANCE the pixel threshold and zone thresholds are the
+ * smallest difference that can count as motion; pixels must also lie
+ * outside their own noise band.
+ *
+ * @param engine Background model
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unknown engine
+ */
+esp_err_t motion_detector_set_engine(motion_engine_t engine);
+
+/**
+ * @brief Name of a background model, for logs
+ */
+const char *motion_engine_name(motion_engine_t engine);
+
+/**
+ * @brief Process a frame for motion detection
+ *
+ * A frame that would trigger is checked for a lighting change with one
+ * sampled pass over it and the background: if a single gain and offset
+ * explain most of the difference, or nearly every cell moved, the frame is
+ * reported as illumination_change instead and becomes the new baseline.
+ *
+ * @param grayscale_data Grayscale image data
+ * @param size Size of image data
+ * @return Motion detection result
+ */
+motion_result_t motion_detector_process(const uint8_t *grayscale_data, size_t size);
+
+/**
+ * @brief Motion grid and blobs of the last processed frame
+ *
+ * Computed in the same pass as the result; the map stays valid until the
+ * next motion_detector_process() call.
+ *
+ * @return Map, or NULL before motion_detector_init()
+ */
+const motion_map_t *motion_detector_get_map(void);
+
+/**
+ * @brief Set the motion zones
+ *
+ * May be called from any task, before or after motion_detector_init(). The
+ * zones are rasterized at the start of the next motion_detector_process()
+ * call, which also starts a new baseline, since masked cells are not
+ * blended. The processing task never sees a half-written configuration: a
+ * frame that arrives during a set keeps the old zones and picks up the new
+ * ones on the next frame. Only one task should set zones at a time.
+ *
+ * @param config Zones; NULL restores the whole image with the global threshold
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an empty or out-of-image rectangle
+ */
+esp_err_t motion_detector_set_zones(const motion_zone_config_t *config);
+
+/**
+ * @brief Copy the zone configuration last set
+ *
+ * Safe against a concurrent motion_detector_set_zones(); waits for it to
+ * finish copying.
+ *
+ * @param config Output
+ */
+void motion_detector_get_zones(motion_zone_config_t *config);
+
+/**
+ * @brief Reset motion detector baseline
+ */
+void motion_detector_reset(void);
+
+/**
+ * @brief Set detection threshold
+ * @param threshold New threshold value
+ */
+void motion_detector_set_threshold(int threshold);
+
+/**
+ * @brief Get the detection threshold last set
+ */
+int motion_detector_get_threshold(void);
+
+/**
+ * @brief Deinitialize motion detector
+ */
+void motion_detector_deinit(void);
+
+/**
+ * @brief Convert RGB565 to grayscale
+ * @param rgb565_data Input RGB565 data
+ * @param rgb565_size Size of input data
+ * @param gray_data Output grayscale buffer
+ * @param gray_size Size of output buffer
+ * @return ESP_OK on success
+ */
+esp_err_t rgb565_to_grayscale(const uint8_t *rgb565_data, size_t rgb565_size,
+                               uint8_t *gray_data, size_t gray_size);
+
+/**
+ * @brief Convert RGB565 to luma and box-downsample in a single pass
+ *
+ * Writes straight into the buffer handed to motion_detector_process(), so no
+ * full-resolution grayscale copy is needed. At scale 1 with little-endian
+ * pixels the output is identical to rgb565_to_grayscale().
+ *
+ * @param rgb565_data Input RGB565 data
+ * @param width Input width in pixels
+ * @param height Input height in pixels
+ * @param big_endian true if the high byte of each pixel comes first
+ * @param scale Downsampling factor (1, 2 or 4)
+ * @param gray_data Output grayscale buffer
+ * @param gray_size Size of output buffer, at least (width/scale)*(height/scale)
+ * @return ESP_OK on success
+ */
+esp_err_t rgb565_to_luma_scaled(const uint8_t *rgb565_data, int width, int height,
+                                bool big_endian, int scale,
+                                uint8_t *gray_data, size_t gray_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_DETECTOR_H
@@ -0,0 +1,188 @@
+/**
+ * @file motion_kernels.h
+ * @brief Vectorized pixel kernels used by the motion detector
+ */
+
+#ifndef MOTION_KERNELS_H
+#define MOTION_KERNELS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Weight (out of 256) of the new frame in the baseline blend
+ *
+ * baseline' = (baseline * (256 - W) + frame * W + 128) >> 8, i.e. roughly
+ * 90% old + 10% new. The numerator never exceeds 16 bits, so every SIMD path
+ * can compute it in u16 lanes and match the scalar result bit for bit.
+ */
+#define MOTION_BLEND_NEW_WEIGHT 26
+
+/**
+ * @brief Cell threshold that masks the cell out of the per-cell kernel
+ *
+ * No difference can exceed 255, so such a cell could never count; it is
+ * skipped entirely and its baseline is left as it is.
+ */
+#define MOTION_CELL_MASKED 255
+
+/**
+ * @brief Fused frame difference, threshold count and baseline blend
+ *
+ * Single pass over the frame: counts pixels where |frame - baseline| exceeds
+ * the threshold and blends the frame into the baseline in place.
+ *
+ * @param baseline Baseline frame, updated in place
+ * @param frame Current grayscale frame
+ * @param len Number of pixels
+ * @param threshold Pixel difference threshold
+ * @return Number of changed pixels
+ */
+uint32_t motion_kernel_diff_blend(uint8_t *baseline, const uint8_t *frame,
+                                  size_t len, uint8_t threshold);
+
+/**
+ * @brief motion_kernel_diff_blend() that also counts changed pixels per cell
+ *
+ * Same single pass and same baseline result; each row is split at cell
+ * boundaries so the per-cell counts come for free, and each cell has its own
+ * threshold. Cells at MOTION_CELL_MASKED are not read at all. Cells on the
+ * right and bottom edges may be partial.
+ *
+ * @param baseline Baseline frame, updated in place
+ * @param frame Current grayscale frame
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param cell_size Cell edge in pixels (at most 255)
+ * @param cell_threshold Pixel difference threshold per cell, row-major
+ * @param cell_changed Output, ceil(width / cell_size) * ceil(height / cell_size)
+ *                     counts, row-major
+ * @return Number of changed pixels
+ */
+uint32_t motion_kernel_diff_blend_cells(uint8_t *baseline, const uint8_t *frame,
+                                        int width, int height, int cell_size,
+                                        const uint8_t *cell_threshold, uint16_t *cell_changed);
+
+/**
+ * @brief Running mean/variance background model, one uint32_t per pixel
+ *
+ * Bits 0-15 hold the mean in 8.8 fixed point, bits 16-31 the variance in
+ * luma^2 with 4 fractional bits, so a pixel is one 32-bit load and store.
+ * A pixel is foreground when (x - mean)^2 > K^2 * variance and |x - mean|
+ * exceeds the cell threshold. Background pixels update mean and variance
+ * at 1/2^BG_SHIFT per frame. Foreground pixels move their mean at
+ * 1/2^FG_SHIFT, so an object that stops is absorbed slowly, and their
+ * variance at 1/2^FG_VAR_SHIFT towards at most four times its value, so
+ * flicker widens its own band within tens of frames while a passing object
+ * barely widens it.
+ */
+#define MOTION_VAR_K2_Q4        144             // K = 3 standard deviations
+#define MOTION_VAR_MIN_Q4       (4 * 16)        // Variance floor, sigma = 2
+#define MOTION_VAR_INIT_Q4      (25 * 16)       // Starting variance, sigma = 5
+#define MOTION_VAR_BG_SHIFT     4
+#define MOTION_VAR_FG_SHIFT     7
+#define MOTION_VAR_FG_VAR_SHIFT 5
+
+/**
+ * @brief Start a variance model from a frame
+ * @param model Model, len entries
+ * @param frame Grayscale frame
+ * @param len Number of pixels
+ */
+void motion_kernel_variance_init(uint32_t *model, const uint8_t *frame, size_t len);
+
+/**
+ * @brief Classify and update against a variance model, counting per cell
+ *
+ * Same cell layout, per-cell thresholds and masking as
+ * motion_kernel_diff_blend_cells(); the cell threshold is the smallest
+ * difference that can count as motion.
+ *
+ * @param model Model, width * height entries, updated in place
+ * @param frame Current grayscale frame
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param cell_size Cell edge in pixels (at most 255)
+ * @param cell_threshold Minimum pixel difference per cell, row-major
+ * @param cell_changed Output counts per cell, row-major
+ * @return Number of foreground pixels
+ */
+uint32_t motion_kernel_variance_cells(uint32_t *model, const uint8_t *frame,
+                                      int width, int height, int cell_size,
+                                      const uint8_t *cell_threshold, uint16_t *cell_changed);
+
+/**
+ * @brief Sums over sampled pixels pairing background and frame luma
+ *
+ * Enough to fit frame = gain * background + offset by least squares and to
+ * tell how much of the difference energy that fit explains.
+ */
+typedef struct {
+    uint32_t n;
+    uint64_t sum_b, sum_f;
+    uint64_t sum_bb, sum_ff, sum_bf;
+} motion_luma_stats_t;
+
+/**
+ * @brief Accumulate background/frame luma sums over every row_step-th row
+ *
+ * Cells whose threshold is MOTION_CELL_MASKED are skipped. Exactly one of
+ * baseline and model is given; for a model the background is its mean.
+ *
+ * @param baseline Blended background, or NULL
+ * @param model Variance model, or NULL
+ * @param frame Current grayscale frame
+ * @param width Frame width in pixels
+ * @param height Frame height in pixels
+ * @param row_step Rows between sampled rows
+ * @param cell_size Cell edge in pixels
+ * @param cell_threshold Per-cell thresholds, row-major
+ * @param stats Output sums
+ */
+void motion_kernel_luma_stats(const uint8_t *baseline, const uint32_t *model, const uint8_t *frame,
+                              int width, int height, int row_step, int cell_size,
+                              const uint8_t *cell_threshold, motion_luma_stats_t *stats);
+
+/**
+ * @brief Scalar reference for motion_kernel_diff_blend()
+ *
+ * Always available so host builds can check the SIMD path against it.
+ */
+uint32_t motion_kernel_diff_blend_ref(uint8_t *baseline, const uint8_t *frame,
+                                      size_t len, uint8_t threshold);
+
+/**
+ * @brief Convert RGB565 to luma with optional box downsampling, in one pass
+ *
+ * Luma matches rgb565_to_grayscale() exactly at scale 1: each byte of the
+ * pixel indexes a 256-entry table holding its share of
+ * 77*R8 + 150*G8 + 29*B8, so no channel is unpacked per pixel. For scale 2/4
+ * the table sums of each scale x scale block are averaged before the final
+ * shift. Trailing columns/rows that do not fill a block are dropped.
+ *
+ * @param rgb565 Source pixels, 2 bytes each
+ * @param width Source width in pixels
+ * @param height Source height in pixels
+ * @param big_endian true if the high byte of each pixel comes first
+ * @param scale Downsampling factor: 1, 2 or 4
+ * @param luma Output, (width / scale) * (height / scale) bytes
+ */
+void motion_kernel_rgb565_luma(const uint8_t *rgb565, int width, int height,
+                               bool big_endian, int scale, uint8_t *luma);
+
+/**
+ * @brief Name of the implementation selected at compile time
+ * @return "sse2", "neon" or "scalar"
+ */
+const char *motion_kernel_impl_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MOTION_KERNELS_H
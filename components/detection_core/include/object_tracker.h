@@ -0,0 +1,149 @@
+/**
+ * @file object_tracker.h
+ * @brief Fixed-capacity tracker that links motion blobs and faces across frames
+ *
+ * Each track predicts its centre with a constant-velocity alpha-beta filter
+ * (the steady-state form of a constant-velocity Kalman filter). Detections
+ * are assigned greedily to the prediction of the same kind with the highest
+ * overlap, or failing that the nearest centre. Tracks are held in static
+ * storage; nothing is allocated.
+ */
+
+#ifndef OBJECT_TRACKER_H
+#define OBJECT_TRACKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Tracks kept at once */
+#define TRACKER_MAX_TRACKS 8
+
+/** Detections accepted per update */
+#define TRACKER_MAX_DETECTIONS 16
+
+typedef enum {
+    TRACK_KIND_MOTION,
+    TRACK_KIND_FACE,
+} track_kind_t;
+
+/**
+ * @brief Direction of travel, image coordinates (up is towards row 0)
+ */
+typedef enum {
+    TRACK_DIR_NONE,
+    TRACK_DIR_LEFT,
+    TRACK_DIR_RIGHT,
+    TRACK_DIR_UP,
+    TRACK_DIR_DOWN,
+    TRACK_DIR_UP_LEFT,
+    TRACK_DIR_UP_RIGHT,
+    TRACK_DIR_DOWN_LEFT,
+    TRACK_DIR_DOWN_RIGHT,
+} track_direction_t;
+
+/**
+ * @brief One detection, in any pixel space used consistently by the caller
+ */
+typedef struct {
+    int x, y, w, h;
+    track_kind_t kind;
+} tracker_detection_t;
+
+/**
+ * @brief Track state
+ */
+typedef struct {
+    uint16_t id;              ///< Stable while the track lives, never 0
+    track_kind_t kind;
+    float cx, cy;             ///< Filtered centre
+    float vx, vy;             ///< Velocity in pixels per second
+    int w, h;                 ///< Size of the last matched detection
+    float start_cx, start_cy; ///< Centre of the first detection
+    int64_t first_ms;         ///< Time of the first detection
+    int64_t last_ms;          ///< Time of the last update
+    uint16_t hits;            ///< Frames with a matched detection
+    uint8_t misses;           ///< Consecutive frames without one
+    bool confirmed;           ///< hits reached confirm_hits
+    bool reported;            ///< Claimed by object_tracker_claim_unreported()
+} tracker_track_t;
+
+/**
+ * @brief Configuration
+ */
+typedef struct {
+    uint8_t confirm_hits;     ///< Matched frames before a track is confirmed
+    uint8_t max_misses;       ///< Unmatched frames before a track is dropped
+    float min_iou;            ///< Overlap with the prediction that counts as a match
+    float max_distance;       ///< Otherwise, centre distance in track sizes that still matches
+    float alpha;              ///< Position gain of the filter (0..1]
+    float beta;               ///< Velocity gain of the filter (0..alpha]
+} tracker_config_t;
+
+/** Defaults: 2 hits to confirm, 3 misses to drop, IoU 0.1 or 1 size, alpha 0.6, beta 0.2 */
+extern const tracker_config_t TRACKER_CONFIG_DEFAULT;
+
+/**
+ * @brief Initialize (or reset) the tracker
+ * @param config Configuration, NULL for TRACKER_CONFIG_DEFAULT
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for gains outside 0 < beta <= alpha <= 1
+ */
+esp_err_t object_tracker_init(const tracker_config_t *config);
+
+/**
+ * @brief Feed the detections of one frame
+ *
+ * Call once per analyzed frame, also with no detections, so that tracks
+ * coast on their prediction and age out. Detections beyond
+ * TRACKER_MAX_DETECTIONS are ignored.
+ *
+ * @param detections Detections of the frame
+ * @param count Number of detections
+ * @param now_ms Monotonic time in milliseconds
+ * @return Number of confirmed tracks
+ */
+int object_tracker_update(const tracker_detection_t *detections, int count, int64_t now_ms);
+
+/**
+ * @brief Copy the confirmed tracks, longest-lived first
+ * @param tracks Output
+ * @param max Capacity of tracks
+ * @return Number of tracks written
+ */
+int object_tracker_get_tracks(tracker_track_t *tracks, int max);
+
+/**
+ * @brief Copy the confirmed tracks not reported yet and mark them reported
+ *
+ * Lets alerts be deduplicated per track: an object that was already
+ * announced does not announce itself again while its track lives.
+ *
+ * @param tracks Output, longest-lived first
+ * @param max Capacity of tracks
+ * @return Number of tracks written
+ */
+int object_tracker_claim_unreported(tracker_track_t *tracks, int max);
+
+/**
+ * @brief Direction of travel of a track
+ *
+ * Taken from the displacement since the first detection once it exceeds
+ * half the track size, otherwise from the velocity when the track moves
+ * at least half its size per second.
+ */
+track_direction_t object_tracker_direction(const tracker_track_t *track);
+
+/**
+ * @brief Short name of a direction, for logs and messages
+ */
+const char *object_tracker_direction_name(track_direction_t direction);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OBJECT_TRACKER_H
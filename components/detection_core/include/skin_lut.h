@@ -0,0 +1,110 @@
+/**
+ * @file skin_lut.h
+ * @brief RGB565 skin classification bitmap and the colour models that fill it
+ */
+
+#ifndef SKIN_LUT_H
+#define SKIN_LUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** One bit per RGB565 value: 65536 bits in 2048 words (8 KB) */
+#define SKIN_LUT_WORDS (65536 / 32)
+
+/**
+ * @brief Skin classification bitmap indexed by the RGB565 pixel value
+ */
+typedef struct {
+    uint32_t bits[SKIN_LUT_WORDS];
+} skin_lut_t;
+
+/**
+ * @brief Skin colour model evaluated once per RGB565 value when building a table
+ * @param r Red, expanded to 8 bits
+ * @param g Green, expanded to 8 bits
+ * @param b Blue, expanded to 8 bits
+ * @param params Model parameters
+ * @return true if the colour counts as skin
+ */
+typedef bool (*skin_model_fn)(uint8_t r, uint8_t g, uint8_t b, const void *params);
+
+/**
+ * @brief RGB rule: every channel above its floor, red dominant by a bounded margin
+ */
+typedef struct {
+    uint8_t r_min;        ///< Red must exceed this
+    uint8_t g_min;        ///< Green must exceed this
+    uint8_t b_min;        ///< Blue must exceed this
+    uint8_t rg_diff_min;  ///< r - g must exceed this
+    uint8_t rg_diff_max;  ///< r - g must stay below this
+} skin_rgb_params_t;
+
+/**
+ * @brief YCbCr rule: chroma inside a box, luma above a floor (BT.601, full range)
+ */
+typedef struct {
+    uint8_t y_min;
+    uint8_t cb_min, cb_max;
+    uint8_t cr_min, cr_max;
+} skin_ycbcr_params_t;
+
+/**
+ * @brief HSV rule: hue in degrees, saturation and value scaled to 0-255
+ *
+ * When hue_min is greater than hue_max the range wraps through 0 degrees.
+ */
+typedef struct {
+    uint16_t hue_min, hue_max;
+    uint8_t sat_min, sat_max;
+    uint8_t val_min;
+} skin_hsv_params_t;
+
+extern const skin_rgb_params_t SKIN_RGB_DEFAULT;
+extern const skin_ycbcr_params_t SKIN_YCBCR_DEFAULT;
+extern const skin_hsv_params_t SKIN_HSV_DEFAULT;
+
+bool skin_model_rgb(uint8_t r, uint8_t g, uint8_t b, const void *params);
+bool skin_model_ycbcr(uint8_t r, uint8_t g, uint8_t b, const void *params);
+bool skin_model_hsv(uint8_t r, uint8_t g, uint8_t b, const void *params);
+
+/**
+ * @brief Evaluate a model for all 65536 RGB565 values and fill the table
+ * @param lut Table to fill
+ * @param model Colour model
+ * @param params Parameters passed to the model
+ * @return Number of RGB565 values classified as skin
+ */
+uint32_t skin_lut_build(skin_lut_t *lut, skin_model_fn model, const void *params);
+
+/**
+ * @brief Swap the bytes of every index of a table
+ *
+ * A table built by skin_lut_build() and swapped once classifies pixels read
+ * low byte first from a frame stored high byte first, so the per-pixel
+ * lookup stays the same for both byte orders. Swapping again restores it.
+ *
+ * @param lut Table to permute in place
+ */
+void skin_lut_swap_bytes(skin_lut_t *lut);
+
+/**
+ * @brief Classify a pixel with one table load
+ * @param lut Table built by skin_lut_build()
+ * @param pixel RGB565 value, or its byte swap for a table passed through
+ *              skin_lut_swap_bytes()
+ */
+static inline bool skin_lut_test(const skin_lut_t *lut, uint16_t pixel)
+{
+    return (lut->bits[pixel >> 5] >> (pixel & 31)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKIN_LUT_H
@@ -0,0 +1,101 @@
+/**
+ * @file spsc_queue.h
+ * @brief Bounded lock-free single-producer/single-consumer pointer queue
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Ring of pointers shared by exactly one producer and one consumer
+ *
+ * Head and tail are free-running counters; only the producer writes tail and
+ * only the consumer writes head, so no lock is needed. The release store on
+ * each counter publishes the slot contents to the other side.
+ */
+typedef struct {
+    void **slots;
+    uint32_t mask;
+    atomic_uint head;  // Next slot to read, written by the consumer
+    atomic_uint tail;  // Next slot to write, written by the producer
+} spsc_queue_t;
+
+/**
+ * @brief Initialize a queue over caller-provided storage
+ * @param q Queue
+ * @param storage Array of capacity pointers
+ * @param capacity Number of slots, must be a power of two
+ * @return false if capacity is not a power of two
+ */
+static inline bool spsc_queue_init(spsc_queue_t *q, void **storage, uint32_t capacity)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    q->slots = storage;
+    q->mask = capacity - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return true;
+}
+
+/**
+ * @brief Append an item (producer side)
+ * @return false if the queue is full
+ */
+static inline bool spsc_queue_push(spsc_queue_t *q, void *item)
+{
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail - head > q->mask) {
+        return false;
+    }
+
+    q->slots[tail & q->mask] = item;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Remove the oldest item (consumer side)
+ * @return Item, or NULL if the queue is empty
+ */
+static inline void *spsc_queue_pop(spsc_queue_t *q)
+{
+    unsigned head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    void *item = q->slots[head & q->mask];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return item;
+}
+
+/**
+ * @brief Number of queued items; exact only when called from either end
+ */
+static inline uint32_t spsc_queue_count(spsc_queue_t *q)
+{
+    return atomic_load_explicit(&q->tail, memory_order_acquire) -
+           atomic_load_explicit(&q->head, memory_order_acquire);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_QUEUE_H
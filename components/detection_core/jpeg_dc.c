@@ -0,0 +1,580 @@
+/**
+ * @file jpeg_dc.c
+ * @brief DC-only baseline JPEG decoder producing 1/8-scale luma thumbnails
+ *
+ * Motion detection only needs coarse luma, and the DC coefficient of each
+ * 8x8 block is exactly its mean. Walking the Huffman stream is unavoidable
+ * (AC codes have to be consumed to find the next block), but everything
+ * after that - dequantization, IDCT, upsampling, colour conversion - is
+ * skipped.
+ */
+
+#include "jpeg_dc.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "jpeg_dc";
+
+#define HUFF_LOOKAHEAD_BITS 8
+#define MAX_COMPONENTS      4
+#define MAX_TABLES          4
+
+typedef struct {
+    bool defined;
+    uint16_t lookup[1 << HUFF_LOOKAHEAD_BITS];  ///< (length << 8) | value, 0 if the code is longer
+    int32_t maxcode[17];    ///< Largest code of each length, -1 if none
+    int32_t mincode[17];    ///< Smallest code of each length
+    uint8_t valptr[17];     ///< Index of the first value of each length
+    uint8_t values[256];
+} huff_table_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+    uint8_t td;
+    uint8_t ta;
+    bool in_scan;
+    int pred;
+} jpeg_component_t;
+
+typedef struct {
+    int width;
+    int height;
+    int ncomp;
+    int hmax;
+    int vmax;
+    int restart_interval;
+    jpeg_component_t comp[MAX_COMPONENTS];
+} jpeg_frame_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t bits;      ///< Left-aligned bit buffer
+    int nbits;
+    bool marker;        ///< Reached a marker; further reads return zeros
+    int padding;        ///< Zero bytes fed past the end of the entropy data
+} bit_reader_t;
+
+// Tables are large enough that they do not belong on the caller's stack
+static huff_table_t s_dc_tables[MAX_TABLES];
+static huff_table_t s_ac_tables[MAX_TABLES];
+static uint16_t s_dc_quant[MAX_TABLES];
+static bool s_quant_defined[MAX_TABLES];
+
+static void br_fill(bit_reader_t *br)
+{
+    while (br->nbits <= 24) {
+        uint32_t byte = 0;
+
+        if (!br->marker && br->p < br->end) {
+            byte = *br->p;
+            if (byte == 0xFF) {
+                uint8_t next = (br->p + 1 < br->end) ? br->p[1] : 0xD9;
+                if (next == 0x00) {
+                    br->p += 2;
+                } else {
+                    br->marker = true;
+                    byte = 0;
+                    br->padding++;
+                }
+            } else {
+                br->p++;
+            }
+        } else {
+            br->padding++;
+        }
+
+        br->bits |= byte << (24 - br->nbits);
+        br->nbits += 8;
+    }
+}
+
+static inline void br_consume(bit_reader_t *br, int n)
+{
+    br->bits <<= n;
+    br->nbits -= n;
+}
+
+/**
+ * @brief Drop buffered bits and step over the next RSTn marker
+ */
+static bool br_restart(bit_reader_t *br)
+{
+    br->bits = 0;
+    br->nbits = 0;
+    br->marker = false;
+    br->padding = 0;
+
+    while (br->p + 1 < br->end) {
+        if (br->p[0] == 0xFF && br->p[1] >= 0xD0 && br->p[1] <= 0xD7) {
+            br->p += 2;
+            return true;
+        }
+        br->p++;
+    }
+    return false;
+}
+
+static int huff_decode(bit_reader_t *br, const huff_table_t *t)
+{
+    br_fill(br);
+
+    uint16_t entry = t->lookup[br->bits >> (32 - HUFF_LOOKAHEAD_BITS)];
+    if (entry) {
+        br_consume(br, entry >> 8);
+        return entry & 0xFF;
+    }
+
+    for (int l = HUFF_LOOKAHEAD_BITS + 1; l <= 16; l++) {
+        int32_t code = (int32_t)(br->bits >> (32 - l));
+        if (code <= t->maxcode[l]) {
+            br_consume(br, l);
+            return t->values[t->valptr[l] + code - t->mincode[l]];
+        }
+    }
+
+    return -1;
+}
+
+static int receive_extend(bit_reader_t *br, int s)
+{
+    if (s == 0) {
+        return 0;
+    }
+
+    br_fill(br);
+    int v = (int)(br->bits >> (32 - s));
+    br_consume(br, s);
+
+    if (v < (1 << (s - 1))) {
+        v += 1 - (1 << s);
+    }
+    return v;
+}
+
+static bool build_huff_table(huff_table_t *t, const uint8_t *counts, const uint8_t *values, int total)
+{
+    memset(t->lookup, 0, sizeof(t->lookup));
+    memcpy(t->values, values, total);
+
+    int code = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+        t->valptr[l] = (uint8_t)k;
+        t->mincode[l] = code;
+
+        for (int i = 0; i < counts[l - 1]; i++, k++, code++) {
+            if (l <= HUFF_LOOKAHEAD_BITS) {
+                int shift = HUFF_LOOKAHEAD_BITS - l;
+                uint16_t entry = (uint16_t)((l << 8) | values[k]);
+                for (int j = 0; j < (1 << shift); j++) {
+                    t->lookup[(code << shift) | j] = entry;
+                }
+            }
+        }
+
+        t->maxcode[l] = counts[l - 1] ? code - 1 : -1;
+        if (code > (1 << l)) {
+            return false;
+        }
+        code <<= 1;
+    }
+
+    t->defined = true;
+    return true;
+}
+
+static esp_err_t parse_dqt(const uint8_t *seg, size_t n)
+{
+    while (n > 0) {
+        int pq = seg[0] >> 4;
+        int tq = seg[0] & 0x0F;
+        size_t size = 1 + (pq ? 128 : 64);
+
+        if (tq >= MAX_TABLES || n < size) {
+            return ESP_FAIL;
+        }
+
+        // Only the DC quantizer (first entry in zigzag order) is needed
+        s_dc_quant[tq] = pq ? (uint16_t)((seg[1] << 8) | seg[2]) : seg[1];
+        s_quant_defined[tq] = true;
+
+        seg += size;
+        n -= size;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_dht(const uint8_t *seg, size_t n)
+{
+    while (n > 0) {
+        if (n < 17) {
+            return ESP_FAIL;
+        }
+
+        int tc = seg[0] >> 4;
+        int th = seg[0] & 0x0F;
+        const uint8_t *counts = seg + 1;
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            total += counts[i];
+        }
+
+        if (tc > 1 || th >= MAX_TABLES || total > 256 || n < 17 + (size_t)total) {
+            return ESP_FAIL;
+        }
+
+        huff_table_t *t = tc ? &s_ac_tables[th] : &s_dc_tables[th];
+        if (!build_huff_table(t, counts, seg + 17, total)) {
+            return ESP_FAIL;
+        }
+
+        seg += 17 + total;
+        n -= 17 + total;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_sof(const uint8_t *seg, size_t n, jpeg_frame_t *f)
+{
+    if (n < 6) {
+        return ESP_FAIL;
+    }
+
+    if (seg[0] != 8) {
+        ESP_LOGD(TAG, "Unsupported sample precision %d", seg[0]);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    f->height = (seg[1] << 8) | seg[2];
+    f->width = (seg[3] << 8) | seg[4];
+    f->ncomp = seg[5];
+
+    if (f->width == 0 || f->height == 0) {
+        // Height defined later by a DNL marker
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (f->ncomp < 1 || f->ncomp > MAX_COMPONENTS || n < 6 + 3 * (size_t)f->ncomp) {
+        return ESP_FAIL;
+    }
+
+    f->hmax = 1;
+    f->vmax = 1;
+    for (int i = 0; i < f->ncomp; i++) {
+        jpeg_component_t *c = &f->comp[i];
+        c->id = seg[6 + i * 3];
+        c->h = seg[7 + i * 3] >> 4;
+        c->v = seg[7 + i * 3] & 0x0F;
+        c->tq = seg[8 + i * 3];
+
+        if (c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4 || c->tq >= MAX_TABLES) {
+            return ESP_FAIL;
+        }
+        if (c->h > f->hmax) f->hmax = c->h;
+        if (c->v > f->vmax) f->vmax = c->v;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t parse_sos(const uint8_t *seg, size_t n, jpeg_frame_t *f, int *scan_count)
+{
+    if (n < 1 || f->ncomp == 0) {
+        return ESP_FAIL;
+    }
+
+    int ns = seg[0];
+    if (ns < 1 || ns > f->ncomp || n < 1 + 2 * (size_t)ns + 3) {
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < f->ncomp; i++) {
+        f->comp[i].in_scan = false;
+        f->comp[i].pred = 0;
+    }
+
+    for (int i = 0; i < ns; i++) {
+        uint8_t id = seg[1 + i * 2];
+        uint8_t tables = seg[2 + i * 2];
+        jpeg_component_t *c = NULL;
+
+        for (int j = 0; j < f->ncomp; j++) {
+            if (f->comp[j].id == id) {
+                c = &f->comp[j];
+                break;
+            }
+        }
+        if (!c) {
+            return ESP_FAIL;
+        }
+
+        c->td = tables >> 4;
+        c->ta = tables & 0x0F;
+        c->in_scan = true;
+
+        if (c->td >= MAX_TABLES || c->ta >= MAX_TABLES ||
+            !s_dc_tables[c->td].defined || !s_ac_tables[c->ta].defined) {
+            return ESP_FAIL;
+        }
+    }
+
+    // The luma component is the first one declared in the frame header
+    if (!f->comp[0].in_scan) {
+        ESP_LOGD(TAG, "First scan does not contain luma");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!s_quant_defined[f->comp[0].tq]) {
+        return ESP_FAIL;
+    }
+
+    *scan_count = ns;
+    return ESP_OK;
+}
+
+/**
+ * @brief Decode one block, returning its DC predictor and skipping the AC terms
+ */
+static bool decode_block(bit_reader_t *br, jpeg_component_t *c, int *dc)
+{
+    int s = huff_decode(br, &s_dc_tables[c->td]);
+    if (s < 0 || s > 11) {
+        return false;
+    }
+    c->pred += receive_extend(br, s);
+    *dc = c->pred;
+
+    const huff_table_t *ac = &s_ac_tables[c->ta];
+    for (int k = 1; k < 64; ) {
+        int rs = huff_decode(br, ac);
+        if (rs < 0) {
+            return false;
+        }
+
+        int run = rs >> 4;
+        int size = rs & 0x0F;
+        if (size == 0) {
+            if (run != 15) {
+                break;  // End of block
+            }
+            k += 16;
+            continue;
+        }
+
+        k += run + 1;
+        br_fill(br);
+        br_consume(br, size);
+    }
+
+    return true;
+}
+
+static inline void store_dc(uint8_t *thumb, int thumb_w, int thumb_h,
+                            int bx, int by, int dc, int q0)
+{
+    if (bx >= thumb_w || by >= thumb_h) {
+        return;
+    }
+
+    // DC = 8 * (block mean - 128) after dequantization
+    int v = 128 + ((dc * q0 + 4) >> 3);
+    thumb[by * thumb_w + bx] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static esp_err_t decode_scan(const uint8_t *data, const uint8_t *end, jpeg_frame_t *f, int ns,
+                             uint8_t *thumb, int thumb_w, int thumb_h)
+{
+    jpeg_component_t *luma = &f->comp[0];
+    const int q0 = s_dc_quant[luma->tq];
+    bit_reader_t br = {
+        .p = data,
+        .end = end,
+        .bits = 0,
+        .nbits = 0,
+        .marker = false,
+        .padding = 0,
+    };
+    int mcus_x;
+    int mcus_y;
+
+    if (ns == 1) {
+        // Non-interleaved: one luma block per MCU, in raster order
+        mcus_x = thumb_w;
+        mcus_y = thumb_h;
+    } else {
+        mcus_x = (f->width + 8 * f->hmax - 1) / (8 * f->hmax);
+        mcus_y = (f->height + 8 * f->vmax - 1) / (8 * f->vmax);
+    }
+
+    const int total = mcus_x * mcus_y;
+    int until_restart = f->restart_interval;
+
+    for (int m = 0; m < total; m++) {
+        if (f->restart_interval) {
+            if (until_restart == 0) {
+                if (!br_restart(&br)) {
+                    return ESP_FAIL;
+                }
+                for (int i = 0; i < f->ncomp; i++) {
+                    f->comp[i].pred = 0;
+                }
+                until_restart = f->restart_interval;
+            }
+            until_restart--;
+        }
+
+        const int mx = m % mcus_x;
+        const int my = m / mcus_x;
+        int dc;
+
+        if (ns == 1) {
+            if (!decode_block(&br, luma, &dc)) {
+                return ESP_FAIL;
+            }
+            store_dc(thumb, thumb_w, thumb_h, mx, my, dc, q0);
+        } else {
+            for (int i = 0; i < f->ncomp; i++) {
+                jpeg_component_t *c = &f->comp[i];
+                if (!c->in_scan) {
+                    continue;
+                }
+
+                for (int v = 0; v < c->v; v++) {
+                    for (int h = 0; h < c->h; h++) {
+                        if (!decode_block(&br, c, &dc)) {
+                            return ESP_FAIL;
+                        }
+                        if (c == luma) {
+                            store_dc(thumb, thumb_w, thumb_h, mx * c->h + h, my * c->v + v, dc, q0);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Reading well past the end of the entropy data means a truncated frame
+        if (br.padding > 8) {
+            ESP_LOGD(TAG, "Entropy data ended after %d of %d MCUs", m + 1, total);
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_dc_thumbnail(const uint8_t *jpeg, size_t len,
+                            uint8_t *thumb, size_t thumb_size,
+                            int *width, int *height)
+{
+    if (!jpeg || !thumb || !width || !height) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < MAX_TABLES; i++) {
+        s_dc_tables[i].defined = false;
+        s_ac_tables[i].defined = false;
+        s_quant_defined[i] = false;
+    }
+
+    jpeg_frame_t frame = {0};
+    size_t pos = 2;
+
+    while (pos + 4 <= len) {
+        if (jpeg[pos] != 0xFF) {
+            return ESP_FAIL;
+        }
+
+        uint8_t marker = jpeg[pos + 1];
+        if (marker == 0xFF) {
+            pos++;  // Fill byte
+            continue;
+        }
+        pos += 2;
+
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            continue;   // Markers without a payload
+        }
+        if (marker == 0xD9) {
+            break;
+        }
+
+        size_t seglen = (jpeg[pos] << 8) | jpeg[pos + 1];
+        if (seglen < 2 || pos + seglen > len) {
+            return ESP_FAIL;
+        }
+
+        const uint8_t *seg = jpeg + pos + 2;
+        size_t n = seglen - 2;
+        esp_err_t err = ESP_OK;
+
+        switch (marker) {
+            case 0xDB:
+                err = parse_dqt(seg, n);
+                break;
+
+            case 0xC4:
+                err = parse_dht(seg, n);
+                break;
+
+            case 0xC0:
+            case 0xC1:
+                err = parse_sof(seg, n, &frame);
+                break;
+
+            case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+            case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+                ESP_LOGD(TAG, "Unsupported JPEG process (SOF%d)", marker - 0xC0);
+                return ESP_ERR_NOT_SUPPORTED;
+
+            case 0xDD:
+                if (n < 2) {
+                    return ESP_FAIL;
+                }
+                frame.restart_interval = (seg[0] << 8) | seg[1];
+                break;
+
+            case 0xDA: {
+                int ns = 0;
+                err = parse_sos(seg, n, &frame, &ns);
+                if (err != ESP_OK) {
+                    return err;
+                }
+
+                const jpeg_component_t *luma = &frame.comp[0];
+                int luma_w = (frame.width * luma->h + frame.hmax - 1) / frame.hmax;
+                int luma_h = (frame.height * luma->v + frame.vmax - 1) / frame.vmax;
+                int thumb_w = (luma_w + 7) / 8;
+                int thumb_h = (luma_h + 7) / 8;
+
+                if ((size_t)thumb_w * thumb_h > thumb_size) {
+                    return ESP_ERR_INVALID_SIZE;
+                }
+
+                err = decode_scan(jpeg + pos + seglen, jpeg + len, &frame, ns,
+                                  thumb, thumb_w, thumb_h);
+                if (err == ESP_OK) {
+                    *width = thumb_w;
+                    *height = thumb_h;
+                }
+                return err;
+            }
+
+            default:
+                break;  // APPn, COM and friends
+        }
+
+        if (err != ESP_OK) {
+            return err;
+        }
+        pos += seglen;
+    }
+
+    return ESP_FAIL;
+}
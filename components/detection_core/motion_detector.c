@@ -0,0 +1,591 @@
+/**
+ * @file motion_detector.c
+ * @brief Motion detection implementation using frame comparison
+ */
+
+#include "motion_detector.h"
+#include "motion_kernels.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "motion_detector";
+
+static motion_engine_t s_engine = MOTION_ENGINE_BLEND;
+static uint8_t *s_prev_frame = NULL;        // MOTION_ENGINE_BLEND baseline
+static uint32_t *s_model = NULL;            // MOTION_ENGINE_VARIANCE mean/variance per pixel
+static size_t s_frame_size = 0;
+static int s_width = 0;
+static int s_height = 0;
+static int s_threshold = 15;
+static float s_change_threshold = 5.0f;
+static bool s_has_baseline = false;
+
+// Motion grid of the last frame and the scratch used to label its blobs
+static motion_map_t s_map;
+static uint16_t *s_cell_changed = NULL;
+static uint8_t *s_cell_visited = NULL;
+static uint16_t *s_fill_stack = NULL;
+
+// Zones: s_zones_config is written by motion_detector_set_zones() from any
+// task; the processing task copies it into s_zones when s_zones_pending is
+// set and rasterizes it into per-cell thresholds and weights. The copies are
+// ordered by s_zones_seq, which is odd while a write is in progress, so a
+// reader never takes a half-written config and the writer never waits
+static const motion_zone_config_t s_default_zones = { .default_weight = 100 };
+static motion_zone_config_t s_zones_config = { .default_weight = 100 };
+static atomic_uint s_zones_seq = 0;
+static motion_zone_config_t s_zones = { .default_weight = 100 };
+static atomic_bool s_zones_pending = false;
+static atomic_bool s_threshold_pending = false;
+static uint8_t *s_cell_threshold = NULL;
+static uint8_t *s_cell_weight = NULL;
+static uint64_t s_weighted_pixels = 0;
+
+/**
+ * @brief Copy s_zones_config unless a set is in progress or overlapped the copy
+ * @return true if out holds a consistent config
+ */
+static bool read_zones_config(motion_zone_config_t *out)
+{
+    unsigned seq = atomic_load_explicit(&s_zones_seq, memory_order_acquire);
+    if (seq & 1) {
+        return false;
+    }
+    memcpy(out, &s_zones_config, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s_zones_seq, memory_order_relaxed) == seq;
+}
+
+/**
+ * @brief Take the zones last set into s_zones
+ *
+ * If a set is being written right now, the old zones stay and the update
+ * is left pending for the next frame.
+ *
+ * @return true if s_zones changed
+ */
+static bool take_pending_zones(void)
+{
+    motion_zone_config_t config;
+    
+    if (!atomic_exchange(&s_zones_pending, false)) {
+        return false;
+    }
+    if (!read_zones_config(&config)) {
+        atomic_store(&s_zones_pending, true);
+        return false;
+    }
+    s_zones = config;
+    return true;
+}
+
+static void free_grid(void)
+{
+    heap_caps_free(s_cell_changed);
+    heap_caps_free(s_cell_visited);
+    heap_caps_free(s_fill_stack);
+    heap_caps_free(s_cell_threshold);
+    heap_caps_free(s_cell_weight);
+    s_cell_changed = NULL;
+    s_cell_visited = NULL;
+    s_fill_stack = NULL;
+    s_cell_threshold = NULL;
+    s_cell_weight = NULL;
+    memset(&s_map, 0, sizeof(s_map));
+}
+
+static void *grid_alloc(size_t size)
+{
+    void *p = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!p) {
+        p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    return p;
+}
+
+static inline uint32_t cell_pixels(int gx, int gy)
+{
+    int w = s_width - gx * MOTION_CELL_SIZE;
+    int h = s_height - gy * MOTION_CELL_SIZE;
+    
+    return (uint32_t)(w < MOTION_CELL_SIZE ? w : MOTION_CELL_SIZE) *
+           (h < MOTION_CELL_SIZE ? h : MOTION_CELL_SIZE);
+}
+
+/**
+ * @brief Turn the zone rectangles into per-cell thresholds and weights
+ */
+static void rasterize_zones(void)
+{
+    const int grid_w = s_map.grid_w;
+    const int grid_h = s_map.grid_h;
+    uint8_t global = (uint8_t)(s_threshold < 0 ? 0 : (s_threshold >= MOTION_CELL_MASKED ?
+                                                      MOTION_CELL_MASKED - 1 : s_threshold));
+    int masked = 0;
+    
+    s_weighted_pixels = 0;
+    
+    for (int gy = 0; gy < grid_h; gy++) {
+        for (int gx = 0; gx < grid_w; gx++) {
+            int x0 = gx * MOTION_CELL_SIZE, y0 = gy * MOTION_CELL_SIZE;
+            int x1 = x0 + MOTION_CELL_SIZE < s_width ? x0 + MOTION_CELL_SIZE : s_width;
+            int y1 = y0 + MOTION_CELL_SIZE < s_height ? y0 + MOTION_CELL_SIZE : s_height;
+            // Doubled centre and doubled rectangle edges avoid rounding
+            int cx2 = x0 + x1, cy2 = y0 + y1;
+            uint8_t weight = s_zones.default_weight;
+            uint8_t threshold = global;
+            
+            for (int z = 0; z < s_zones.zone_count; z++) {
+                const motion_zone_t *zone = &s_zones.zones[z];
+                if (cx2 * 50 >= zone->x * s_width && cx2 * 50 < (zone->x + zone->w) * s_width &&
+                    cy2 * 50 >= zone->y * s_height && cy2 * 50 < (zone->y + zone->h) * s_height) {
+                    weight = zone->weight;
+                    threshold = zone->threshold ? zone->threshold : global;
+                }
+            }
+            
+            if (weight == 0) {
+                threshold = MOTION_CELL_MASKED;
+                masked++;
+            } else if (threshold == MOTION_CELL_MASKED) {
+                threshold = MOTION_CELL_MASKED - 1;
+            }
+            
+            s_cell_threshold[gy * grid_w + gx] = threshold;
+            s_cell_weight[gy * grid_w + gx] = weight;
+            s_weighted_pixels += (uint64_t)weight * cell_pixels(gx, gy);
+        }
+    }
+    
+    ESP_LOGI(TAG, "Motion zones applied: %d zone(s), %d of %d cells masked",
+             s_zones.zone_count, masked, grid_w * grid_h);
+}
+
+static void free_baseline(void)
+{
+    heap_caps_free(s_prev_frame);
+    heap_caps_free(s_model);
+    s_prev_frame = NULL;
+    s_model = NULL;
+}
+
+static inline bool is_initialized(void)
+{
+    return s_prev_frame || s_model;
+}
+
+esp_err_t motion_detector_init(int width, int height, int threshold, float change_threshold)
+{
+    // Re-initialization (e.g. after a resolution change) replaces the baseline
+    free_baseline();
+    free_grid();
+    
+    s_width = width;
+    s_height = height;
+    s_threshold = threshold;
+    s_change_threshold = change_threshold;
+    s_frame_size = width * height;
+    
+    // Allocate in PSRAM if available
+    if (s_engine == MOTION_ENGINE_VARIANCE) {
+        s_model = heap_caps_malloc(s_frame_size * sizeof(uint32_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!s_model) {
+            s_model = malloc(s_frame_size * sizeof(uint32_t));
+        }
+    } else {
+        s_prev_frame = heap_caps_malloc(s_frame_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!s_prev_frame) {
+            // Fallback to regular RAM
+            s_prev_frame = malloc(s_frame_size);
+        }
+    }
+    
+    if (!is_initialized()) {
+        ESP_LOGE(TAG, "Failed to allocate memory for motion detection");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    int grid_w = (width + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+    int grid_h = (height + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+    size_t cells = (size_t)grid_w * grid_h;
+    
+    s_cell_changed = grid_alloc(cells * sizeof(uint16_t));
+    s_cell_visited = grid_alloc(cells);
+    s_fill_stack = grid_alloc(cells * sizeof(uint16_t));
+    s_cell_threshold = grid_alloc(cells);
+    s_cell_weight = grid_alloc(cells);
+    if (!s_cell_changed || !s_cell_visited || !s_fill_stack || !s_cell_threshold || !s_cell_weight ||
+        cells > UINT16_MAX) {
+        ESP_LOGE(TAG, "Failed to allocate motion grid (%u cells)", cells);
+        free_grid();
+        free_baseline();
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_cell_changed, 0, cells * sizeof(uint16_t));
+    s_map.cell_size = MOTION_CELL_SIZE;
+    s_map.grid_w = grid_w;
+    s_map.grid_h = grid_h;
+    s_map.cell_changed = s_cell_changed;
+    
+    take_pending_zones();
+    atomic_store(&s_threshold_pending, false);
+    rasterize_zones();
+    
+    s_has_baseline = false;
+    ESP_LOGI(TAG, "Motion detector initialized: %dx%d, threshold=%d, change=%.1f%%, engine=%s, kernel=%s",
+             width, height, threshold, change_threshold, motion_engine_name(s_engine),
+             motion_kernel_impl_name());
+    
+    return ESP_OK;
+}
+
+static inline bool cell_active(int gx, int gy)
+{
+    uint32_t changed = s_cell_changed[gy * s_map.grid_w + gx];
+    
+    return changed > 0 && changed * 100 >= cell_pixels(gx, gy) * MOTION_CELL_ACTIVE_PERCENT;
+}
+
+static void keep_blob(const motion_blob_t *blob)
+{
+    int pos = s_map.blob_count;
+    
+    while (pos > 0 && s_map.blobs[pos - 1].changed_pixels < blob->changed_pixels) {
+        pos--;
+    }
+    if (pos >= MOTION_MAX_BLOBS) {
+        return;
+    }
+    
+    int tail = s_map.blob_count - pos;
+    if (s_map.blob_count == MOTION_MAX_BLOBS) {
+        tail--;
+    } else {
+        s_map.blob_count++;
+    }
+    memmove(&s_map.blobs[pos + 1], &s_map.blobs[pos], tail * sizeof(motion_blob_t));
+    s_map.blobs[pos] = *blob;
+}
+
+/**
+ * @brief Label 8-connected groups of moving cells and keep the largest
+ */
+static void find_blobs(void)
+{
+    const int grid_w = s_map.grid_w;
+    const int grid_h = s_map.grid_h;
+    
+    s_map.blob_count = 0;
+    memset(s_cell_visited, 0, (size_t)grid_w * grid_h);
+    
+    for (int start = 0; start < grid_w * grid_h; start++) {
+        if (s_cell_visited[start] || !cell_active(start % grid_w, start / grid_w)) {
+            continue;
+        }
+        
+        int gx0 = grid_w, gy0 = grid_h, gx1 = -1, gy1 = -1;
+        uint64_t sum_x = 0, sum_y = 0;
+        motion_blob_t blob = { 0 };
+        int top = 0;
+        
+        s_fill_stack[top++] = (uint16_t)start;
+        s_cell_visited[start] = 1;
+        
+        while (top > 0) {
+            int cell = s_fill_stack[--top];
+            int gx = cell % grid_w;
+            int gy = cell / grid_w;
+            uint32_t changed = s_cell_changed[cell];
+            
+            blob.cells++;
+            blob.changed_pixels += changed;
+            // Cell centres in doubled pixel units keep the sums integral
+            sum_x += (uint64_t)changed * (2 * gx * MOTION_CELL_SIZE + MOTION_CELL_SIZE);
+            sum_y += (uint64_t)changed * (2 * gy * MOTION_CELL_SIZE + MOTION_CELL_SIZE);
+            if (gx < gx0) gx0 = gx;
+            if (gx > gx1) gx1 = gx;
+            if (gy < gy0) gy0 = gy;
+            if (gy > gy1) gy1 = gy;
+            
+            for (int ny = gy - 1; ny <= gy + 1; ny++) {
+                for (int nx = gx - 1; nx <= gx + 1; nx++) {
+                    if (nx < 0 || ny < 0 || nx >= grid_w || ny >= grid_h) {
+                        continue;
+                    }
+                    int n = ny * grid_w + nx;
+                    if (!s_cell_visited[n] && cell_active(nx, ny)) {
+                        s_cell_visited[n] = 1;
+                        s_fill_stack[top++] = (uint16_t)n;
+                    }
+                }
+            }
+        }
+        
+        blob.x = gx0 * MOTION_CELL_SIZE;
+        blob.y = gy0 * MOTION_CELL_SIZE;
+        blob.w = ((gx1 + 1) * MOTION_CELL_SIZE < s_width ? (gx1 + 1) * MOTION_CELL_SIZE : s_width) - blob.x;
+        blob.h = ((gy1 + 1) * MOTION_CELL_SIZE < s_height ? (gy1 + 1) * MOTION_CELL_SIZE : s_height) - blob.y;
+        blob.cx = (float)sum_x / (2.0f * blob.changed_pixels);
+        blob.cy = (float)sum_y / (2.0f * blob.changed_pixels);
+        keep_blob(&blob);
+    }
+}
+
+static void set_baseline(const uint8_t *frame, size_t size)
+{
+    if (s_model) {
+        motion_kernel_variance_init(s_model, frame, size);
+    } else {
+        memcpy(s_prev_frame, frame, size);
+    }
+    memset(s_cell_changed, 0, (size_t)s_map.grid_w * s_map.grid_h * sizeof(uint16_t));
+    s_map.blob_count = 0;
+    s_has_baseline = true;
+}
+
+/**
+ * @brief Decide whether a triggering frame is a lighting change
+ *
+ * Fits frame = gain * background + offset over sampled rows. The background
+ * has already taken this frame in, but both updates are linear in the
+ * frame, so a global lighting change still fits.
+ */
+static bool is_illumination_change(const uint8_t *frame, float *gain, float *offset)
+{
+    int active = 0, unmasked = 0;
+    for (int gy = 0; gy < s_map.grid_h; gy++) {
+        for (int gx = 0; gx < s_map.grid_w; gx++) {
+            if (s_cell_threshold[gy * s_map.grid_w + gx] != MOTION_CELL_MASKED) {
+                unmasked++;
+                active += cell_active(gx, gy);
+            }
+        }
+    }
+    
+    motion_luma_stats_t st;
+    motion_kernel_luma_stats(s_prev_frame, s_model, frame, s_width, s_height, MOTION_LIGHT_ROW_STEP,
+                             MOTION_CELL_SIZE, s_cell_threshold, &st);
+    if (st.n < 2) {
+        return false;
+    }
+    
+    // Centred sums scaled by n^2; double keeps n * sum_bb exact
+    double n = st.n;
+    double var_b = n * st.sum_bb - (double)st.sum_b * st.sum_b;
+    double var_f = n * st.sum_ff - (double)st.sum_f * st.sum_f;
+    double cov = n * st.sum_bf - (double)st.sum_b * st.sum_f;
+    double energy = n * ((double)st.sum_ff + st.sum_bb - 2.0 * st.sum_bf);
+    double residual = var_b > 0.0 ? var_f - cov * cov / var_b : var_f;
+    
+    double g = var_b > 0.0 ? cov / var_b : 1.0;
+    *gain = (float)g;
+    *offset = (float)((st.sum_f - g * st.sum_b) / n);
+    
+    return residual * 100.0 <= energy * (100 - MOTION_LIGHT_EXPLAINED_PERCENT) ||
+           (unmasked > 0 && active * 100 >= unmasked * MOTION_LIGHT_SPREAD_PERCENT);
+}
+
+motion_result_t motion_detector_process(const uint8_t *grayscale_data, size_t size)
+{
+    motion_result_t result = {
+        .detected = false,
+        .change_percentage = 0.0f,
+        .changed_pixels = 0,
+        .blob_count = 0,
+        .illumination_change = false,
+        .gain = 1.0f,
+        .offset = 0.0f
+    };
+    
+    if (!is_initialized() || !grayscale_data) {
+        ESP_LOGE(TAG, "Invalid state or data");
+        return result;
+    }
+    
+    if (size != s_frame_size) {
+        ESP_LOGW(TAG, "Frame size mismatch: expected %u, got %u", s_frame_size, size);
+        return result;
+    }
+    
+    if (take_pending_zones()) {
+        atomic_store(&s_threshold_pending, false);
+        rasterize_zones();
+        // Masked cells were not blended, so the old baseline is stale there
+        s_has_baseline = false;
+    } else if (atomic_exchange(&s_threshold_pending, false)) {
+        rasterize_zones();
+    }
+    
+    // If no baseline, set it and return
+    if (!s_has_baseline) {
+        set_baseline(grayscale_data, size);
+        ESP_LOGI(TAG, "Motion detection baseline set");
+        return result;
+    }
+    
+    // Compare against the background and update it in one pass, counting
+    // changed pixels per grid cell on the way; masked cells are skipped
+    uint32_t changed;
+    if (s_model) {
+        changed = motion_kernel_variance_cells(s_model, grayscale_data, s_width, s_height,
+                                               MOTION_CELL_SIZE, s_cell_threshold, s_cell_changed);
+    } else {
+        changed = motion_kernel_diff_blend_cells(s_prev_frame, grayscale_data, s_width, s_height,
+                                                 MOTION_CELL_SIZE, s_cell_threshold, s_cell_changed);
+    }
+    find_blobs();
+    
+    // Weighted share of changed pixels; with no zones every weight is 100
+    // and this is the plain percentage of changed pixels
+    uint64_t weighted_changed = 0;
+    for (int i = 0; i < s_map.grid_w * s_map.grid_h; i++) {
+        weighted_changed += (uint64_t)s_cell_weight[i] * s_cell_changed[i];
+    }
+    
+    result.changed_pixels = changed;
+    result.change_percentage = s_weighted_pixels ?
+                               (float)weighted_changed / (float)s_weighted_pixels * 100.0f : 0.0f;
+    result.detected = (result.change_percentage >= s_change_threshold);
+    result.blob_count = s_map.blob_count;
+    
+    if (result.detected && is_illumination_change(grayscale_data, &result.gain, &result.offset)) {
+        ESP_LOGI(TAG, "Illumination change: %.2f%% changed, gain %.2f, offset %.1f; baseline restarted",
+                 result.change_percentage, result.gain, result.offset);
+        set_baseline(grayscale_data, size);
+        result.detected = false;
+        result.illumination_change = true;
+        result.changed_pixels = 0;
+        result.change_percentage = 0.0f;
+        result.blob_count = 0;
+        return result;
+    }
+    
+    if (result.detected) {
+        ESP_LOGI(TAG, "Motion detected: %.2f%% changed (%u pixels), %d blob(s)", 
+                 result.change_percentage, result.changed_pixels, result.blob_count);
+    }
+    
+    return result;
+}
+
+const motion_map_t *motion_detector_get_map(void)
+{
+    return is_initialized() ? &s_map : NULL;
+}
+
+esp_err_t motion_detector_set_engine(motion_engine_t engine)
+{
+    if (engine != MOTION_ENGINE_BLEND && engine != MOTION_ENGINE_VARIANCE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    s_engine = engine;
+    return ESP_OK;
+}
+
+const char *motion_engine_name(motion_engine_t engine)
+{
+    return engine == MOTION_ENGINE_VARIANCE ? "variance" : "blend";
+}
+
+esp_err_t motion_detector_set_zones(const motion_zone_config_t *config)
+{
+    if (!config) {
+        config = &s_default_zones;
+    }
+    
+    if (config->zone_count > MOTION_MAX_ZONES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < config->zone_count; i++) {
+        const motion_zone_t *zone = &config->zones[i];
+        if (zone->w == 0 || zone->h == 0 || zone->x + zone->w > 100 || zone->y + zone->h > 100) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    
+    unsigned seq = atomic_load_explicit(&s_zones_seq, memory_order_relaxed);
+    atomic_store_explicit(&s_zones_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s_zones_config = *config;
+    atomic_store_explicit(&s_zones_seq, seq + 2, memory_order_release);
+    atomic_store(&s_zones_pending, true);
+    
+    return ESP_OK;
+}
+
+void motion_detector_get_zones(motion_zone_config_t *config)
+{
+    while (!read_zones_config(config)) {
+        // A set is in progress; it is a short copy
+    }
+}
+
+void motion_detector_reset(void)
+{
+    s_has_baseline = false;
+    ESP_LOGI(TAG, "Motion detector baseline reset");
+}
+
+void motion_detector_set_threshold(int threshold)
+{
+    s_threshold = threshold;
+    atomic_store(&s_threshold_pending, true);
+    ESP_LOGI(TAG, "Motion threshold set to %d", threshold);
+}
+
+int motion_detector_get_threshold(void)
+{
+    return s_threshold;
+}
+
+void motion_detector_deinit(void)
+{
+    free_baseline();
+    free_grid();
+    s_frame_size = 0;
+    s_has_baseline = false;
+    ESP_LOGI(TAG, "Motion detector deinitialized");
+}
+
+esp_err_t rgb565_to_grayscale(const uint8_t *rgb565_data, size_t rgb565_size,
+                               uint8_t *gray_data, size_t gray_size)
+{
+    if (!rgb565_data || !gray_data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    size_t pixel_count = rgb565_size / 2;
+    if (gray_size < pixel_count) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    // RGB565: RRRRRGGGGGGBBBBB, low byte first
+    motion_kernel_rgb565_luma(rgb565_data, (int)pixel_count, 1, false, 1, gray_data);
+    
+    return ESP_OK;
+}
+
+esp_err_t rgb565_to_luma_scaled(const uint8_t *rgb565_data, int width, int height,
+                                bool big_endian, int scale,
+                                uint8_t *gray_data, size_t gray_size)
+{
+    if (!rgb565_data || !gray_data || width <= 0 || height <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (scale != 1 && scale != 2 && scale != 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (gray_size < (size_t)(width / scale) * (size_t)(height / scale)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    motion_kernel_rgb565_luma(rgb565_data, width, height, big_endian, scale, gray_data);
+    return ESP_OK;
+}
@@ -0,0 +1,366 @@
+/**
+ * @file motion_kernels.c
+ * @brief Fused motion kernels with SSE2, NEON and scalar implementations
+ *
+ * All paths process the frame in 16-byte blocks and fall back to the scalar
+ * loop for the tail, so results are identical regardless of the path taken.
+ * The ESP32-S3 build uses the scalar path; it is a single fused pass, which
+ * is what matters for a baseline that lives in PSRAM.
+ */
+
+#include "motion_kernels.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MOTION_KERNEL_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MOTION_KERNEL_NEON 1
+#endif
+
+#define BLEND_OLD_WEIGHT (256 - MOTION_BLEND_NEW_WEIGHT)
+
+// Luma lookup tables, built at compile time. With pixel = hi << 8 | lo:
+//   R8 = R5 << 3 | R5 >> 2 depends on hi only,
+//   G8 = G6 << 2 | G6 >> 4 = ((hi & 7) << 5) + ((lo >> 5) << 2) + ((hi & 7) >> 1),
+//   B8 = B5 << 3 | B5 >> 2 depends on lo only,
+// so 77*R8 + 150*G8 + 29*B8 == s_luma_hi[hi] + s_luma_lo[lo] exactly.
+#define LUMA_R8(h)      ((((h) >> 3) << 3) | ((h) >> 5))
+#define LUMA_HI(h)      (77 * LUMA_R8(h) + 150 * ((((h) & 7) << 5) + (((h) & 7) >> 1)))
+#define LUMA_B8(l)      ((((l) & 0x1F) << 3) | (((l) & 0x1F) >> 2))
+#define LUMA_LO(l)      (150 * (((l) >> 5) << 2) + 29 * LUMA_B8(l))
+
+#define LUT4(f, n)      f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define LUT16(f, n)     LUT4(f, n), LUT4(f, (n) + 4), LUT4(f, (n) + 8), LUT4(f, (n) + 12)
+#define LUT64(f, n)     LUT16(f, n), LUT16(f, (n) + 16), LUT16(f, (n) + 32), LUT16(f, (n) + 48)
+#define LUT256(f)       LUT64(f, 0), LUT64(f, 64), LUT64(f, 128), LUT64(f, 192)
+
+static const uint16_t s_luma_hi[256] = { LUT256(LUMA_HI) };
+static const uint16_t s_luma_lo[256] = { LUT256(LUMA_LO) };
+
+/**
+ * @brief 256 * luma of one pixel given its high and low byte
+ *
+ * On SIMD hosts the full-resolution loop evaluates the table formulas inline
+ * instead, since table lookups are gathers and would block vectorization.
+ */
+static inline uint32_t luma_sum(uint8_t hi, uint8_t lo)
+{
+    return s_luma_hi[hi] + s_luma_lo[lo];
+}
+
+static inline uint32_t diff_blend_scalar(uint8_t *baseline, const uint8_t *frame,
+                                         size_t len, uint8_t threshold)
+{
+    uint32_t changed = 0;
+    
+    for (size_t i = 0; i < len; i++) {
+        int old = baseline[i];
+        int cur = frame[i];
+        int diff = cur > old ? cur - old : old - cur;
+        changed += (diff > threshold);
+        baseline[i] = (uint8_t)((old * BLEND_OLD_WEIGHT + cur * MOTION_BLEND_NEW_WEIGHT + 128) >> 8);
+    }
+    
+    return changed;
+}
+
+uint32_t motion_kernel_diff_blend_ref(uint8_t *baseline, const uint8_t *frame,
+                                      size_t len, uint8_t threshold)
+{
+    return diff_blend_scalar(baseline, frame, len, threshold);
+}
+
+#if MOTION_KERNEL_SSE2
+
+static inline uint32_t diff_blend_fast(uint8_t *baseline, const uint8_t *frame,
+                                       size_t len, uint8_t threshold)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i thr = _mm_set1_epi8((char)threshold);
+    const __m128i w_old = _mm_set1_epi16(BLEND_OLD_WEIGHT);
+    const __m128i w_new = _mm_set1_epi16(MOTION_BLEND_NEW_WEIGHT);
+    const __m128i round = _mm_set1_epi16(128);
+    __m128i acc = zero;
+    size_t i = 0;
+    
+    for (; i + 16 <= len; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(baseline + i));
+        __m128i c = _mm_loadu_si128((const __m128i *)(frame + i));
+        
+        // |b - c| > thr  <=>  saturating (|b - c| - thr) != 0
+        __m128i absdiff = _mm_or_si128(_mm_subs_epu8(b, c), _mm_subs_epu8(c, b));
+        __m128i still = _mm_cmpeq_epi8(_mm_subs_epu8(absdiff, thr), zero);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_andnot_si128(still, one), zero));
+        
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w_old),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(c, zero), w_new));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w_old),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(c, zero), w_new));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+        _mm_storeu_si128((__m128i *)(baseline + i), _mm_packus_epi16(lo, hi));
+    }
+    
+    uint32_t changed = (uint32_t)_mm_cvtsi128_si32(acc) +
+                       (uint32_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+    return changed + diff_blend_scalar(baseline + i, frame + i, len - i, threshold);
+}
+
+const char *motion_kernel_impl_name(void)
+{
+    return "sse2";
+}
+
+#elif MOTION_KERNEL_NEON
+
+static inline uint32_t diff_blend_fast(uint8_t *baseline, const uint8_t *frame,
+                                       size_t len, uint8_t threshold)
+{
+    const uint8x16_t thr = vdupq_n_u8(threshold);
+    const uint8x8_t w_old = vdup_n_u8(BLEND_OLD_WEIGHT);
+    const uint8x8_t w_new = vdup_n_u8(MOTION_BLEND_NEW_WEIGHT);
+    uint32x4_t acc = vdupq_n_u32(0);
+    size_t i = 0;
+    
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t b = vld1q_u8(baseline + i);
+        uint8x16_t c = vld1q_u8(frame + i);
+        
+        uint8x16_t changed = vshrq_n_u8(vcgtq_u8(vabdq_u8(b, c), thr), 7);
+        acc = vpadalq_u16(acc, vpaddlq_u8(changed));
+        
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(b), w_old), vget_low_u8(c), w_new);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(b), w_old), vget_high_u8(c), w_new);
+        vst1q_u8(baseline + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+    
+    uint32_t changed = vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) +
+                       vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+    return changed + diff_blend_scalar(baseline + i, frame + i, len - i, threshold);
+}
+
+const char *motion_kernel_impl_name(void)
+{
+    return "neon";
+}
+
+#else
+
+static inline uint32_t diff_blend_fast(uint8_t *baseline, const uint8_t *frame,
+                                       size_t len, uint8_t threshold)
+{
+    return diff_blend_scalar(baseline, frame, len, threshold);
+}
+
+const char *motion_kernel_impl_name(void)
+{
+    return "scalar";
+}
+
+#endif
+
+uint32_t motion_kernel_diff_blend(uint8_t *baseline, const uint8_t *frame,
+                                  size_t len, uint8_t threshold)
+{
+    return diff_blend_fast(baseline, frame, len, threshold);
+}
+
+uint32_t motion_kernel_diff_blend_cells(uint8_t *baseline, const uint8_t *frame,
+                                        int width, int height, int cell_size,
+                                        const uint8_t *cell_threshold, uint16_t *cell_changed)
+{
+    const int grid_w = (width + cell_size - 1) / cell_size;
+    const int grid_h = (height + cell_size - 1) / cell_size;
+    uint32_t changed = 0;
+    
+    memset(cell_changed, 0, (size_t)grid_w * grid_h * sizeof(uint16_t));
+    
+    // Each row is cut at cell boundaries; with 16-pixel cells every segment
+    // is exactly one SIMD block
+    for (int y = 0; y < height; y++) {
+        uint16_t *cells = cell_changed + (y / cell_size) * grid_w;
+        const uint8_t *thresholds = cell_threshold + (y / cell_size) * grid_w;
+        size_t row = (size_t)y * width;
+        
+        for (int x = 0, cx = 0; x < width; x += cell_size, cx++) {
+            if (thresholds[cx] == MOTION_CELL_MASKED) {
+                continue;
+            }
+            size_t n = (size_t)(width - x < cell_size ? width - x : cell_size);
+            uint32_t count = diff_blend_fast(baseline + row + x, frame + row + x, n, thresholds[cx]);
+            cells[cx] += (uint16_t)count;
+            changed += count;
+        }
+    }
+    
+    return changed;
+}
+
+void motion_kernel_variance_init(uint32_t *model, const uint8_t *frame, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        model[i] = ((uint32_t)frame[i] << 8) | ((uint32_t)MOTION_VAR_INIT_Q4 << 16);
+    }
+}
+
+/**
+ * @brief Signed value divided by 2^shift, rounding towards zero, without a branch
+ */
+static inline int32_t shift_towards_zero(int32_t v, int shift)
+{
+    int32_t bias = (int32_t)((uint32_t)(v >> 31) >> (32 - shift));
+    return (v + bias) >> shift;
+}
+
+static inline uint32_t variance_segment(uint32_t *model, const uint8_t *frame,
+                                        size_t len, uint8_t threshold)
+{
+    const uint32_t floor_q8 = (uint32_t)threshold << 8;
+    uint32_t changed = 0;
+    
+    for (size_t i = 0; i < len; i++) {
+        uint32_t m = model[i];
+        int32_t mean = (int32_t)(m & 0xFFFF);
+        int32_t var = (int32_t)(m >> 16);
+        int32_t d = ((int32_t)frame[i] << 8) - mean;
+        uint32_t ad = (uint32_t)(d < 0 ? -d : d);
+        // (8.8)^2 >> 12 gives luma^2 with 4 fractional bits
+        uint32_t d2 = (ad * ad) >> 12;
+        
+        bool fg = ad > floor_q8 && d2 * 16 > (uint32_t)var * MOTION_VAR_K2_Q4;
+        int shift = fg ? MOTION_VAR_FG_SHIFT : MOTION_VAR_BG_SHIFT;
+        
+        // A foreground pixel may only widen its band gradually, so an
+        // object in view does not hide itself. The cap never exceeds the
+        // 16 bits the variance is packed into, or it would wrap to a tiny
+        // band that fires on every frame
+        uint32_t cap = fg && var < 0x4000 ? (uint32_t)var << 2 : 0xFFFF;
+        
+        mean += shift_towards_zero(d, shift);
+        var += shift_towards_zero((int32_t)(d2 < cap ? d2 : cap) - var, fg ? MOTION_VAR_FG_VAR_SHIFT : shift);
+        if (var < MOTION_VAR_MIN_Q4) {
+            var = MOTION_VAR_MIN_Q4;
+        }
+        
+        model[i] = (uint32_t)mean | ((uint32_t)var << 16);
+        changed += fg;
+    }
+    
+    return changed;
+}
+
+uint32_t motion_kernel_variance_cells(uint32_t *model, const uint8_t *frame,
+                                      int width, int height, int cell_size,
+                                      const uint8_t *cell_threshold, uint16_t *cell_changed)
+{
+    const int grid_w = (width + cell_size - 1) / cell_size;
+    const int grid_h = (height + cell_size - 1) / cell_size;
+    uint32_t changed = 0;
+    
+    memset(cell_changed, 0, (size_t)grid_w * grid_h * sizeof(uint16_t));
+    
+    for (int y = 0; y < height; y++) {
+        uint16_t *cells = cell_changed + (y / cell_size) * grid_w;
+        const uint8_t *thresholds = cell_threshold + (y / cell_size) * grid_w;
+        size_t row = (size_t)y * width;
+        
+        for (int x = 0, cx = 0; x < width; x += cell_size, cx++) {
+            if (thresholds[cx] == MOTION_CELL_MASKED) {
+                continue;
+            }
+            size_t n = (size_t)(width - x < cell_size ? width - x : cell_size);
+            uint32_t count = variance_segment(model + row + x, frame + row + x, n, thresholds[cx]);
+            cells[cx] += (uint16_t)count;
+            changed += count;
+        }
+    }
+    
+    return changed;
+}
+
+void motion_kernel_luma_stats(const uint8_t *baseline, const uint32_t *model, const uint8_t *frame,
+                              int width, int height, int row_step, int cell_size,
+                              const uint8_t *cell_threshold, motion_luma_stats_t *stats)
+{
+    const int grid_w = (width + cell_size - 1) / cell_size;
+    
+    memset(stats, 0, sizeof(*stats));
+    
+    for (int y = 0; y < height; y += row_step) {
+        const uint8_t *thresholds = cell_threshold + (y / cell_size) * grid_w;
+        size_t row = (size_t)y * width;
+        
+        for (int x = 0, cx = 0; x < width; x += cell_size, cx++) {
+            if (thresholds[cx] == MOTION_CELL_MASKED) {
+                continue;
+            }
+            int end = width - x < cell_size ? width : x + cell_size;
+            // Per-segment sums stay within 32 bits
+            uint32_t sb = 0, sf = 0, sbb = 0, sff = 0, sbf = 0;
+            
+            for (int i = x; i < end; i++) {
+                uint32_t b = model ? (model[row + i] & 0xFFFF) >> 8 : baseline[row + i];
+                uint32_t f = frame[row + i];
+                sb += b;
+                sf += f;
+                sbb += b * b;
+                sff += f * f;
+                sbf += b * f;
+            }
+            
+            stats->n += (uint32_t)(end - x);
+            stats->sum_b += sb;
+            stats->sum_f += sf;
+            stats->sum_bb += sbb;
+            stats->sum_ff += sff;
+            stats->sum_bf += sbf;
+        }
+    }
+}
+
+void motion_kernel_rgb565_luma(const uint8_t *rgb565, int width, int height,
+                               bool big_endian, int scale, uint8_t *luma)
+{
+    // Offsets of the high and low byte within each 2-byte pixel
+    const int hi = big_endian ? 0 : 1;
+    const int lo = big_endian ? 1 : 0;
+    const size_t stride = (size_t)width * 2;
+    const int out_w = width / scale;
+    const int out_h = height / scale;
+    
+    if (scale == 1) {
+        size_t count = (size_t)width * height;
+        for (size_t i = 0; i < count; i++) {
+#if MOTION_KERNEL_SSE2 || MOTION_KERNEL_NEON
+            luma[i] = (uint8_t)((LUMA_HI(rgb565[i * 2 + hi]) + LUMA_LO(rgb565[i * 2 + lo])) >> 8);
+#else
+            luma[i] = (uint8_t)(luma_sum(rgb565[i * 2 + hi], rgb565[i * 2 + lo]) >> 8);
+#endif
+        }
+        return;
+    }
+    
+    // Sum of scale*scale table values, shifted by 8 + log2(scale * scale)
+    const int shift = (scale == 2) ? 10 : 12;
+    
+    for (int oy = 0; oy < out_h; oy++) {
+        const uint8_t *row = rgb565 + (size_t)oy * scale * stride;
+        uint8_t *out = luma + (size_t)oy * out_w;
+        
+        for (int ox = 0; ox < out_w; ox++) {
+            const uint8_t *block = row + (size_t)ox * scale * 2;
+            uint32_t sum = 0;
+            
+            for (int dy = 0; dy < scale; dy++) {
+                const uint8_t *p = block + dy * stride;
+                for (int dx = 0; dx < scale * 2; dx += 2) {
+                    sum += luma_sum(p[dx + hi], p[dx + lo]);
+                }
+            }
+            out[ox] = (uint8_t)(sum >> shift);
+        }
+    }
+}
@@ -0,0 +1,315 @@
+/**
+ * @file object_tracker.c
+ * @brief Fixed-capacity tracker that links motion blobs and faces across frames
+ */
+
+#include "object_tracker.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "tracker";
+
+const tracker_config_t TRACKER_CONFIG_DEFAULT = {
+    .confirm_hits = 2,
+    .max_misses = 3,
+    .min_iou = 0.1f,
+    .max_distance = 1.0f,
+    .alpha = 0.6f,
+    .beta = 0.2f,
+};
+
+static tracker_config_t s_config;
+static tracker_track_t s_tracks[TRACKER_MAX_TRACKS];   // id 0 marks a free slot
+static uint16_t s_next_id = 1;
+static bool s_initialized = false;
+
+esp_err_t object_tracker_init(const tracker_config_t *config)
+{
+    if (!config) {
+        config = &TRACKER_CONFIG_DEFAULT;
+    }
+    if (config->alpha <= 0.0f || config->alpha > 1.0f ||
+        config->beta <= 0.0f || config->beta > config->alpha) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_config = *config;
+    memset(s_tracks, 0, sizeof(s_tracks));
+    s_initialized = true;
+
+    ESP_LOGI(TAG, "Tracker initialized: %d tracks, confirm after %u hits, drop after %u misses",
+             TRACKER_MAX_TRACKS, config->confirm_hits, config->max_misses);
+    return ESP_OK;
+}
+
+static float box_iou(float ax, float ay, float aw, float ah, const tracker_detection_t *b)
+{
+    float ix = fminf(ax + aw, (float)(b->x + b->w)) - fmaxf(ax, (float)b->x);
+    float iy = fminf(ay + ah, (float)(b->y + b->h)) - fmaxf(ay, (float)b->y);
+
+    if (ix <= 0.0f || iy <= 0.0f) {
+        return 0.0f;
+    }
+    float inter = ix * iy;
+    return inter / (aw * ah + (float)b->w * b->h - inter);
+}
+
+/**
+ * @brief Match score of a detection against a track's prediction
+ * @return Above 1 for an overlap, (0, 1] for a nearby centre, 0 for no match
+ */
+static float match_score(const tracker_track_t *t, float px, float py, const tracker_detection_t *d)
+{
+    if (t->kind != d->kind) {
+        return 0.0f;
+    }
+
+    float iou = box_iou(px - t->w / 2.0f, py - t->h / 2.0f, (float)t->w, (float)t->h, d);
+    if (iou >= s_config.min_iou) {
+        return 1.0f + iou;
+    }
+
+    float size = (float)(t->w > t->h ? t->w : t->h);
+    float limit = s_config.max_distance * size;
+    float dist = hypotf(d->x + d->w / 2.0f - px, d->y + d->h / 2.0f - py);
+    return (limit > 0.0f && dist < limit) ? 1.0f - dist / limit : 0.0f;
+}
+
+static void start_track(const tracker_detection_t *d, int64_t now_ms)
+{
+    tracker_track_t *slot = NULL;
+
+    for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+        tracker_track_t *t = &s_tracks[i];
+        if (t->id == 0) {
+            slot = t;
+            break;
+        }
+        // Otherwise replace the track that has been lost the longest
+        if (t->misses > 0 && (!slot || t->misses > slot->misses)) {
+            slot = t;
+        }
+    }
+    if (!slot) {
+        return;
+    }
+
+    memset(slot, 0, sizeof(*slot));
+    slot->id = s_next_id++;
+    if (s_next_id == 0) {
+        s_next_id = 1;
+    }
+    slot->kind = d->kind;
+    slot->cx = slot->start_cx = d->x + d->w / 2.0f;
+    slot->cy = slot->start_cy = d->y + d->h / 2.0f;
+    slot->w = d->w;
+    slot->h = d->h;
+    slot->first_ms = now_ms;
+    slot->last_ms = now_ms;
+    slot->hits = 1;
+    slot->confirmed = s_config.confirm_hits <= 1;
+}
+
+int object_tracker_update(const tracker_detection_t *detections, int count, int64_t now_ms)
+{
+    float pred_x[TRACKER_MAX_TRACKS], pred_y[TRACKER_MAX_TRACKS];
+    float dt[TRACKER_MAX_TRACKS];
+    bool track_matched[TRACKER_MAX_TRACKS] = { false };
+    bool det_matched[TRACKER_MAX_DETECTIONS] = { false };
+
+    if (!s_initialized) {
+        object_tracker_init(NULL);
+    }
+    if (count > TRACKER_MAX_DETECTIONS) {
+        count = TRACKER_MAX_DETECTIONS;
+    }
+
+    // Predict every live track to now
+    for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+        const tracker_track_t *t = &s_tracks[i];
+        dt[i] = (float)(now_ms - t->last_ms) / 1000.0f;
+        pred_x[i] = t->cx + t->vx * dt[i];
+        pred_y[i] = t->cy + t->vy * dt[i];
+    }
+
+    // Greedy assignment, best pair first
+    while (1) {
+        float best = 0.0f;
+        int best_t = -1, best_d = -1;
+
+        for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+            if (s_tracks[i].id == 0 || track_matched[i]) {
+                continue;
+            }
+            for (int j = 0; j < count; j++) {
+                if (det_matched[j]) {
+                    continue;
+                }
+                float score = match_score(&s_tracks[i], pred_x[i], pred_y[i], &detections[j]);
+                if (score > best) {
+                    best = score;
+                    best_t = i;
+                    best_d = j;
+                }
+            }
+        }
+        if (best_t < 0) {
+            break;
+        }
+
+        tracker_track_t *t = &s_tracks[best_t];
+        const tracker_detection_t *d = &detections[best_d];
+        float rx = d->x + d->w / 2.0f - pred_x[best_t];
+        float ry = d->y + d->h / 2.0f - pred_y[best_t];
+
+        t->cx = pred_x[best_t] + s_config.alpha * rx;
+        t->cy = pred_y[best_t] + s_config.alpha * ry;
+        if (dt[best_t] > 0.0f) {
+            t->vx += s_config.beta * rx / dt[best_t];
+            t->vy += s_config.beta * ry / dt[best_t];
+        }
+        t->w = d->w;
+        t->h = d->h;
+        t->last_ms = now_ms;
+        t->misses = 0;
+        if (t->hits < UINT16_MAX) {
+            t->hits++;
+        }
+        if (!t->confirmed && t->hits >= s_config.confirm_hits) {
+            t->confirmed = true;
+            ESP_LOGD(TAG, "Track %u confirmed", t->id);
+        }
+
+        track_matched[best_t] = true;
+        det_matched[best_d] = true;
+    }
+
+    // Unmatched tracks coast on their prediction until they age out
+    int confirmed = 0;
+    for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+        tracker_track_t *t = &s_tracks[i];
+        if (t->id == 0) {
+            continue;
+        }
+        if (!track_matched[i]) {
+            if (++t->misses > s_config.max_misses) {
+                ESP_LOGD(TAG, "Track %u lost after %u hits", t->id, t->hits);
+                t->id = 0;
+                continue;
+            }
+            t->cx = pred_x[i];
+            t->cy = pred_y[i];
+            t->last_ms = now_ms;
+        }
+        confirmed += t->confirmed;
+    }
+
+    for (int j = 0; j < count; j++) {
+        if (!det_matched[j]) {
+            start_track(&detections[j], now_ms);
+        }
+    }
+
+    return confirmed;
+}
+
+/**
+ * @brief Copy confirmed tracks, longest-lived first, optionally only unreported ones
+ */
+static int copy_tracks(tracker_track_t *tracks, int max, bool unreported_only)
+{
+    int n = 0;
+
+    for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+        const tracker_track_t *t = &s_tracks[i];
+        if (t->id == 0 || !t->confirmed || (unreported_only && t->reported)) {
+            continue;
+        }
+
+        int pos = n < max ? n : max;
+        while (pos > 0 && tracks[pos - 1].first_ms > t->first_ms) {
+            pos--;
+        }
+        if (pos >= max) {
+            continue;
+        }
+        int tail = (n < max ? n : max - 1) - pos;
+        memmove(&tracks[pos + 1], &tracks[pos], tail * sizeof(tracker_track_t));
+        tracks[pos] = *t;
+        if (n < max) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+int object_tracker_get_tracks(tracker_track_t *tracks, int max)
+{
+    return copy_tracks(tracks, max, false);
+}
+
+int object_tracker_claim_unreported(tracker_track_t *tracks, int max)
+{
+    int n = copy_tracks(tracks, max, true);
+
+    for (int k = 0; k < n; k++) {
+        for (int i = 0; i < TRACKER_MAX_TRACKS; i++) {
+            if (s_tracks[i].id == tracks[k].id) {
+                s_tracks[i].reported = true;
+                tracks[k].reported = true;
+            }
+        }
+    }
+
+    return n;
+}
+
+static track_direction_t direction_of(float dx, float dy)
+{
+    bool horizontal = fabsf(dx) > 2.0f * fabsf(dy);
+    bool vertical = fabsf(dy) > 2.0f * fabsf(dx);
+
+    if (horizontal) {
+        return dx < 0 ? TRACK_DIR_LEFT : TRACK_DIR_RIGHT;
+    }
+    if (vertical) {
+        return dy < 0 ? TRACK_DIR_UP : TRACK_DIR_DOWN;
+    }
+    if (dy < 0) {
+        return dx < 0 ? TRACK_DIR_UP_LEFT : TRACK_DIR_UP_RIGHT;
+    }
+    return dx < 0 ? TRACK_DIR_DOWN_LEFT : TRACK_DIR_DOWN_RIGHT;
+}
+
+track_direction_t object_tracker_direction(const tracker_track_t *track)
+{
+    float half = (track->w > track->h ? track->w : track->h) / 2.0f;
+    float dx = track->cx - track->start_cx;
+    float dy = track->cy - track->start_cy;
+
+    if (hypotf(dx, dy) >= half) {
+        return direction_of(dx, dy);
+    }
+    if (hypotf(track->vx, track->vy) >= half) {
+        return direction_of(track->vx, track->vy);
+    }
+    return TRACK_DIR_NONE;
+}
+
+const char *object_tracker_direction_name(track_direction_t direction)
+{
+    switch (direction) {
+        case TRACK_DIR_LEFT:       return "left";
+        case TRACK_DIR_RIGHT:      return "right";
+        case TRACK_DIR_UP:         return "up";
+        case TRACK_DIR_DOWN:       return "down";
+        case TRACK_DIR_UP_LEFT:    return "up-left";
+        case TRACK_DIR_UP_RIGHT:   return "up-right";
+        case TRACK_DIR_DOWN_LEFT:  return "down-left";
+        case TRACK_DIR_DOWN_RIGHT: return "down-right";
+        case TRACK_DIR_NONE:
+        default:                   return "stationary";
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * @file skin_lut.c
+ * @brief RGB565 skin classification bitmap and the colour models that fill it
+ *
+ * A model is evaluated once for every RGB565 value when the table is built,
+ * so the per-pixel cost of classification is the same for every model.
+ */
+
+#include "skin_lut.h"
+#include <string.h>
+
+// Thresholds of the original per-pixel RGB test
+const skin_rgb_params_t SKIN_RGB_DEFAULT = {
+    .r_min = 60,
+    .g_min = 40,
+    .b_min = 20,
+    .rg_diff_min = 10,
+    .rg_diff_max = 100,
+};
+
+// Chai & Ngan chroma box
+const skin_ycbcr_params_t SKIN_YCBCR_DEFAULT = {
+    .y_min = 40,
+    .cb_min = 77, .cb_max = 127,
+    .cr_min = 133, .cr_max = 173,
+};
+
+// Hue 0-50 degrees, saturation 0.23-0.68, value above 0.35
+const skin_hsv_params_t SKIN_HSV_DEFAULT = {
+    .hue_min = 0, .hue_max = 50,
+    .sat_min = 58, .sat_max = 173,
+    .val_min = 90,
+};
+
+bool skin_model_rgb(uint8_t r, uint8_t g, uint8_t b, const void *params)
+{
+    const skin_rgb_params_t *p = params;
+
+    return r > p->r_min && g > p->g_min && b > p->b_min &&
+           r > g && r > b &&
+           r - g > p->rg_diff_min &&
+           r - g < p->rg_diff_max;
+}
+
+bool skin_model_ycbcr(uint8_t r, uint8_t g, uint8_t b, const void *params)
+{
+    const skin_ycbcr_params_t *p = params;
+
+    // BT.601 full range in 8.8 fixed point
+    int y  = (77 * r + 150 * g + 29 * b) >> 8;
+    int cb = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+    int cr = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+
+    return y >= p->y_min &&
+           cb >= p->cb_min && cb <= p->cb_max &&
+           cr >= p->cr_min && cr <= p->cr_max;
+}
+
+bool skin_model_hsv(uint8_t r, uint8_t g, uint8_t b, const void *params)
+{
+    const skin_hsv_params_t *p = params;
+
+    int max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+    int min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+    int delta = max - min;
+
+    if (max < p->val_min || delta == 0) {
+        return false;
+    }
+
+    int sat = delta * 255 / max;
+    if (sat < p->sat_min || sat > p->sat_max) {
+        return false;
+    }
+
+    int hue;
+    if (max == r) {
+        hue = 60 * (g - b) / delta;
+    } else if (max == g) {
+        hue = 120 + 60 * (b - r) / delta;
+    } else {
+        hue = 240 + 60 * (r - g) / delta;
+    }
+    if (hue < 0) {
+        hue += 360;
+    }
+
+    if (p->hue_min <= p->hue_max) {
+        return hue >= p->hue_min && hue <= p->hue_max;
+    }
+    return hue >= p->hue_min || hue <= p->hue_max;
+}
+
+uint32_t skin_lut_build(skin_lut_t *lut, skin_model_fn model, const void *params)
+{
+    uint32_t skin_values = 0;
+
+    memset(lut->bits, 0, sizeof(lut->bits));
+
+    for (uint32_t pixel = 0; pixel < 65536; pixel++) {
+        uint8_t r = (pixel >> 11) & 0x1F;
+        uint8_t g = (pixel >> 5) & 0x3F;
+        uint8_t b = pixel & 0x1F;
+
+        // Expand to 8-bit
+        r = (r << 3) | (r >> 2);
+        g = (g << 2) | (g >> 4);
+        b = (b << 3) | (b >> 2);
+
+        if (model(r, g, b, params)) {
+            lut->bits[pixel >> 5] |= 1u << (pixel & 31);
+            skin_values++;
+        }
+    }
+
+    return skin_values;
+}
+
+void skin_lut_swap_bytes(skin_lut_t *lut)
+{
+    for (uint32_t pixel = 0; pixel < 65536; pixel++) {
+        uint32_t swapped = ((pixel & 0xFF) << 8) | (pixel >> 8);
+
+        // Each pair once; values whose bytes are equal map onto themselves
+        if (swapped <= pixel) {
+            continue;
+        }
+        uint32_t a = (lut->bits[pixel >> 5] >> (pixel & 31)) & 1;
+        uint32_t b = (lut->bits[swapped >> 5] >> (swapped & 31)) & 1;
+        if (a != b) {
+            lut->bits[pixel >> 5] ^= 1u << (pixel & 31);
+            lut->bits[swapped >> 5] ^= 1u << (swapped & 31);
+        }
+    }
+}
@@ -0,0 +1,1317 @@
+/**
+ * @file detection_bench.c
+ * @brief Host benchmark that replays frame sequences through the detection core
+ *
+ * Frames are read from raw files (RGB565 in either byte order or 8-bit grayscale,
+ * one or more frames back to back per file), from JPEG files (one frame per
+ * file) or synthesized when no raw input is given. Every frame goes through the same calls detection_task makes and the
+ * harness reports ns/pixel, frames/sec and heap_caps allocations per frame
+ * for each kernel. Time between frames is the interval the capture-rate
+ * scheduler picks, as on the device. --verify also replays recorded
+ * getUpdates bodies through the command polling parser.
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "motion_detector.h"
+#include "motion_kernels.h"
+#include "jpeg_dc.h"
+#include "face_detector.h"
+#include "event_fsm.h"
+#include "alert_limiter.h"
+#include "object_tracker.h"
+#include "detection_scheduler.h"
+#include "telegram_updates.h"
+
+typedef enum {
+    FRAME_FORMAT_RGB565,
+    FRAME_FORMAT_GRAY,
+    FRAME_FORMAT_JPEG
+} frame_format_t;
+
+// Largest DC thumbnail accepted in JPEG mode (2048x2048 source)
+#define JPEG_THUMB_MAX (256 * 256)
+
+// Face result storage, as the analyze stage sizes it
+#define BENCH_MAX_FACES 8
+
+// Capture-rate scheduler as configured by default on the device; the
+// activity threshold is half the motion change percentage, set at startup
+static scheduler_config_t s_bench_scheduler = {
+    .min_interval_ms = 100,
+    .base_interval_ms = 500,
+    .max_interval_ms = 4000,
+    .backoff_percent = 200,
+    .face_policy = FACE_POLICY_AFTER_MOTION,
+    .face_hold_ms = 3000,
+};
+
+// Event confirmation as configured by default on the device
+static const event_fsm_config_t BENCH_EVENTS = {
+    .confirm_frames = 2,
+    .window_frames = 3,
+    .min_duration_ms = 0,
+    .end_quiet_ms = 3000,
+    .cooldown_ms = 10000,
+};
+
+// Alert budgets as configured by default on the device
+static const alert_budget_t BENCH_BUDGETS[ALERT_CLASS_COUNT] = {
+    [ALERT_CLASS_MOTION] = { 3, 30000 },
+    [ALERT_CLASS_FACE] = { 5, 10000 },
+};
+
+typedef struct {
+    frame_format_t format;
+    int width;
+    int height;
+    int scale;
+    bool big_endian;
+    int synthetic_frames;
+    int repeat;
+    int motion_threshold;
+    float motion_change;
+    double max_ns_per_pixel;
+    const char *skin_model;
+    motion_zone_config_t zones;
+    motion_engine_t engine;
+    bool flicker;
+    bool light_step;
+    bool verify;
+    bool verbose;
+} bench_config_t;
+
+typedef struct {
+    uint8_t *data;          ///< All frames, back to back
+    size_t frame_bytes;     ///< Bytes per frame (raw formats)
+    size_t *offsets;        ///< Start of each frame (JPEG)
+    size_t *lengths;        ///< Length of each frame (JPEG)
+    size_t total_bytes;     ///< Bytes used in data (JPEG)
+    int count;              ///< Number of frames
+} frame_sequence_t;
+
+typedef struct {
+    const char *name;
+    uint64_t ns;
+    uint64_t pixels;
+    uint32_t frames;
+    uint32_t allocs;
+    size_t alloc_bytes;
+} kernel_stat_t;
+
+enum {
+    KERNEL_GRAYSCALE,
+    KERNEL_JPEG_DC,
+    KERNEL_MOTION,
+    KERNEL_FACE,
+    KERNEL_COUNT
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Small deterministic PRNG so synthetic sequences are reproducible
+ */
+static uint32_t lcg_next(uint32_t *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+static uint16_t pack_rgb565(int r, int g, int b)
+{
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static int clamp_u8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/**
+ * @brief Position of the synthetic square in frame f of count
+ * @return true if the square is in the frame
+ */
+static bool synthetic_box(const bench_config_t *cfg, int f, int count, int *x, int *y, int *size)
+{
+    *size = cfg->height / 3;
+    *x = (f * 4) % (cfg->width - *size);
+    *y = (cfg->height - *size) / 2;
+
+    // The box appears for the middle half of the sequence
+    return f >= count / 4 && f < count * 3 / 4;
+}
+
+/**
+ * @brief Whether (x, y) lies in the flickering strip of --flicker, the top
+ *        quarter of the right quarter of the frame, clear of the square
+ */
+static bool in_flicker_strip(const bench_config_t *cfg, int x, int y)
+{
+    return cfg->flicker && x >= cfg->width * 3 / 4 && y < cfg->height / 4;
+}
+
+/**
+ * @brief Generate a sequence with a textured, noisy background and a
+ *        skin-toned square that sweeps across the middle of the frame
+ *
+ * With --flicker, pixels in a strip swing by +-30 every two frames with
+ * their own phase, like foliage in wind, and never count as motion. With
+ * --light-step the whole scene brightens by 25% + 20 from frame count/8 on,
+ * like a room light switching on.
+ */
+static bool synthesize_sequence(const bench_config_t *cfg, frame_sequence_t *seq)
+{
+    const int bpp = (cfg->format == FRAME_FORMAT_RGB565) ? 2 : 1;
+    uint32_t rng = 0x12345678u;
+
+    seq->frame_bytes = (size_t)cfg->width * cfg->height * bpp;
+    seq->count = cfg->synthetic_frames;
+    seq->data = malloc(seq->frame_bytes * seq->count);
+    if (!seq->data) {
+        return false;
+    }
+
+    for (int f = 0; f < seq->count; f++) {
+        uint8_t *frame = seq->data + seq->frame_bytes * f;
+        int box_x, box_y, box;
+        bool box_visible = synthetic_box(cfg, f, seq->count, &box_x, &box_y, &box);
+        bool lit = cfg->light_step && f >= seq->count / 8;
+
+        for (int y = 0; y < cfg->height; y++) {
+            for (int x = 0; x < cfg->width; x++) {
+                int noise = (int)(lcg_next(&rng) % 5) - 2;
+                int base = 40 + ((x * 3 + y * 2) & 0x7F);
+                if (in_flicker_strip(cfg, x, y)) {
+                    uint32_t phase = ((uint32_t)x * 7 + (uint32_t)y * 13) >> 1;
+                    base += ((f + phase) & 2) ? 30 : -30;
+                }
+                int r = base, g = base, b = base;
+
+                if (box_visible && x >= box_x && x < box_x + box &&
+                    y >= box_y && y < box_y + box) {
+                    r = 200; g = 140; b = 110;
+                }
+
+                if (lit) {
+                    r = r * 5 / 4 + 20;
+                    g = g * 5 / 4 + 20;
+                    b = b * 5 / 4 + 20;
+                }
+                r = clamp_u8(r + noise);
+                g = clamp_u8(g + noise);
+                b = clamp_u8(b + noise);
+
+                size_t idx = (size_t)y * cfg->width + x;
+                if (bpp == 2) {
+                    uint16_t px = pack_rgb565(r, g, b);
+                    frame[idx * 2] = cfg->big_endian ? px >> 8 : px & 0xFF;
+                    frame[idx * 2 + 1] = cfg->big_endian ? px & 0xFF : px >> 8;
+                } else {
+                    frame[idx] = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Append every whole frame found in a raw file to the sequence
+ */
+static bool load_raw_file(const char *path, frame_sequence_t *seq)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    int frames = (int)(size / (long)seq->frame_bytes);
+    if (frames == 0) {
+        fprintf(stderr, "%s: smaller than one %zu-byte frame\n", path, seq->frame_bytes);
+        fclose(fp);
+        return false;
+    }
+    if (size % (long)seq->frame_bytes) {
+        fprintf(stderr, "%s: ignoring %ld trailing bytes\n", path, size % (long)seq->frame_bytes);
+    }
+
+    uint8_t *grown = realloc(seq->data, seq->frame_bytes * (seq->count + frames));
+    if (!grown) {
+        fclose(fp);
+        return false;
+    }
+    seq->data = grown;
+
+    size_t want = seq->frame_bytes * frames;
+    size_t got = fread(seq->data + seq->frame_bytes * seq->count, 1, want, fp);
+    fclose(fp);
+    if (got != want) {
+        fprintf(stderr, "%s: short read\n", path);
+        return false;
+    }
+
+    seq->count += frames;
+    return true;
+}
+
+/**
+ * @brief Append a JPEG file to the sequence as a single frame
+ */
+static bool load_jpeg_file(const char *path, frame_sequence_t *seq)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t *data = realloc(seq->data, seq->total_bytes + size);
+    size_t *offsets = realloc(seq->offsets, sizeof(size_t) * (seq->count + 1));
+    size_t *lengths = offsets ? realloc(seq->lengths, sizeof(size_t) * (seq->count + 1)) : NULL;
+    if (data) seq->data = data;
+    if (offsets) seq->offsets = offsets;
+    if (lengths) seq->lengths = lengths;
+    if (!data || !offsets || !lengths || size <= 0) {
+        fclose(fp);
+        return false;
+    }
+
+    size_t got = fread(seq->data + seq->total_bytes, 1, size, fp);
+    fclose(fp);
+    if (got != (size_t)size) {
+        fprintf(stderr, "%s: short read\n", path);
+        return false;
+    }
+
+    seq->offsets[seq->count] = seq->total_bytes;
+    seq->lengths[seq->count] = got;
+    seq->total_bytes += got;
+    seq->count++;
+    return true;
+}
+
+static void free_sequence(frame_sequence_t *seq)
+{
+    free(seq->data);
+    free(seq->offsets);
+    free(seq->lengths);
+}
+
+static void kernel_begin(host_heap_stats_t *heap, uint64_t *t0)
+{
+    host_heap_get_stats(heap);
+    *t0 = now_ns();
+}
+
+static void kernel_end(kernel_stat_t *stat, const host_heap_stats_t *heap_before,
+                       uint64_t t0, uint64_t pixels)
+{
+    uint64_t t1 = now_ns();
+    host_heap_stats_t heap_after;
+    host_heap_get_stats(&heap_after);
+
+    stat->ns += t1 - t0;
+    stat->pixels += pixels;
+    stat->frames++;
+    stat->allocs += heap_after.alloc_count - heap_before->alloc_count;
+    stat->alloc_bytes += heap_after.alloc_bytes - heap_before->alloc_bytes;
+}
+
+/**
+ * @brief Run the selected diff/blend kernel and the scalar reference side by
+ *        side on shadow baselines and compare counts and blended output
+ *
+ * The length is shortened by up to 15 pixels per frame so the scalar tail
+ * of the SIMD path is exercised as well.
+ */
+static bool verify_motion_kernel(uint8_t *simd_base, uint8_t *ref_base, const uint8_t *frame,
+                                 size_t len, uint8_t threshold, int frame_index)
+{
+    if (frame_index == 0) {
+        memcpy(simd_base, frame, len);
+        memcpy(ref_base, frame, len);
+        return true;
+    }
+
+    size_t n = len - (size_t)(frame_index % 16);
+    uint32_t simd_count = motion_kernel_diff_blend(simd_base, frame, n, threshold);
+    uint32_t ref_count = motion_kernel_diff_blend_ref(ref_base, frame, n, threshold);
+
+    if (simd_count != ref_count || memcmp(simd_base, ref_base, len) != 0) {
+        fprintf(stderr, "verify: %s kernel differs from reference on frame %d (count %u vs %u)\n",
+                motion_kernel_impl_name(), frame_index, simd_count, ref_count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Check the per-cell kernel against the scalar reference run cell by
+ *        cell, on a second pair of shadow baselines
+ *
+ * Cells get varying thresholds and every fifth cell is masked, so masking
+ * and per-cell thresholds are exercised as well.
+ */
+static bool verify_motion_cells(uint8_t *cell_base, uint8_t *ref_base, const uint8_t *frame,
+                                int width, int height, uint8_t threshold, int frame_index,
+                                uint8_t *thresholds, uint16_t *cells, uint16_t *ref_cells)
+{
+    size_t len = (size_t)width * height;
+    int grid_w = (width + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+    int grid_h = (height + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE;
+    size_t grid_bytes = (size_t)grid_w * grid_h * sizeof(uint16_t);
+
+    if (frame_index == 0) {
+        memcpy(cell_base, frame, len);
+        memcpy(ref_base, frame, len);
+        for (int c = 0; c < grid_w * grid_h; c++) {
+            thresholds[c] = (c % 5 == 4) ? MOTION_CELL_MASKED : (uint8_t)(threshold + c % 4);
+        }
+        return true;
+    }
+
+    uint32_t ref_count = 0;
+    memset(ref_cells, 0, grid_bytes);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x += MOTION_CELL_SIZE) {
+            int c = (y / MOTION_CELL_SIZE) * grid_w + x / MOTION_CELL_SIZE;
+            size_t i = (size_t)y * width + x;
+            size_t n = (size_t)(width - x < MOTION_CELL_SIZE ? width - x : MOTION_CELL_SIZE);
+            if (thresholds[c] != MOTION_CELL_MASKED) {
+                uint32_t count = motion_kernel_diff_blend_ref(ref_base + i, frame + i, n, thresholds[c]);
+                ref_cells[c] += (uint16_t)count;
+                ref_count += count;
+            }
+        }
+    }
+
+    uint32_t count = motion_kernel_diff_blend_cells(cell_base, frame, width, height, MOTION_CELL_SIZE,
+                                                    thresholds, cells);
+
+    if (count != ref_count || memcmp(cells, ref_cells, grid_bytes) != 0 ||
+        memcmp(cell_base, ref_base, len) != 0) {
+        fprintf(stderr, "verify: per-cell kernel differs from reference on frame %d (count %u vs %u)\n",
+                frame_index, count, ref_count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Drive variance model pixels towards saturation and check that the
+ *        packed 16-bit variance never wraps
+ *
+ * Pixels start at a dark mean with variances near the top of the range and
+ * see full white for a number of frames, as a strobe or high-contrast edge
+ * would produce. A legitimate update shrinks the variance by at most
+ * 1/2^BG_SHIFT per frame; a wrapped band falls much further.
+ */
+static bool verify_variance_saturation(void)
+{
+    enum { W = 16, FRAMES = 64 };
+    static const uint16_t start[] = { MOTION_VAR_INIT_Q4, 16000, 30000, 60000, 62500, 65000, 0xFFFF };
+    uint32_t model[W];
+    uint8_t frame[W];
+    uint8_t threshold = 15;
+    uint16_t changed[1];
+
+    for (int i = 0; i < W; i++) {
+        uint16_t var = start[i % (sizeof(start) / sizeof(start[0]))];
+        model[i] = (10u << 8) | ((uint32_t)var << 16);
+        frame[i] = 255;
+    }
+
+    for (int f = 0; f < FRAMES; f++) {
+        uint32_t before[W];
+        memcpy(before, model, sizeof(model));
+        motion_kernel_variance_cells(model, frame, W, 1, MOTION_CELL_SIZE, &threshold, changed);
+        for (int i = 0; i < W; i++) {
+            uint32_t prev = before[i] >> 16;
+            uint32_t var = model[i] >> 16;
+            if (var + (prev >> MOTION_VAR_BG_SHIFT) + 1 < prev) {
+                fprintf(stderr, "verify: variance of pixel %d wrapped from %u to %u on frame %d\n",
+                        i, prev, var, f);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check one scheduler update against the documented policy
+ *
+ * Rising activity halves the interval from at most the base, steady
+ * activity holds it at or below the base, and a quiet frame grows it by
+ * backoff_percent up to the maximum.
+ */
+static bool verify_scheduler_update(const scheduler_config_t *sc, uint32_t prev_interval,
+                                    float prev_change, float change, bool detected, int frame_index)
+{
+    scheduler_stats_t stats;
+    detection_scheduler_get_stats(&stats);
+
+    const bool active = detected || change >= sc->activity_threshold;
+    const uint32_t capped = prev_interval < sc->base_interval_ms ? prev_interval : sc->base_interval_ms;
+    scheduler_decision_t decision;
+    uint32_t interval;
+
+    if (active && change > prev_change) {
+        decision = SCHEDULER_DECISION_SPEED_UP;
+        interval = capped / 2 < sc->min_interval_ms ? sc->min_interval_ms : capped / 2;
+    } else if (active) {
+        decision = SCHEDULER_DECISION_HOLD;
+        interval = capped;
+    } else {
+        uint64_t grown = (uint64_t)prev_interval * sc->backoff_percent / 100;
+        grown = grown > prev_interval ? grown : prev_interval + 1;
+        decision = SCHEDULER_DECISION_BACK_OFF;
+        interval = grown > sc->max_interval_ms ? sc->max_interval_ms : (uint32_t)grown;
+    }
+
+    if (stats.last_decision != decision || stats.interval_ms != interval ||
+        interval < sc->min_interval_ms || interval > sc->max_interval_ms) {
+        fprintf(stderr, "verify: scheduler on frame %d chose %s at %u ms, expected %s at %u ms\n",
+                frame_index, detection_scheduler_decision_name(stats.last_decision), stats.interval_ms,
+                detection_scheduler_decision_name(decision), interval);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Check a face detection decision against the configured policy
+ * @param last_motion_ms Time of the last frame with motion, including this one, or -1
+ */
+static bool verify_scheduler_face(const scheduler_config_t *sc, bool due, bool detected,
+                                  int64_t last_motion_ms, int64_t now_ms, int frame_index)
+{
+    bool expected;
+
+    switch (sc->face_policy) {
+        case FACE_POLICY_ON_MOTION:
+            expected = detected;
+            break;
+        case FACE_POLICY_AFTER_MOTION:
+            expected = last_motion_ms >= 0 && now_ms - last_motion_ms <= (int64_t)sc->face_hold_ms;
+            break;
+        case FACE_POLICY_ALWAYS:
+        default:
+            expected = true;
+            break;
+    }
+
+    if (due != expected) {
+        fprintf(stderr, "verify: face detection on frame %d was %s, expected %s\n",
+                frame_index, due ? "due" : "skipped", expected ? "due" : "skipped");
+        return false;
+    }
+    return true;
+}
+
+#define UPDATES_CHAT "42"
+
+/**
+ * @brief One getUpdates body and what polling should make of it
+ *
+ * Bodies are fed to a poller that has already synchronized at offset 10.
+ */
+typedef struct {
+    const char *name;
+    const char *body;
+    bool accepted;
+    long long offset;           ///< Offset afterwards
+    int count;
+    const char *commands[3];
+} updates_case_t;
+
+static char s_long_text[1400];
+
+static const updates_case_t UPDATES_CASES[] = {
+    {
+        "two commands",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{\"message_id\":1,"
+        "\"chat\":{\"id\":42,\"type\":\"private\"},\"date\":1700000000,\"text\":\"/arm\"}},"
+        "{\"update_id\":11,\"message\":{\"text\":\"/zone 10 20 30 40\",\"chat\":{\"id\":42}}}]}",
+        true, 12, 2, { "/arm", "/zone 10 20 30 40" },
+    },
+    {
+        "escapes",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{\"chat\":{\"id\":42},"
+        "\"text\":\"/say \\\"hi\\\" \\\\ \\u00e9\\u20AC\\/\\n\"}}]}",
+        true, 11, 1, { "/say \"hi\" \\ \xc3\xa9\xe2\x82\xac/\n" },
+    },
+    {
+        "nested fields",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{"
+        "\"from\":{\"id\":42,\"is_bot\":false,\"first_name\":\"A\",\"text\":\"/from\"},"
+        "\"entities\":[{\"offset\":0,\"length\":7,\"type\":\"bot_command\"}],"
+        "\"photo\":[[1,2,{\"text\":\"/photo\"}],[]],"
+        "\"reply_to_message\":{\"text\":\"/disarm\",\"chat\":{\"id\":7}},"
+        "\"chat\":{\"id\":42,\"pinned\":{\"chat\":{\"id\":7}}},"
+        "\"text\":\"/status\",\"caption\":null}}],"
+        "\"extra\":{\"result\":[{\"update_id\":99}]}}",
+        true, 11, 1, { "/status" },
+    },
+    {
+        "other chat",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{\"text\":\"/disarm\",\"chat\":{\"id\":7}}},"
+        "{\"update_id\":11,\"message\":{\"text\":\"/status\",\"chat\":{\"id\":42}}}]}",
+        true, 12, 1, { "/status" },
+    },
+    {
+        "no updates",
+        "{\"ok\":true,\"result\":[]}",
+        true, 10, 0, { NULL },
+    },
+    {
+        "rate limited",
+        "{\"ok\":false,\"error_code\":429,\"description\":\"Too Many Requests\","
+        "\"parameters\":{\"retry_after\":7},\"result\":[{\"update_id\":10}]}",
+        false, 10, 0, { NULL },
+    },
+    {
+        "mismatched bracket",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{\"text\":\"/arm\",\"chat\":{\"id\":42}}}}",
+        false, 10, 0, { NULL },
+    },
+    {
+        "bad escape",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{\"text\":\"/a\\u00zz\",\"chat\":{\"id\":42}}}]}",
+        false, 10, 0, { NULL },
+    },
+    {
+        "trailing data",
+        "{\"ok\":true,\"result\":[{\"update_id\":10,\"message\":{\"text\":\"/arm\",\"chat\":{\"id\":42}}}]}"
+        "{\"ok\":true}",
+        false, 10, 0, { NULL },
+    },
+};
+
+/**
+ * @brief Feed a body in chunks of the given size and accept it if complete
+ */
+static bool updates_replay(telegram_updates_t *u, const char *body, size_t len, size_t chunk)
+{
+    telegram_updates_begin(u);
+    for (size_t pos = 0; pos < len; pos += chunk) {
+        size_t n = len - pos < chunk ? len - pos : chunk;
+        if (!telegram_updates_feed(u, body + pos, n)) {
+            break;
+        }
+    }
+    return telegram_updates_finish(u);
+}
+
+/**
+ * @brief Start a poller as if its first response had been seen at offset 10
+ */
+static void updates_synced(telegram_updates_t *u)
+{
+    static const char sync[] = "{\"ok\":true,\"result\":[{\"update_id\":9,"
+                               "\"message\":{\"text\":\"/arm\",\"chat\":{\"id\":42}}}]}";
+    telegram_updates_init(u, UPDATES_CHAT);
+    updates_replay(u, sync, sizeof(sync) - 1, sizeof(sync));
+}
+
+static bool updates_check(const telegram_updates_t *u, bool accepted, const updates_case_t *c,
+                          size_t chunk, size_t len)
+{
+    bool ok = accepted == c->accepted && u->offset == c->offset &&
+              (!accepted || u->count == c->count);
+    for (int i = 0; ok && accepted && i < c->count; i++) {
+        ok = strcmp(u->commands[i], c->commands[i]) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "verify: getUpdates \"%s\" (%zu of %zu bytes, %zu per read) %s at offset %lld "
+                "with %d commands, expected %s at offset %lld with %d\n",
+                c->name, len, strlen(c->body), chunk, accepted ? "accepted" : "rejected",
+                u->offset, accepted ? u->count : 0, c->accepted ? "accepted" : "rejected",
+                c->offset, c->count);
+    }
+    return ok;
+}
+
+/**
+ * @brief Replay recorded getUpdates bodies through the command polling parser
+ *
+ * Every body is read in every chunk size so each byte lands on a read
+ * boundary once, and every body cut short must leave the offset where it
+ * was: an update is confirmed only by a response that parsed to its end.
+ */
+static bool verify_updates(void)
+{
+    telegram_updates_t u;
+    bool ok = true;
+
+    // The first response only synchronizes: its commands predate startup
+    telegram_updates_init(&u, UPDATES_CHAT);
+    if (telegram_updates_request_offset(&u) != -1 || !updates_replay(&u, UPDATES_CASES[0].body,
+        strlen(UPDATES_CASES[0].body), 64) || u.count != 0 || u.offset != 12 ||
+        telegram_updates_request_offset(&u) != 12) {
+        fprintf(stderr, "verify: first getUpdates response ran %d commands, offset %lld\n",
+                u.count, u.offset);
+        ok = false;
+    }
+
+    for (size_t i = 0; ok && i < sizeof(UPDATES_CASES) / sizeof(UPDATES_CASES[0]); i++) {
+        const updates_case_t *c = &UPDATES_CASES[i];
+        const size_t len = strlen(c->body);
+
+        for (size_t chunk = 1; ok && chunk <= len; chunk++) {
+            updates_synced(&u);
+            ok = updates_check(&u, updates_replay(&u, c->body, len, chunk), c, chunk, len);
+        }
+
+        // A good body cut off anywhere confirms nothing
+        const updates_case_t cut = { c->name, c->body, false, 10, 0, { NULL } };
+        for (size_t n = 0; ok && c->accepted && n < len; n++) {
+            updates_synced(&u);
+            ok = updates_check(&u, updates_replay(&u, c->body, n, 7), &cut, 7, n);
+        }
+    }
+
+    // A 429 is rejected but still tells how long to wait
+    if (ok) {
+        const updates_case_t *c = &UPDATES_CASES[5];
+        updates_synced(&u);
+        updates_replay(&u, c->body, strlen(c->body), 5);
+        if (u.retry_after != 7 || strcmp(u.description, "Too Many Requests") != 0) {
+            fprintf(stderr, "verify: getUpdates 429 gave retry_after %d, description \"%s\"\n",
+                    u.retry_after, u.description);
+            ok = false;
+        }
+    }
+
+    // Strings longer than the parser and command buffers are cut, not overrun
+    if (ok) {
+        char text[400];
+        memset(text, 'a', sizeof(text) - 1);
+        text[0] = '/';
+        text[sizeof(text) - 1] = '\0';
+        snprintf(s_long_text, sizeof(s_long_text),
+                 "{\"ok\":true,\"description\":\"%s\",\"result\":[{\"update_id\":10,"
+                 "\"message\":{\"%s\":1,\"chat\":{\"id\":42},\"text\":\"%s\"}}]}",
+                 text, text + 1, text);
+        updates_synced(&u);
+        const bool accepted = updates_replay(&u, s_long_text, strlen(s_long_text), 13);
+        if (!accepted || u.count != 1 || strlen(u.commands[0]) != TELEGRAM_COMMAND_MAX - 1 ||
+            strncmp(u.commands[0], text, TELEGRAM_COMMAND_MAX - 1) != 0 ||
+            strlen(u.description) != sizeof(u.description) - 1) {
+            fprintf(stderr, "verify: oversize getUpdates strings were %s, command of %zu bytes\n",
+                    accepted ? "accepted" : "rejected", accepted ? strlen(u.commands[0]) : 0);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief Cell and frame level agreement with the synthetic ground truth
+ */
+typedef struct {
+    uint64_t true_cells;        ///< Moving cells that overlap the square
+    uint64_t false_cells;       ///< Moving cells away from the square
+    uint64_t missed_cells;      ///< Square cells not reported as moving
+    uint32_t false_frames;      ///< Motion reported with no square in view
+    uint32_t idle_frames;
+    uint32_t missed_frames;     ///< Square in view, no motion reported
+    uint32_t object_frames;
+} accuracy_t;
+
+/**
+ * @brief Score one frame's motion map against the square's position
+ *
+ * A cell is ground truth when the square covers at least
+ * MOTION_CELL_ACTIVE_PERCENT of it, the same share that makes a cell move.
+ */
+static void score_motion(const bench_config_t *cfg, int f, int count, const motion_result_t *motion,
+                         const motion_map_t *map, int motion_width, int motion_height,
+                         accuracy_t *acc)
+{
+    int bx, by, size;
+    bool visible = synthetic_box(cfg, f, count, &bx, &by, &size);
+
+    bx /= cfg->scale;
+    by /= cfg->scale;
+    size /= cfg->scale;
+
+    if (visible) {
+        acc->object_frames++;
+        acc->missed_frames += !motion->detected;
+    } else {
+        acc->idle_frames++;
+        acc->false_frames += motion->detected;
+    }
+
+    for (int gy = 0; gy < map->grid_h; gy++) {
+        for (int gx = 0; gx < map->grid_w; gx++) {
+            int x0 = gx * map->cell_size, y0 = gy * map->cell_size;
+            int x1 = x0 + map->cell_size < motion_width ? x0 + map->cell_size : motion_width;
+            int y1 = y0 + map->cell_size < motion_height ? y0 + map->cell_size : motion_height;
+            uint32_t pixels = (uint32_t)(x1 - x0) * (y1 - y0);
+            uint32_t changed = map->cell_changed[gy * map->grid_w + gx];
+            bool moving = changed > 0 && changed * 100 >= pixels * MOTION_CELL_ACTIVE_PERCENT;
+
+            int ox = (x1 < bx + size ? x1 : bx + size) - (x0 > bx ? x0 : bx);
+            int oy = (y1 < by + size ? y1 : by + size) - (y0 > by ? y0 : by);
+            bool truth = visible && ox > 0 && oy > 0 &&
+                         (uint32_t)ox * oy * 100 >= pixels * MOTION_CELL_ACTIVE_PERCENT;
+
+            acc->true_cells += moving && truth;
+            acc->false_cells += moving && !truth;
+            acc->missed_cells += !moving && truth;
+        }
+    }
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [options] [frames.raw ...]\n"
+           "\n"
+           "Replays raw frames through the detection core and reports per-kernel cost.\n"
+           "Each raw file may hold any number of frames back to back; each JPEG file is\n"
+           "one frame. Without files a synthetic raw sequence is generated.\n"
+           "\n"
+           "  -f, --format FMT          rgb565, gray or jpeg (default rgb565)\n"
+           "  -b, --big-endian          RGB565 pixels are stored high byte first\n"
+           "  -W, --width N             frame width (default 320)\n"
+           "  -H, --height N            frame height (default 240)\n"
+           "  -s, --scale N             motion downsampling factor 1, 2 or 4 (default 1)\n"
+           "  -n, --frames N            synthetic frame count (default 200)\n"
+           "  -r, --repeat N            replay the sequence N times (default 1)\n"
+           "  -t, --threshold N         motion pixel threshold (default 15)\n"
+           "  -c, --change PCT          motion change percentage (default 5)\n"
+           "      --max-ns-per-pixel X  exit with status 2 if any kernel is slower\n"
+           "      --skin-model M        face skin model rgb, ycbcr or hsv (default rgb)\n"
+           "      --zone X,Y,W,H[,T[,WT]]  motion zone in percent with threshold T and\n"
+           "                            weight WT (0 masks it); may be repeated\n"
+           "      --outside-weight N    weight of motion cells outside every zone (default 100)\n"
+           "      --engine E            motion background model blend or variance (default blend)\n"
+           "      --flicker             add a flickering strip to the synthetic sequence\n"
+           "      --light-step          brighten the synthetic scene at frame count/8\n"
+           "      --verify              check the %s motion kernel against the scalar\n"
+           "                            reference, the variance model at saturation and\n"
+           "                            the scheduler decisions, and replay getUpdates\n"
+           "                            bodies through the command parser (exit status 3\n"
+           "                            on mismatch)\n"
+           "  -v, --verbose             print detector logs\n"
+           "  -h, --help                show this help\n",
+           prog, motion_kernel_impl_name());
+}
+
+static bool parse_args(int argc, char **argv, bench_config_t *cfg, int *first_file)
+{
+    static const struct option long_opts[] = {
+        {"format",           required_argument, NULL, 'f'},
+        {"big-endian",       no_argument,       NULL, 'b'},
+        {"scale",            required_argument, NULL, 's'},
+        {"width",            required_argument, NULL, 'W'},
+        {"height",           required_argument, NULL, 'H'},
+        {"frames",           required_argument, NULL, 'n'},
+        {"repeat",           required_argument, NULL, 'r'},
+        {"threshold",        required_argument, NULL, 't'},
+        {"change",           required_argument, NULL, 'c'},
+        {"max-ns-per-pixel", required_argument, NULL, 'm'},
+        {"skin-model",       required_argument, NULL, 'S'},
+        {"zone",             required_argument, NULL, 'Z'},
+        {"outside-weight",   required_argument, NULL, 'O'},
+        {"engine",           required_argument, NULL, 'E'},
+        {"flicker",          no_argument,       NULL, 'F'},
+        {"light-step",       no_argument,       NULL, 'L'},
+        {"verify",           no_argument,       NULL, 'V'},
+        {"verbose",          no_argument,       NULL, 'v'},
+        {"help",             no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:bW:H:s:n:r:t:c:vh", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'f':
+                if (strcmp(optarg, "rgb565") == 0) {
+                    cfg->format = FRAME_FORMAT_RGB565;
+                } else if (strcmp(optarg, "gray") == 0) {
+                    cfg->format = FRAME_FORMAT_GRAY;
+                } else if (strcmp(optarg, "jpeg") == 0) {
+                    cfg->format = FRAME_FORMAT_JPEG;
+                } else {
+                    fprintf(stderr, "unknown format '%s'\n", optarg);
+                    return false;
+                }
+                break;
+            case 'b': cfg->big_endian = true; break;
+            case 's': cfg->scale = atoi(optarg); break;
+            case 'W': cfg->width = atoi(optarg); break;
+            case 'H': cfg->height = atoi(optarg); break;
+            case 'n': cfg->synthetic_frames = atoi(optarg); break;
+            case 'r': cfg->repeat = atoi(optarg); break;
+            case 't': cfg->motion_threshold = atoi(optarg); break;
+            case 'c': cfg->motion_change = strtof(optarg, NULL); break;
+            case 'm': cfg->max_ns_per_pixel = strtod(optarg, NULL); break;
+            case 'S': cfg->skin_model = optarg; break;
+            case 'Z': {
+                unsigned x, y, w, h, t = 0, wt = 100;
+                if (cfg->zones.zone_count >= MOTION_MAX_ZONES ||
+                    sscanf(optarg, "%u,%u,%u,%u,%u,%u", &x, &y, &w, &h, &t, &wt) < 4 ||
+                    t > 255 || wt > 255) {
+                    fprintf(stderr, "invalid zone '%s'\n", optarg);
+                    return false;
+                }
+                cfg->zones.zones[cfg->zones.zone_count++] = (motion_zone_t){
+                    .x = (uint8_t)x, .y = (uint8_t)y, .w = (uint8_t)w, .h = (uint8_t)h,
+                    .threshold = (uint8_t)t, .weight = (uint8_t)wt,
+                };
+                break;
+            }
+            case 'O': cfg->zones.default_weight = (uint8_t)atoi(optarg); break;
+            case 'E':
+                if (strcmp(optarg, "blend") == 0) {
+                    cfg->engine = MOTION_ENGINE_BLEND;
+                } else if (strcmp(optarg, "variance") == 0) {
+                    cfg->engine = MOTION_ENGINE_VARIANCE;
+                } else {
+                    fprintf(stderr, "unknown motion engine '%s'\n", optarg);
+                    return false;
+                }
+                break;
+            case 'F': cfg->flicker = true; break;
+            case 'L': cfg->light_step = true; break;
+            case 'V': cfg->verify = true; break;
+            case 'v': cfg->verbose = true; break;
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                return false;
+        }
+    }
+
+    if (cfg->width < 32 || cfg->height < 32 || cfg->synthetic_frames < 1 || cfg->repeat < 1) {
+        fprintf(stderr, "invalid frame geometry or counts\n");
+        return false;
+    }
+    if (strcmp(cfg->skin_model, "rgb") != 0 && strcmp(cfg->skin_model, "ycbcr") != 0 &&
+        strcmp(cfg->skin_model, "hsv") != 0) {
+        fprintf(stderr, "unknown skin model '%s'\n", cfg->skin_model);
+        return false;
+    }
+    if (cfg->scale != 1 && cfg->scale != 2 && cfg->scale != 4) {
+        fprintf(stderr, "scale must be 1, 2 or 4\n");
+        return false;
+    }
+    if (cfg->format != FRAME_FORMAT_RGB565 && cfg->scale != 1) {
+        fprintf(stderr, "downsampling only applies to rgb565 input\n");
+        return false;
+    }
+
+    *first_file = optind;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bench_config_t cfg = {
+        .format = FRAME_FORMAT_RGB565,
+        .width = 320,
+        .height = 240,
+        .scale = 1,
+        .big_endian = false,
+        .synthetic_frames = 200,
+        .repeat = 1,
+        .motion_threshold = 15,
+        .motion_change = 5.0f,
+        .max_ns_per_pixel = 0.0,
+        .skin_model = "rgb",
+        .zones = { .default_weight = 100 },
+        .engine = MOTION_ENGINE_BLEND,
+        .flicker = false,
+        .light_step = false,
+        .verify = false,
+        .verbose = false,
+    };
+    int first_file = 0;
+
+    if (!parse_args(argc, argv, &cfg, &first_file)) {
+        return 1;
+    }
+    host_log_set_level(cfg.verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+    const bool jpeg = (cfg.format == FRAME_FORMAT_JPEG);
+    const int bpp = (cfg.format == FRAME_FORMAT_RGB565) ? 2 : 1;
+    frame_sequence_t seq = {
+        .data = NULL,
+        .frame_bytes = (size_t)cfg.width * cfg.height * bpp,
+        .offsets = NULL,
+        .lengths = NULL,
+        .total_bytes = 0,
+        .count = 0,
+    };
+
+    if (first_file < argc) {
+        for (int i = first_file; i < argc; i++) {
+            if (!(jpeg ? load_jpeg_file(argv[i], &seq) : load_raw_file(argv[i], &seq))) {
+                free_sequence(&seq);
+                return 1;
+            }
+        }
+    } else if (jpeg) {
+        fprintf(stderr, "jpeg format needs input files\n");
+        return 1;
+    } else if (!synthesize_sequence(&cfg, &seq)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    int motion_width = cfg.width / cfg.scale;
+    int motion_height = cfg.height / cfg.scale;
+    size_t gray_size = (size_t)motion_width * motion_height;
+
+    if (jpeg) {
+        // The thumbnail size, and with it the motion size, comes from the first frame
+        gray_size = JPEG_THUMB_MAX;
+        uint8_t *probe = malloc(gray_size);
+        esp_err_t err = probe ? jpeg_dc_thumbnail(seq.data, seq.lengths[0], probe, gray_size,
+                                                  &motion_width, &motion_height) : ESP_ERR_NO_MEM;
+        free(probe);
+        if (err != ESP_OK) {
+            fprintf(stderr, "%s: cannot decode (%s)\n", argv[first_file], esp_err_to_name(err));
+            free_sequence(&seq);
+            return 1;
+        }
+        cfg.width = motion_width * 8;
+        cfg.height = motion_height * 8;
+    }
+
+    const size_t pixel_count = (size_t)cfg.width * cfg.height;
+    const size_t motion_count = (size_t)motion_width * motion_height;
+
+    uint8_t *gray = malloc(gray_size);
+    // Four shadow baselines, two cell count grids and the cell thresholds
+    size_t cell_count = (size_t)((motion_width + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE) *
+                        ((motion_height + MOTION_CELL_SIZE - 1) / MOTION_CELL_SIZE);
+    uint8_t *verify_buf = cfg.verify ? malloc(motion_count * 4 + cell_count * (2 * sizeof(uint16_t) + 1)) : NULL;
+    uint16_t *verify_cells = verify_buf ? (uint16_t *)(verify_buf + motion_count * 4) : NULL;
+    uint8_t *verify_thresholds = verify_buf ? (uint8_t *)(verify_cells + 2 * cell_count) : NULL;
+    if (!gray || (cfg.verify && !verify_buf)) {
+        free(verify_buf);
+        free(gray);
+        free_sequence(&seq);
+        return 1;
+    }
+    bool verify_ok = true;
+    const bool variance_ok = !cfg.verify || verify_variance_saturation();
+    bool scheduler_ok = true;
+    bool updates_ok = true;
+    if (cfg.verify) {
+        // Dropped and rejected bodies log warnings by design
+        host_log_set_level(ESP_LOG_NONE);
+        updates_ok = verify_updates();
+        host_log_set_level(cfg.verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+    }
+
+    if (motion_detector_set_zones(&cfg.zones) != ESP_OK) {
+        fprintf(stderr, "zone outside the image\n");
+        free(verify_buf);
+        free(gray);
+        free_sequence(&seq);
+        return 1;
+    }
+
+    motion_detector_set_engine(cfg.engine);
+    s_bench_scheduler.activity_threshold = cfg.motion_change / 2.0f;
+    if (motion_detector_init(motion_width, motion_height, cfg.motion_threshold, cfg.motion_change) != ESP_OK ||
+        face_detector_init() != ESP_OK || event_fsm_init(&BENCH_EVENTS) != ESP_OK ||
+        object_tracker_init(NULL) != ESP_OK || alert_limiter_init(BENCH_BUDGETS) != ESP_OK ||
+        detection_scheduler_init(&s_bench_scheduler) != ESP_OK) {
+        free(verify_buf);
+        free(gray);
+        free_sequence(&seq);
+        return 1;
+    }
+
+    face_detector_set_byte_order(cfg.big_endian);
+    if (strcmp(cfg.skin_model, "ycbcr") == 0) {
+        face_detector_set_skin_model(skin_model_ycbcr, &SKIN_YCBCR_DEFAULT);
+    } else if (strcmp(cfg.skin_model, "hsv") == 0) {
+        face_detector_set_skin_model(skin_model_hsv, &SKIN_HSV_DEFAULT);
+    }
+
+    kernel_stat_t stats[KERNEL_COUNT] = {
+        [KERNEL_GRAYSCALE] = { .name = "rgb565_to_luma_scaled" },
+        [KERNEL_JPEG_DC]   = { .name = "jpeg_dc_thumbnail" },
+        [KERNEL_MOTION]    = { .name = "motion_detector_process" },
+        [KERNEL_FACE]      = { .name = "face_detector_detect" },
+    };
+    face_t faces[BENCH_MAX_FACES];
+    face_result_t face_result;
+    face_result_init(&face_result, faces, BENCH_MAX_FACES);
+    uint32_t motion_frames = 0;
+    uint32_t motion_blobs = 0;
+    uint32_t light_frames = 0;
+    uint32_t trigger_frames = 0;
+    uint32_t events = 0;
+    int64_t clock_ms = 0;
+    int64_t last_motion_ms = -1;
+    float last_change = 0.0f;
+    uint64_t tracker_ns = 0;
+    uint32_t tracker_frames = 0;
+    uint16_t last_track_id = 0;
+    tracker_track_t longest = { 0 };
+    uint32_t face_frames = 0;
+    uint32_t failed_frames = 0;
+    const bool synthetic = first_file >= argc;
+    accuracy_t accuracy = { 0 };
+
+    // Setup allocations are a one-off; only per-frame ones are reported
+    host_heap_reset_stats();
+
+    for (int pass = 0; pass < cfg.repeat; pass++) {
+        motion_detector_reset();
+
+        for (int f = 0; f < seq.count; f++) {
+            uint8_t *frame = seq.data + (jpeg ? seq.offsets[f] : seq.frame_bytes * f);
+            host_heap_stats_t heap;
+            uint64_t t0;
+
+            const uint8_t *motion_input = frame;
+            if (jpeg) {
+                int w = 0;
+                int h = 0;
+                kernel_begin(&heap, &t0);
+                esp_err_t err = jpeg_dc_thumbnail(frame, seq.lengths[f], gray, gray_size, &w, &h);
+                kernel_end(&stats[KERNEL_JPEG_DC], &heap, t0, pixel_count);
+                if (err != ESP_OK || w != motion_width || h != motion_height) {
+                    failed_frames++;
+                    continue;
+                }
+                motion_input = gray;
+            } else if (cfg.format == FRAME_FORMAT_RGB565) {
+                kernel_begin(&heap, &t0);
+                rgb565_to_luma_scaled(frame, cfg.width, cfg.height, cfg.big_endian, cfg.scale,
+                                      gray, motion_count);
+                kernel_end(&stats[KERNEL_GRAYSCALE], &heap, t0, pixel_count);
+                motion_input = gray;
+            }
+
+            kernel_begin(&heap, &t0);
+            motion_result_t motion = motion_detector_process(motion_input, motion_count);
+            kernel_end(&stats[KERNEL_MOTION], &heap, t0, motion_count);
+            motion_frames += motion.detected;
+            light_frames += motion.illumination_change;
+            if (motion.detected) {
+                motion_blobs += motion.blob_count;
+            }
+            // The first frame of a pass only sets the baseline
+            if (synthetic && f > 0) {
+                score_motion(&cfg, f, seq.count, &motion, motion_detector_get_map(),
+                             motion_width, motion_height, &accuracy);
+            }
+
+            // Pick the time to the next frame and whether faces are looked for
+            uint32_t prev_interval = detection_scheduler_interval_ms();
+            detection_scheduler_update(motion.change_percentage, motion.detected, clock_ms);
+            bool face_due = detection_scheduler_face_due(motion.detected, clock_ms);
+            if (motion.detected) {
+                last_motion_ms = clock_ms;
+            }
+            if (cfg.verify && scheduler_ok) {
+                scheduler_ok = verify_scheduler_update(&s_bench_scheduler, prev_interval, last_change,
+                                                       motion.change_percentage, motion.detected,
+                                                       pass * seq.count + f) &&
+                               verify_scheduler_face(&s_bench_scheduler, face_due, motion.detected,
+                                                     last_motion_ms, clock_ms, pass * seq.count + f);
+            }
+            last_change = motion.change_percentage;
+
+            if (cfg.verify && verify_ok) {
+                verify_ok = verify_motion_kernel(verify_buf, verify_buf + motion_count, motion_input,
+                                                 motion_count, (uint8_t)cfg.motion_threshold,
+                                                 pass * seq.count + f) &&
+                            verify_motion_cells(verify_buf + motion_count * 2, verify_buf + motion_count * 3,
+                                                motion_input, motion_width, motion_height,
+                                                (uint8_t)cfg.motion_threshold, pass * seq.count + f,
+                                                verify_thresholds, verify_cells, verify_cells + cell_count);
+            }
+
+            face_result.count = 0;
+            if (cfg.format == FRAME_FORMAT_RGB565 && face_due) {
+                camera_fb_t fb = {
+                    .buf = frame,
+                    .len = seq.frame_bytes,
+                    .width = cfg.width,
+                    .height = cfg.height,
+                    .format = PIXFORMAT_RGB565,
+                };
+                kernel_begin(&heap, &t0);
+                face_detector_detect(&fb, &face_result);
+                kernel_end(&stats[KERNEL_FACE], &heap, t0, pixel_count);
+                face_frames += face_result.count > 0;
+            }
+
+            // Link blobs, in frame pixels, and faces across frames
+            bool face_found = cfg.format == FRAME_FORMAT_RGB565 && face_result.count > 0;
+            const motion_map_t *map = motion_detector_get_map();
+            tracker_detection_t dets[TRACKER_MAX_DETECTIONS];
+            int det_count = 0;
+            int sx = cfg.width / motion_width;
+            int sy = cfg.height / motion_height;
+            for (int i = 0; motion.detected && i < map->blob_count && i < MOTION_MAX_BLOBS; i++) {
+                const motion_blob_t *blob = &map->blobs[i];
+                dets[det_count++] = (tracker_detection_t){
+                    blob->x * sx, blob->y * sy, blob->w * sx, blob->h * sy, TRACK_KIND_MOTION
+                };
+            }
+            for (int i = 0; face_found && i < face_result.count && det_count < TRACKER_MAX_DETECTIONS; i++) {
+                const face_box_t *box = &face_result.faces[i].box;
+                dets[det_count++] = (tracker_detection_t){ box->x, box->y, box->w, box->h, TRACK_KIND_FACE };
+            }
+            uint64_t tt = now_ns();
+            object_tracker_update(dets, det_count, clock_ms);
+            tracker_ns += now_ns() - tt;
+            tracker_frames++;
+
+            tracker_track_t tracks[TRACKER_MAX_TRACKS];
+            int track_count = object_tracker_get_tracks(tracks, TRACKER_MAX_TRACKS);
+            for (int i = 0; i < track_count; i++) {
+                if (tracks[i].id > last_track_id) {
+                    last_track_id = tracks[i].id;
+                }
+                if (tracks[i].hits > longest.hits) {
+                    longest = tracks[i];
+                }
+            }
+
+            // Alerts the device would send: one per confirmed event
+            trigger_frames += motion.detected || face_found;
+            event_info_t event;
+            if (event_fsm_update(motion.detected, face_found, clock_ms, &event) == EVENT_ACTION_START) {
+                events++;
+                alert_limiter_take(event.face ? ALERT_CLASS_FACE : ALERT_CLASS_MOTION, clock_ms);
+            }
+            clock_ms += detection_scheduler_interval_ms();
+        }
+    }
+
+    printf("sequence: %d frame(s) x %d pass(es), %dx%d %s%s, motion at %dx%d\n",
+           seq.count, cfg.repeat, cfg.width, cfg.height,
+           jpeg ? "jpeg" : cfg.format == FRAME_FORMAT_RGB565 ? (cfg.big_endian ? "rgb565be" : "rgb565") : "gray",
+           !synthetic ? "" : cfg.flicker && cfg.light_step ? " (synthetic, flicker, light step)" :
+           cfg.flicker ? " (synthetic, flicker)" : cfg.light_step ? " (synthetic, light step)" : " (synthetic)",
+           motion_width, motion_height);
+    printf("%-26s %8s %10s %12s %13s %12s\n",
+           "kernel", "frames", "ns/pixel", "frames/s", "allocs/frame", "bytes/frame");
+
+    bool over_budget = false;
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        const kernel_stat_t *s = &stats[k];
+        if (s->frames == 0) {
+            continue;
+        }
+        double ns_per_pixel = (double)s->ns / (double)s->pixels;
+        double fps = s->ns ? (double)s->frames * 1e9 / (double)s->ns : 0.0;
+        printf("%-26s %8u %10.3f %12.1f %13.2f %12.0f\n",
+               s->name, s->frames, ns_per_pixel, fps,
+               (double)s->allocs / s->frames, (double)s->alloc_bytes / s->frames);
+
+        if (cfg.max_ns_per_pixel > 0.0 && ns_per_pixel > cfg.max_ns_per_pixel) {
+            over_budget = true;
+        }
+    }
+    printf("motion frames: %u, face frames: %u, illumination changes: %u\n",
+           motion_frames, face_frames, light_frames);
+    printf("alerts: %u event(s) from %u triggering frame(s), %d of %d frames, over %.1f s\n",
+           events, trigger_frames, BENCH_EVENTS.confirm_frames, BENCH_EVENTS.window_frames,
+           clock_ms / 1000.0);
+    scheduler_stats_t sched;
+    detection_scheduler_get_stats(&sched);
+    printf("scheduler: %u speed-up(s), %u hold(s), %u back-off(s), interval now %u ms; "
+           "faces looked for on %u of %u frames\n",
+           sched.speed_ups, sched.holds, sched.backoffs, sched.interval_ms,
+           sched.face_runs, sched.face_runs + sched.face_skips);
+    for (int c = 0; c < ALERT_CLASS_COUNT; c++) {
+        alert_limiter_stats_t limit;
+        alert_limiter_get_stats(c, &limit);
+        if (limit.allowed + limit.suppressed > 0) {
+            printf("alert budget (%s): %u sent, %u suppressed before encoding\n",
+                   alert_class_name(c), limit.allowed, limit.suppressed);
+        }
+    }
+    if (tracker_frames > 0) {
+        printf("tracker: highest confirmed track id %u, longest #%u %s for %u frames, %.2f us/frame\n",
+               last_track_id, longest.id, object_tracker_direction_name(object_tracker_direction(&longest)),
+               longest.hits, (double)tracker_ns / tracker_frames / 1000.0);
+    }
+    if (motion_frames > 0) {
+        printf("motion blobs: %.2f per motion frame (%dpx cells)\n",
+               (double)motion_blobs / motion_frames, MOTION_CELL_SIZE);
+    }
+    if (synthetic) {
+        uint64_t reported = accuracy.true_cells + accuracy.false_cells;
+        uint64_t expected = accuracy.true_cells + accuracy.missed_cells;
+        printf("motion accuracy (%s): cell precision %.1f%%, recall %.1f%%, "
+               "false alarms %u/%u idle frames, missed %u/%u object frames\n",
+               motion_engine_name(cfg.engine),
+               reported ? 100.0 * accuracy.true_cells / reported : 0.0,
+               expected ? 100.0 * accuracy.true_cells / expected : 0.0,
+               accuracy.false_frames, accuracy.idle_frames,
+               accuracy.missed_frames, accuracy.object_frames);
+    }
+
+    face_detector_stats_t face_stats;
+    face_detector_get_stats(&face_stats);
+    if (face_stats.frames > 0) {
+        printf("face cascade: %u proposals, %u model runs on %.1f%% of frame pixels\n",
+               face_stats.proposals, face_stats.model_runs,
+               face_stats.frame_pixels ? 100.0 * face_stats.model_pixels / face_stats.frame_pixels : 0.0);
+    }
+    if (failed_frames) {
+        printf("undecodable frames: %u\n", failed_frames);
+    }
+    if (cfg.verify) {
+        printf("verify: %s kernel %s the scalar reference\n",
+               motion_kernel_impl_name(), verify_ok ? "matches" : "DOES NOT match");
+        printf("verify: saturated variance %s\n", variance_ok ? "stays in range" : "WRAPS");
+        printf("verify: scheduler decisions %s the policy\n", scheduler_ok ? "follow" : "DO NOT follow");
+        printf("verify: getUpdates parsing %s\n", updates_ok ? "matches the recorded bodies" : "DOES NOT match");
+    }
+
+    face_detector_deinit();
+    motion_detector_deinit();
+    free(verify_buf);
+    free(gray);
+    free_sequence(&seq);
+
+    if (!verify_ok || !variance_ok || !scheduler_ok || !updates_ok) {
+        return 3;
+    }
+    if (over_budget) {
+        fprintf(stderr, "per-pixel budget of %.3f ns exceeded\n", cfg.max_ns_per_pixel);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file esp_shim.c
+ * @brief Host implementations backing the ESP-IDF shim headers
+ */
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static esp_log_level_t s_log_level = ESP_LOG_WARN;
+static host_heap_stats_t s_heap_stats = {0};
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+void host_log_set_level(esp_log_level_t level)
+{
+    s_log_level = level;
+}
+
+void host_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    
+    if (level > s_log_level) {
+        return;
+    }
+    
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", letters[level], tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    s_heap_stats.alloc_count++;
+    s_heap_stats.alloc_bytes += size;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    s_heap_stats.alloc_count++;
+    s_heap_stats.alloc_bytes += n * size;
+    return calloc(n, size);
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    s_heap_stats.alloc_count++;
+    s_heap_stats.alloc_bytes += size;
+    return realloc(ptr, size);
+}
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    (void)caps;
+    s_heap_stats.alloc_count++;
+    s_heap_stats.alloc_bytes += size;
+    // aligned_alloc() wants the size rounded up to the alignment
+    return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (ptr) {
+        s_heap_stats.free_count++;
+    }
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    (void)caps;
+    return 0;
+}
+
+void host_heap_get_stats(host_heap_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_heap_stats;
+    }
+}
+
+void host_heap_reset_stats(void)
+{
+    s_heap_stats = (host_heap_stats_t){0};
+}
@@ -0,0 +1,44 @@
+/**
+ * @file esp_camera.h
+ * @brief Host shim for the camera_fb_t frame descriptor from esp32-camera
+ */
+
+#ifndef HOST_SHIM_ESP_CAMERA_H
+#define HOST_SHIM_ESP_CAMERA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PIXFORMAT_RGB565,
+    PIXFORMAT_YUV422,
+    PIXFORMAT_YUV420,
+    PIXFORMAT_GRAYSCALE,
+    PIXFORMAT_JPEG,
+    PIXFORMAT_RGB888,
+    PIXFORMAT_RAW,
+    PIXFORMAT_RGB444,
+    PIXFORMAT_RGB555,
+} pixformat_t;
+
+typedef struct {
+    uint8_t *buf;               ///< Pixel data
+    size_t len;                 ///< Length of the buffer in bytes
+    size_t width;               ///< Width in pixels
+    size_t height;              ///< Height in pixels
+    pixformat_t format;         ///< Pixel format
+    struct timeval timestamp;   ///< Capture timestamp
+} camera_fb_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_SHIM_ESP_CAMERA_H
@@ -0,0 +1,58 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief Host shim for heap_caps allocation with per-call accounting
+ *
+ * Capabilities are ignored; every call is forwarded to the C allocator and
+ * counted so the benchmark can report allocations per frame.
+ */
+
+#ifndef HOST_SHIM_ESP_HEAP_CAPS_H
+#define HOST_SHIM_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MALLOC_CAP_EXEC         (1 << 0)
+#define MALLOC_CAP_32BIT        (1 << 1)
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_DMA          (1 << 3)
+#define MALLOC_CAP_SPIRAM       (1 << 10)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+#define MALLOC_CAP_DEFAULT      (1 << 12)
+
+/**
+ * @brief Allocation counters maintained by the shim
+ */
+typedef struct {
+    uint32_t alloc_count;   ///< Number of heap_caps_*alloc calls
+    uint32_t free_count;    ///< Number of heap_caps_free calls
+    size_t alloc_bytes;     ///< Total bytes requested
+} host_heap_stats_t;
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps);
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+
+/**
+ * @brief Read the allocation counters
+ * @param stats Output counters
+ */
+void host_heap_get_stats(host_heap_stats_t *stats);
+
+/**
+ * @brief Reset the allocation counters to zero
+ */
+void host_heap_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_SHIM_ESP_HEAP_CAPS_H
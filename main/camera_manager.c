@@ -6,6 +6,7 @@
 #include "camera_manager.h"
 #include "esp_log.h"
 #include "esp_camera.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 #include "img_converters.h"
 
@@ -83,9 +84,36 @@ static const char *TAG = "camera_manager";
 #error "Camera module not selected in menuconfig!"
 #endif
 
+// Analysis frames; stills use CONFIG_CAMERA_STILL_* when enabled
+#define ANALYSIS_FRAMESIZE FRAMESIZE_VGA
+#define ANALYSIS_JPEG_QUALITY 12
+
+#if CONFIG_CAMERA_STILL_QXGA
+#define STILL_FRAMESIZE FRAMESIZE_QXGA
+#else
+#define STILL_FRAMESIZE FRAMESIZE_UXGA
+#endif
+#if CONFIG_CAMERA_HIRES_CAPTURE
+#define STILL_JPEG_QUALITY CONFIG_CAMERA_STILL_QUALITY
+#define STILL_SETTLE_FRAMES CONFIG_CAMERA_STILL_SETTLE_FRAMES
+#else
+#define STILL_JPEG_QUALITY ANALYSIS_JPEG_QUALITY
+#define STILL_SETTLE_FRAMES 0
+#endif
+
+// Frames fetched while waiting for a size change before giving up
+#define SIZE_CHANGE_MAX_FRAMES (CAMERA_FB_COUNT + 4)
+
 static bool s_camera_initialized = false;
 static bool s_sensor_supports_jpeg = true;
 
+// Stills: after one, the driver may still hold frames at the still size,
+// which capture drops until an analysis-size frame arrives
+static bool s_still_supported = false;
+static bool s_restore_pending = false;
+static int64_t s_restore_start_us = 0;
+static camera_still_stats_t s_still_stats;
+
 esp_err_t camera_manager_init(void)
 {
     if (s_camera_initialized) {
@@ -119,15 +147,30 @@ esp_err_t camera_manager_init(void)
         .ledc_channel = LEDC_CHANNEL_0,
 
         .pixel_format = PIXFORMAT_JPEG,
-        .frame_size = FRAMESIZE_VGA,    // 640x480
-        .jpeg_quality = 12,              // 0-63, lower is better quality
-        .fb_count = 2,                   // Double buffering
+        .frame_size = ANALYSIS_FRAMESIZE,        // 640x480
+        .jpeg_quality = ANALYSIS_JPEG_QUALITY,   // 0-63, lower is better quality
+        .fb_count = CAMERA_FB_COUNT,     // One per pipeline frame plus one being filled
         .fb_location = CAMERA_FB_IN_PSRAM,
         .grab_mode = CAMERA_GRAB_LATEST,
     };
 
     // Initialize camera with JPEG first
+#if CONFIG_CAMERA_HIRES_CAPTURE
+    // The driver sizes its buffers for the frame size it starts with, so
+    // start at the still size and switch down once it runs
+    camera_config.frame_size = STILL_FRAMESIZE;
+    camera_config.jpeg_quality = STILL_JPEG_QUALITY;
+    esp_err_t err = esp_camera_init(&camera_config);
+    s_still_supported = err == ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Sensor cannot start at the still resolution (0x%x), stills disabled", err);
+        camera_config.frame_size = ANALYSIS_FRAMESIZE;
+        camera_config.jpeg_quality = ANALYSIS_JPEG_QUALITY;
+        err = esp_camera_init(&camera_config);
+    }
+#else
     esp_err_t err = esp_camera_init(&camera_config);
+#endif
     
     if (err != ESP_OK) {
         // JPEG not supported (GC2145, etc.) - use RGB565 instead
@@ -174,6 +217,15 @@ esp_err_t camera_manager_init(void)
         s->set_dcw(s, 1);            // 0 = Disable, 1 = Enable
         s->set_colorbar(s, 0);       // 0 = Disable, 1 = Enable
     }
+    
+    if (s_still_supported) {
+        camera_manager_set_framesize(ANALYSIS_FRAMESIZE);
+        camera_manager_set_quality(ANALYSIS_JPEG_QUALITY);
+        s_restore_pending = true;
+        ESP_LOGI(TAG, "Stills at %ux%u, analysis at %ux%u",
+                 resolution[STILL_FRAMESIZE].width, resolution[STILL_FRAMESIZE].height,
+                 resolution[ANALYSIS_FRAMESIZE].width, resolution[ANALYSIS_FRAMESIZE].height);
+    }
 
     s_camera_initialized = true;
     ESP_LOGI(TAG, "Camera initialized successfully (JPEG support: %s)", 
@@ -181,6 +233,34 @@ esp_err_t camera_manager_init(void)
     return ESP_OK;
 }
 
+/**
+ * @brief Fetch frames until one of the given size arrives, dropping the others
+ */
+static camera_fb_t *fetch_frame_of_size(framesize_t framesize)
+{
+    const size_t width = resolution[framesize].width;
+    const size_t height = resolution[framesize].height;
+    
+    for (int i = 0; i < SIZE_CHANGE_MAX_FRAMES; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (!fb) {
+            return NULL;
+        }
+        if (fb->width == width && fb->height == height) {
+            return fb;
+        }
+        esp_camera_fb_return(fb);
+        s_still_stats.dropped_frames++;
+    }
+    return NULL;
+}
+
+static void record_max(uint32_t *last, uint32_t *max, int64_t elapsed_us)
+{
+    *last = (uint32_t)elapsed_us;
+    *max = *last > *max ? *last : *max;
+}
+
 camera_fb_t* camera_manager_capture(void)
 {
     if (!s_camera_initialized) {
@@ -188,7 +268,19 @@ camera_fb_t* camera_manager_capture(void)
         return NULL;
     }
 
-    camera_fb_t *fb = esp_camera_fb_get();
+    camera_fb_t *fb;
+    if (s_restore_pending) {
+        fb = fetch_frame_of_size(ANALYSIS_FRAMESIZE);
+        if (fb) {
+            s_restore_pending = false;
+            if (s_restore_start_us) {
+                record_max(&s_still_stats.restore_us, &s_still_stats.restore_max_us,
+                           esp_timer_get_time() - s_restore_start_us);
+            }
+        }
+    } else {
+        fb = esp_camera_fb_get();
+    }
     if (!fb) {
         ESP_LOGE(TAG, "Camera capture failed");
         return NULL;
@@ -206,6 +298,55 @@ void camera_manager_return_fb(camera_fb_t *fb)
     }
 }
 
+bool camera_manager_still_supported(void)
+{
+    return s_still_supported;
+}
+
+camera_fb_t* camera_manager_capture_still(void)
+{
+    if (!s_camera_initialized || !s_still_supported) {
+        return NULL;
+    }
+    
+    int64_t start = esp_timer_get_time();
+    camera_fb_t *still = NULL;
+    
+    if (camera_manager_set_framesize(STILL_FRAMESIZE) == ESP_OK &&
+        camera_manager_set_quality(STILL_JPEG_QUALITY) == ESP_OK) {
+        still = fetch_frame_of_size(STILL_FRAMESIZE);
+        // The first frames after a mode change may be badly exposed
+        for (int i = 0; still && i < STILL_SETTLE_FRAMES; i++) {
+            esp_camera_fb_return(still);
+            s_still_stats.dropped_frames++;
+            still = fetch_frame_of_size(STILL_FRAMESIZE);
+        }
+    }
+    
+    // Back to analysis; the next captures skip frames still at the still size
+    s_restore_start_us = esp_timer_get_time();
+    camera_manager_set_framesize(ANALYSIS_FRAMESIZE);
+    camera_manager_set_quality(ANALYSIS_JPEG_QUALITY);
+    s_restore_pending = true;
+    
+    if (!still) {
+        s_still_stats.failures++;
+        ESP_LOGW(TAG, "No still after %lld ms", (s_restore_start_us - start) / 1000);
+        return NULL;
+    }
+    
+    s_still_stats.stills++;
+    record_max(&s_still_stats.switch_us, &s_still_stats.switch_max_us, s_restore_start_us - start);
+    ESP_LOGI(TAG, "Still %ux%u, %u bytes in %lu ms", still->width, still->height, still->len,
+             (unsigned long)(s_still_stats.switch_us / 1000));
+    return still;
+}
+
+void camera_manager_get_still_stats(camera_still_stats_t *stats)
+{
+    *stats = s_still_stats;
+}
+
 esp_err_t camera_manager_set_framesize(framesize_t framesize)
 {
     sensor_t *s = esp_camera_sensor_get();
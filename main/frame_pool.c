@@ -0,0 +1,274 @@
+/**
+ * @file frame_pool.c
+ * @brief Fixed pool of PSRAM JPEG slots with a pre-trigger ring buffer
+ */
+
+#include "frame_pool.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "frame_pool";
+
+static uint8_t *s_storage = NULL;
+static frame_slot_t *s_slots = NULL;
+static int s_slot_count = 0;
+
+// Free slots, used as a stack; slots are released from the sending task.
+// s_available counts the free slots so acquirers can block on it.
+static frame_slot_t **s_free = NULL;
+static int s_free_count = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_available = NULL;
+
+// Ring of the most recent frames, oldest at s_ring_head
+static frame_slot_t **s_ring = NULL;
+static int s_ring_depth = 0;
+static int s_ring_head = 0;
+static int s_ring_count = 0;
+
+static size_t slot_write_cb(void *arg, size_t index, const void *data, size_t len)
+{
+    frame_slot_t *slot = (frame_slot_t *)arg;
+
+    if (index + len > slot->capacity) {
+        return 0;
+    }
+
+    memcpy(slot->buf + index, data, len);
+    if (index + len > slot->len) {
+        slot->len = index + len;
+    }
+    return len;
+}
+
+esp_err_t frame_pool_init(int slot_count, size_t slot_size, int ring_depth)
+{
+    if (slot_count <= 0 || slot_size == 0 || ring_depth < 0 || ring_depth > slot_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_storage) {
+        ESP_LOGW(TAG, "Frame pool already initialized");
+        return ESP_OK;
+    }
+
+    s_storage = heap_caps_malloc((size_t)slot_count * slot_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_slots = calloc(slot_count, sizeof(frame_slot_t));
+    s_free = calloc(slot_count, sizeof(frame_slot_t *));
+    s_ring = ring_depth > 0 ? calloc(ring_depth, sizeof(frame_slot_t *)) : NULL;
+    s_lock = xSemaphoreCreateMutex();
+    s_available = xSemaphoreCreateCounting(slot_count, slot_count);
+
+    if (!s_storage || !s_slots || !s_free || (ring_depth > 0 && !s_ring) || !s_lock || !s_available) {
+        ESP_LOGE(TAG, "Failed to allocate frame pool (%d x %u bytes)", slot_count, slot_size);
+        heap_caps_free(s_storage);
+        free(s_slots);
+        free(s_free);
+        free(s_ring);
+        if (s_lock) {
+            vSemaphoreDelete(s_lock);
+        }
+        if (s_available) {
+            vSemaphoreDelete(s_available);
+        }
+        s_storage = NULL;
+        s_slots = NULL;
+        s_free = NULL;
+        s_ring = NULL;
+        s_lock = NULL;
+        s_available = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < slot_count; i++) {
+        s_slots[i].buf = s_storage + (size_t)i * slot_size;
+        s_slots[i].capacity = slot_size;
+        s_free[i] = &s_slots[i];
+    }
+    s_slot_count = slot_count;
+    s_free_count = slot_count;
+    s_ring_depth = ring_depth;
+    s_ring_head = 0;
+    s_ring_count = 0;
+
+    ESP_LOGI(TAG, "Frame pool initialized: %d slots x %u KB, ring depth %d",
+             slot_count, slot_size / 1024, ring_depth);
+
+    return ESP_OK;
+}
+
+frame_slot_t *frame_pool_acquire_wait(TickType_t timeout)
+{
+    frame_slot_t *slot = NULL;
+
+    if (!s_lock) {
+        return NULL;
+    }
+
+    if (xSemaphoreTake(s_available, timeout) != pdTRUE) {
+        return NULL;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    slot = s_free[--s_free_count];
+    xSemaphoreGive(s_lock);
+
+    slot->len = 0;
+    return slot;
+}
+
+frame_slot_t *frame_pool_acquire(void)
+{
+    return frame_pool_acquire_wait(0);
+}
+
+esp_err_t frame_pool_store(frame_slot_t *slot, const camera_fb_t *fb, int quality)
+{
+    if (!slot || !fb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    slot->len = 0;
+    slot->timestamp_us = esp_timer_get_time();
+
+    if (fb->format == PIXFORMAT_JPEG) {
+        if (fb->len > slot->capacity) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(slot->buf, fb->buf, fb->len);
+        slot->len = fb->len;
+        return ESP_OK;
+    }
+
+    // The encoder streams its output through the callback, so the JPEG lands
+    // in the slot without an intermediate heap buffer
+    if (!frame2jpg_cb((camera_fb_t *)fb, quality, slot_write_cb, slot)) {
+        slot->len = 0;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return ESP_OK;
+}
+
+void frame_pool_release(frame_slot_t *slot)
+{
+    if (!slot || !s_lock) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_free[s_free_count++] = slot;
+    xSemaphoreGive(s_lock);
+    xSemaphoreGive(s_available);
+}
+
+int frame_pool_free_count(void)
+{
+    return s_free_count;
+}
+
+int frame_pool_slot_count(void)
+{
+    return s_slot_count;
+}
+
+esp_err_t frame_ring_push(const camera_fb_t *fb, int quality, TickType_t timeout)
+{
+    frame_slot_t *slot = NULL;
+
+    if (!s_ring) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (s_ring_count < s_ring_depth) {
+        slot = frame_pool_acquire_wait(s_ring_count == 0 ? timeout : 0);
+    }
+
+    if (!slot) {
+        if (s_ring_count == 0) {
+            return ESP_ERR_NO_MEM;
+        }
+        // Recycle the oldest frame's slot
+        slot = s_ring[s_ring_head];
+        s_ring_head = (s_ring_head + 1) % s_ring_depth;
+        s_ring_count--;
+    }
+
+    esp_err_t err = frame_pool_store(slot, fb, quality);
+    if (err != ESP_OK) {
+        frame_pool_release(slot);
+        return err;
+    }
+
+    s_ring[(s_ring_head + s_ring_count) % s_ring_depth] = slot;
+    s_ring_count++;
+
+    return ESP_OK;
+}
+
+int frame_ring_take(frame_album_t *album)
+{
+    album->count = 0;
+
+    while (s_ring_count > 0) {
+        frame_slot_t *slot = s_ring[s_ring_head];
+        s_ring_head = (s_ring_head + 1) % s_ring_depth;
+        s_ring_count--;
+
+        if (album->count < FRAME_ALBUM_MAX) {
+            album->slots[album->count++] = slot;
+        } else {
+            frame_pool_release(slot);
+        }
+    }
+    s_ring_head = 0;
+
+    return album->count;
+}
+
+void frame_ring_clear(void)
+{
+    while (s_ring_count > 0) {
+        frame_pool_release(s_ring[s_ring_head]);
+        s_ring_head = (s_ring_head + 1) % s_ring_depth;
+        s_ring_count--;
+    }
+    s_ring_head = 0;
+}
+
+esp_err_t frame_album_add(frame_album_t *album, const camera_fb_t *fb, int quality,
+                          TickType_t timeout)
+{
+    if (album->count >= FRAME_ALBUM_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    frame_slot_t *slot = frame_pool_acquire_wait(timeout);
+    if (!slot) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = frame_pool_store(slot, fb, quality);
+    if (err != ESP_OK) {
+        frame_pool_release(slot);
+        return err;
+    }
+
+    album->slots[album->count++] = slot;
+    return ESP_OK;
+}
+
+void frame_album_release(frame_album_t *album)
+{
+    for (int i = 0; i < album->count; i++) {
+        frame_pool_release(album->slots[i]);
+        album->slots[i] = NULL;
+    }
+    album->count = 0;
+}
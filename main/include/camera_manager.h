@@ -6,6 +6,8 @@
 #ifndef CAMERA_MANAGER_H
 #define CAMERA_MANAGER_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 #include "esp_camera.h"
 
@@ -13,8 +15,29 @@
 extern "C" {
 #endif
 
+/** Frame buffers allocated by the driver; the detection pipeline keeps one fewer in flight */
+#define CAMERA_FB_COUNT 4
+
+/**
+ * @brief Counters of high-resolution stills
+ */
+typedef struct {
+    uint32_t stills;          ///< Stills captured
+    uint32_t failures;        ///< Requests that produced no still
+    uint32_t dropped_frames;  ///< Frames discarded while the sensor changed size
+    uint32_t switch_us;       ///< Last request-to-still time
+    uint32_t switch_max_us;
+    uint32_t restore_us;      ///< Last still-to-analysis-frame time
+    uint32_t restore_max_us;
+} camera_still_stats_t;
+
 /**
  * @brief Initialize camera with configured settings
+ *
+ * With CONFIG_CAMERA_HIRES_CAPTURE the driver is started at the still
+ * resolution, so its buffers can hold a still, and then switched down to
+ * the analysis resolution.
+ *
  * @return ESP_OK on success
  */
 esp_err_t camera_manager_init(void);
@@ -31,6 +54,30 @@ camera_fb_t* camera_manager_capture(void);
  */
 void camera_manager_return_fb(camera_fb_t *fb);
 
+/**
+ * @brief Whether high-resolution stills can be taken
+ */
+bool camera_manager_still_supported(void);
+
+/**
+ * @brief Take one high-resolution still
+ *
+ * Switches the sensor to the still resolution and quality, keeps the first
+ * frame of that size after CONFIG_CAMERA_STILL_SETTLE_FRAMES, and switches
+ * back. Frames of the wrong size that the driver had already buffered are
+ * discarded, here and by the next camera_manager_capture() calls. Must be
+ * called from the task that captures analysis frames.
+ *
+ * @return Still, returned with camera_manager_return_fb(), or NULL on failure
+ */
+camera_fb_t* camera_manager_capture_still(void);
+
+/**
+ * @brief Copy the still counters
+ * @param stats Output
+ */
+void camera_manager_get_still_stats(camera_still_stats_t *stats);
+
 /**
  * @brief Set camera resolution
  * @param framesize Frame size enum
@@ -0,0 +1,142 @@
+/**
+ * @file frame_pool.h
+ * @brief Fixed pool of PSRAM JPEG slots with a pre-trigger ring buffer
+ */
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Telegram accepts at most 10 photos per media group */
+#define FRAME_ALBUM_MAX 10
+
+/**
+ * @brief One JPEG buffer owned by the pool
+ */
+typedef struct {
+    uint8_t *buf;          // Slot storage in PSRAM
+    size_t len;            // Bytes of JPEG data in buf
+    size_t capacity;       // Size of buf
+    int64_t timestamp_us;  // esp_timer time the frame was stored
+} frame_slot_t;
+
+/**
+ * @brief Ordered set of slots sent together, oldest first
+ */
+typedef struct {
+    uint8_t count;
+    frame_slot_t *slots[FRAME_ALBUM_MAX];
+} frame_album_t;
+
+/**
+ * @brief Allocate the slot pool and the ring buffer
+ *
+ * All slots are allocated once, in one PSRAM block; nothing is allocated
+ * per frame afterwards.
+ *
+ * @param slot_count Number of slots in the pool
+ * @param slot_size Capacity of each slot in bytes
+ * @param ring_depth Number of most recent frames kept by the ring (0 for none)
+ * @return ESP_OK on success
+ */
+esp_err_t frame_pool_init(int slot_count, size_t slot_size, int ring_depth);
+
+/**
+ * @brief Take a free slot from the pool
+ * @return Slot, or NULL if the pool is exhausted
+ */
+frame_slot_t *frame_pool_acquire(void);
+
+/**
+ * @brief Take a free slot, waiting for one to be released if necessary
+ * @param timeout Ticks to wait
+ * @return Slot, or NULL if none was released in time
+ */
+frame_slot_t *frame_pool_acquire_wait(TickType_t timeout);
+
+/**
+ * @brief Store a camera frame in a slot as JPEG
+ *
+ * JPEG frames are copied; RGB565 frames are encoded straight into the slot.
+ *
+ * @param slot Slot to fill
+ * @param fb Camera frame
+ * @param quality JPEG quality used when encoding (1-100)
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the JPEG does not fit
+ */
+esp_err_t frame_pool_store(frame_slot_t *slot, const camera_fb_t *fb, int quality);
+
+/**
+ * @brief Return a slot to the pool
+ * @param slot Slot to release (NULL is ignored)
+ */
+void frame_pool_release(frame_slot_t *slot);
+
+/**
+ * @brief Number of free slots in the pool
+ */
+int frame_pool_free_count(void);
+
+/**
+ * @brief Number of slots in the pool, free or in use
+ */
+int frame_pool_slot_count(void);
+
+/**
+ * @brief Store a frame as the newest entry of the ring
+ *
+ * When the ring is full, or the pool has no free slot, the oldest ring entry
+ * is overwritten. Only an empty ring waits for a slot to be released. The
+ * ring is not locked and must only be used from one task.
+ *
+ * @param fb Camera frame
+ * @param quality JPEG quality used when encoding
+ * @param timeout Ticks to wait for a slot when the ring is empty
+ * @return ESP_OK on success
+ */
+esp_err_t frame_ring_push(const camera_fb_t *fb, int quality, TickType_t timeout);
+
+/**
+ * @brief Move every frame in the ring into an album, leaving the ring empty
+ * @param album Album to fill; its previous contents are overwritten
+ * @return Number of frames moved
+ */
+int frame_ring_take(frame_album_t *album);
+
+/**
+ * @brief Release every frame in the ring, leaving it empty
+ */
+void frame_ring_clear(void);
+
+/**
+ * @brief Store a frame in a new slot appended to an album
+ * @param album Album to extend
+ * @param fb Camera frame
+ * @param quality JPEG quality used when encoding
+ * @param timeout Ticks to wait for a free slot
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the album is full or no slot
+ *         was released in time
+ */
+esp_err_t frame_album_add(frame_album_t *album, const camera_fb_t *fb, int quality,
+                          TickType_t timeout);
+
+/**
+ * @brief Release every slot of an album and empty it
+ * @param album Album to release
+ */
+void frame_album_release(frame_album_t *album);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,102 @@
+/**
+ * @file json_stream.h
+ * @brief Streaming JSON parser with fixed-size state
+ *
+ * The input can be fed in chunks of any size as it arrives from the
+ * network; nothing is allocated and the document is never held in memory.
+ * Each scalar value is reported through a callback together with its key
+ * and the keys of the containers it sits in, so a caller picks out the few
+ * fields it needs by path. Keys and values longer than the buffers are
+ * truncated; containers nested deeper than JSON_STREAM_MAX_DEPTH are
+ * parsed but their keys are not kept.
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_STREAM_MAX_DEPTH 8
+#define JSON_STREAM_KEY_MAX 24
+#define JSON_STREAM_VALUE_MAX 256
+
+typedef enum {
+    JSON_STREAM_STRING,
+    JSON_STREAM_NUMBER,
+    JSON_STREAM_LITERAL,     ///< true, false or null
+} json_stream_type_t;
+
+typedef struct json_stream json_stream_t;
+
+/**
+ * @brief Called for every scalar value
+ * @param js Parser; js->depth and json_stream_container() give the path
+ * @param key Key of the value, "" inside an array
+ * @param value Value text, NUL-terminated (strings unescaped)
+ */
+typedef void (*json_stream_value_cb)(void *ctx, const json_stream_t *js, const char *key,
+                                     json_stream_type_t type, const char *value);
+
+/**
+ * @brief Called when an object closes, while js->depth still counts it
+ */
+typedef void (*json_stream_end_cb)(void *ctx, const json_stream_t *js);
+
+struct json_stream {
+    json_stream_value_cb on_value;
+    json_stream_end_cb on_object_end;
+    void *ctx;
+
+    int depth;                                           ///< Open containers
+    char path[JSON_STREAM_MAX_DEPTH][JSON_STREAM_KEY_MAX]; ///< Key each container was opened under
+    bool in_array[JSON_STREAM_MAX_DEPTH];
+    char key[JSON_STREAM_KEY_MAX];                        ///< Key of the member being parsed
+    bool expect_key;
+
+    uint8_t state;
+    bool string_is_key;
+    uint8_t hex_digits;
+    uint16_t code_point;
+    char value[JSON_STREAM_VALUE_MAX];
+    size_t len;
+    bool error;
+    bool done;                                            ///< The top-level container has closed
+};
+
+/**
+ * @brief Prepare a parser for a new document
+ */
+void json_stream_init(json_stream_t *js, json_stream_value_cb on_value,
+                      json_stream_end_cb on_object_end, void *ctx);
+
+/**
+ * @brief Feed the next chunk of the document
+ * @return false once the input was found to be malformed
+ */
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len);
+
+/**
+ * @brief Whether the whole document has been parsed
+ * @return true once the top-level container has closed without an error, so
+ *         a body that was cut off can be told from a complete one
+ */
+bool json_stream_complete(const json_stream_t *js);
+
+/**
+ * @brief Key a container was opened under
+ * @param level 1 for the outermost container, up to js->depth
+ * @return Key, "" for the root, array elements and unknown levels
+ */
+const char *json_stream_container(const json_stream_t *js, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_STREAM_H
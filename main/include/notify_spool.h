@@ -0,0 +1,105 @@
+/**
+ * @file notify_spool.h
+ * @brief Persistent spool of notifications that could not be sent
+ *
+ * Notifications are appended to log-structured segment files on the SPIFFS
+ * "storage" partition and replayed, oldest first, once Telegram is reachable
+ * again. Each record carries a CRC, so a record torn by a power cut is
+ * detected and skipped; the read position survives reboots in NVS.
+ */
+
+#ifndef NOTIFY_SPOOL_H
+#define NOTIFY_SPOOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telegram_bot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest caption kept with a record, including the terminator */
+#define NOTIFY_SPOOL_MAX_CAPTION 512
+
+/** Failed deliveries in a row after which a replayed record is dropped */
+#define NOTIFY_SPOOL_MAX_ATTEMPTS 5
+
+/**
+ * @brief Sends one replayed notification
+ * @param caption Caption or message text
+ * @param photos Photos, oldest first
+ * @param count Number of photos, 0 for a text message
+ * @return ESP_OK if delivered; the record is then removed from the spool.
+ *         ESP_ERR_INVALID_RESPONSE drops the record at once, as it would
+ *         never be accepted; ESP_ERR_NOT_FINISHED does not count as a
+ *         failed attempt.
+ */
+typedef esp_err_t (*notify_spool_send_fn)(const char *caption, const telegram_photo_t *photos, int count);
+
+/**
+ * @brief Spool counters
+ */
+typedef struct {
+    uint32_t pending;        ///< Records waiting to be replayed
+    uint32_t bytes;          ///< Bytes held by segments not yet reclaimed
+    uint32_t spooled;        ///< Records appended since boot
+    uint32_t replayed;       ///< Records delivered from the spool since boot
+    uint32_t dropped;        ///< Records lost to a full spool or corruption since boot
+} notify_spool_stats_t;
+
+/**
+ * @brief Mount the storage partition and recover the spool
+ *
+ * Requires nvs_flash_init(). Formats the partition if it cannot be mounted.
+ *
+ * @param max_bytes Space the spool may use; the oldest segment is dropped
+ *                  to make room beyond it
+ * @return ESP_OK on success
+ */
+esp_err_t notify_spool_init(size_t max_bytes);
+
+/**
+ * @brief Append a notification
+ *
+ * May be called from any task. The photo data is copied to flash before
+ * returning, so the caller may release its buffers afterwards.
+ *
+ * @param caption Caption or message text (truncated to NOTIFY_SPOOL_MAX_CAPTION - 1)
+ * @param photos Photos, oldest first
+ * @param count Number of photos (0..FRAME_ALBUM_MAX)
+ * @return ESP_OK on success
+ */
+esp_err_t notify_spool_append(const char *caption, const telegram_photo_t *photos, int count);
+
+/**
+ * @brief Whether records are waiting to be replayed
+ */
+bool notify_spool_pending(void);
+
+/**
+ * @brief Replay the oldest record
+ *
+ * Photos are read back into frame_pool slots, which are released again
+ * after the send. Call from one task only.
+ *
+ * @param send Delivery function
+ * @return ESP_OK if a record was delivered, ESP_ERR_NOT_FOUND if the spool
+ *         is empty, ESP_ERR_NO_MEM if not enough pool slots are free, or
+ *         the error of send (the record stays in the spool until it has
+ *         failed NOTIFY_SPOOL_MAX_ATTEMPTS times in a row)
+ */
+esp_err_t notify_spool_replay_one(notify_spool_send_fn send);
+
+/**
+ * @brief Copy the counters
+ * @param stats Output
+ */
+void notify_spool_get_stats(notify_spool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NOTIFY_SPOOL_H
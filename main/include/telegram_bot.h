@@ -1,6 +1,7 @@
 /**
  * @file telegram_bot.h
- * @brief Telegram Bot API client for sending messages and photos
+ * @brief Telegram Bot API client for sending messages and photos and
+ *        receiving commands
  */
 
 #ifndef TELEGRAM_BOT_H
@@ -15,6 +16,23 @@
 extern "C" {
 #endif
 
+/**
+ * @brief One photo of a media group
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+} telegram_photo_t;
+
+/*
+ * Send errors, besides the argument checks:
+ *   ESP_ERR_INVALID_RESPONSE  the API rejected the request (bad token, chat
+ *                             or markup); sending it again will fail again
+ *   ESP_ERR_NOT_FINISHED      the bot is rate limited (HTTP 429); nothing is
+ *                             sent until telegram_bot_retry_delay_ms() is 0
+ *   anything else             network or server failure, worth retrying
+ */
+
 /**
  * @brief Initialize Telegram bot client
  * @param bot_token Bot token from BotFather
@@ -40,19 +58,76 @@ esp_err_t telegram_bot_send_message(const char *message);
 esp_err_t telegram_bot_send_photo(const uint8_t *photo_data, size_t photo_size, const char *caption);
 
 /**
- * @brief Check if cooldown period has passed since last notification
- * @param cooldown_sec Cooldown period in seconds
- * @return true if notification can be sent
+ * @brief Send 2-10 photos as one album (sendMediaGroup)
+ *
+ * The multipart body is streamed from the callers' buffers; the album is
+ * never assembled in memory. A single photo falls back to sendPhoto.
+ *
+ * @param photos JPEG images, in display order
+ * @param count Number of photos (1-10)
+ * @param caption Optional caption shown under the album (can be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t telegram_bot_send_media_group(const telegram_photo_t *photos, size_t count, const char *caption);
+
+/**
+ * @brief Whether a send error is worth retrying later
+ */
+bool telegram_bot_is_retryable(esp_err_t err);
+
+/**
+ * @brief Time until a retry should be attempted
+ *
+ * The longer of the rate limit Telegram imposed (retry_after) and the
+ * backoff after consecutive failures, which doubles per failure up to a
+ * minute with random jitter. Both are global to the bot.
+ *
+ * @return Milliseconds, 0 if a request may be sent now
+ */
+uint32_t telegram_bot_retry_delay_ms(void);
+
+/** Longest command text kept, including arguments and the terminator */
+#define TELEGRAM_COMMAND_MAX 64
+
+/**
+ * @brief Handles one command received from the configured chat
+ *
+ * Called from the polling task, one command at a time, in the order the
+ * commands were sent. Replies can be sent with telegram_bot_send_message().
+ *
+ * @param command Command name without the slash or an @botname suffix
+ * @param args Rest of the message with leading spaces removed, "" if none
+ * @param ctx Context given to telegram_bot_start_polling()
  */
-bool telegram_bot_can_send(int cooldown_sec);
+typedef void (*telegram_command_handler_t)(const char *command, const char *args, void *ctx);
 
 /**
- * @brief Reset notification cooldown timer
+ * @brief Start receiving commands
+ *
+ * A low-priority task long-polls getUpdates over its own kept-alive
+ * connection, so sends never wait behind an open poll. Responses are parsed
+ * as they stream in with fixed buffers, so memory use does not depend on
+ * their size. Messages from other chats are ignored, as are commands
+ * queued at Telegram before polling started. An update is confirmed only
+ * once the response carrying it has parsed, so a broken response is
+ * fetched again rather than lost.
+ *
+ * @param poll_timeout_s Seconds Telegram may hold each poll open
+ * @param handler Command handler
+ * @param ctx Passed to the handler
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized or
+ *         already polling
  */
-void telegram_bot_reset_cooldown(void);
+esp_err_t telegram_bot_start_polling(int poll_timeout_s, telegram_command_handler_t handler, void *ctx);
 
 /**
  * @brief Deinitialize Telegram bot client
+ *
+ * When polling, blocks until the poll task has exited, so no poll or command
+ * handler runs against the cleared state. A backoff wait is cut short, but
+ * an open long poll is waited out, up to the poll timeout plus 10 s. Called
+ * from a command handler, it returns at once and the poll task exits once
+ * the handler returns.
  */
 void telegram_bot_deinit(void);
 
@@ -0,0 +1,93 @@
+/**
+ * @file telegram_updates.h
+ * @brief getUpdates response parsing and offset bookkeeping for command polling
+ *
+ * Kept apart from the HTTP code in telegram_bot.c so the host build can
+ * replay responses through it. One telegram_updates_t follows the poll loop:
+ * each response is fed in as it arrives, and only a response that parsed
+ * completely moves the offset, so updates in a broken response are asked
+ * for again rather than confirmed unseen.
+ */
+
+#ifndef TELEGRAM_UPDATES_H
+#define TELEGRAM_UPDATES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "json_stream.h"
+#include "telegram_bot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Updates asked for per poll; the commands of one response fit a fixed table */
+#define TELEGRAM_UPDATES_LIMIT 5
+
+typedef struct {
+    // Kept across polls
+    const char *chat_id;       ///< Only commands from this chat are kept
+    long long offset;          ///< First update to ask for; confirms all before it
+    bool synced;               ///< Updates queued before startup have been dropped
+
+    // Whole response
+    bool ok;
+    int retry_after;           ///< parameters.retry_after of a 429, 0 if none
+    char description[96];
+    long long next_offset;     ///< Past the highest update_id seen, 0 if none
+
+    // Update being parsed
+    char chat[24];
+    char text[TELEGRAM_COMMAND_MAX];
+
+    // Commands from the configured chat, in order
+    int count;
+    char commands[TELEGRAM_UPDATES_LIMIT][TELEGRAM_COMMAND_MAX];
+
+    json_stream_t parser;
+} telegram_updates_t;
+
+/**
+ * @brief Start polling from scratch
+ * @param updates State to initialize
+ * @param chat_id Configured chat; must outlive the state
+ */
+void telegram_updates_init(telegram_updates_t *updates, const char *chat_id);
+
+/**
+ * @brief Offset for the next getUpdates request
+ *
+ * -1 until the first response has been accepted: Telegram then returns only
+ * the newest queued update and forgets the older ones, so commands sent
+ * while the device was off are not run. That request must not wait (timeout
+ * 0), or a command sent just after startup would be dropped as well.
+ */
+long long telegram_updates_request_offset(const telegram_updates_t *updates);
+
+/**
+ * @brief Prepare for the next response, keeping the offset
+ */
+void telegram_updates_begin(telegram_updates_t *updates);
+
+/**
+ * @brief Feed the next chunk of the response body
+ * @return false once the body was found to be malformed
+ */
+bool telegram_updates_feed(telegram_updates_t *updates, const char *data, size_t len);
+
+/**
+ * @brief Accept a response whose body arrived in full
+ *
+ * The response counts only if it parsed to its end and says "ok":true; only
+ * then does the offset move past its updates. The first accepted response
+ * just synchronizes: its commands are dropped and count is set to 0.
+ *
+ * @return true if accepted; commands[0..count) are then to be run
+ */
+bool telegram_updates_finish(telegram_updates_t *updates);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEGRAM_UPDATES_H
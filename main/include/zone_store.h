@@ -0,0 +1,42 @@
+/**
+ * @file zone_store.h
+ * @brief Motion zones persisted in NVS
+ */
+
+#ifndef ZONE_STORE_H
+#define ZONE_STORE_H
+
+#include "esp_err.h"
+#include "motion_detector.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Apply the zones saved in NVS to the motion detector
+ *
+ * Requires nvs_flash_init(). Without saved zones the whole image is used.
+ *
+ * @return ESP_OK if saved zones were applied, ESP_ERR_NOT_FOUND if none are saved
+ */
+esp_err_t zone_store_restore(void);
+
+/**
+ * @brief Apply zones to the motion detector and save them in NVS
+ * @param config Zones
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an invalid zone
+ */
+esp_err_t zone_store_save(const motion_zone_config_t *config);
+
+/**
+ * @brief Remove the saved zones and go back to the whole image
+ * @return ESP_OK on success
+ */
+esp_err_t zone_store_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ZONE_STORE_H
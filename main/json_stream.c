@@ -0,0 +1,263 @@
+/**
+ * @file json_stream.c
+ * @brief Streaming JSON parser with fixed-size state
+ */
+
+#include "json_stream.h"
+#include <string.h>
+
+enum {
+    ST_VALUE,        // Between tokens
+    ST_STRING,
+    ST_ESCAPE,
+    ST_UNICODE,
+    ST_NUMBER,
+    ST_LITERAL,
+};
+
+void json_stream_init(json_stream_t *js, json_stream_value_cb on_value,
+                      json_stream_end_cb on_object_end, void *ctx)
+{
+    memset(js, 0, sizeof(*js));
+    js->on_value = on_value;
+    js->on_object_end = on_object_end;
+    js->ctx = ctx;
+    js->state = ST_VALUE;
+}
+
+const char *json_stream_container(const json_stream_t *js, int level)
+{
+    if (level < 1 || level > js->depth || level > JSON_STREAM_MAX_DEPTH) {
+        return "";
+    }
+    return js->path[level - 1];
+}
+
+bool json_stream_complete(const json_stream_t *js)
+{
+    return js->done && !js->error;
+}
+
+static void put_char(json_stream_t *js, char c)
+{
+    const size_t cap = js->string_is_key ? JSON_STREAM_KEY_MAX : JSON_STREAM_VALUE_MAX;
+
+    // Truncate, keeping room for the terminator
+    if (js->len + 1 < cap) {
+        js->value[js->len++] = c;
+    }
+}
+
+static void put_code_point(json_stream_t *js, uint16_t cp)
+{
+    // Surrogate pairs are not combined; each half becomes U+FFFD
+    if (cp >= 0xD800 && cp <= 0xDFFF) {
+        cp = 0xFFFD;
+    }
+
+    if (cp < 0x80) {
+        put_char(js, (char)cp);
+    } else if (cp < 0x800) {
+        put_char(js, (char)(0xC0 | (cp >> 6)));
+        put_char(js, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        put_char(js, (char)(0xE0 | (cp >> 12)));
+        put_char(js, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        put_char(js, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+static const char *current_key(const json_stream_t *js)
+{
+    const bool in_array = js->depth > 0 && js->depth <= JSON_STREAM_MAX_DEPTH &&
+                          js->in_array[js->depth - 1];
+    return in_array ? "" : js->key;
+}
+
+static void emit(json_stream_t *js, json_stream_type_t type)
+{
+    js->value[js->len] = '\0';
+    if (js->on_value) {
+        js->on_value(js->ctx, js, current_key(js), type, js->value);
+    }
+    js->len = 0;
+}
+
+static void end_string(json_stream_t *js)
+{
+    js->value[js->len] = '\0';
+    if (js->string_is_key) {
+        memcpy(js->key, js->value, js->len + 1);
+        js->len = 0;
+    } else {
+        emit(js, JSON_STREAM_STRING);
+    }
+    js->state = ST_VALUE;
+}
+
+static bool open_container(json_stream_t *js, bool array)
+{
+    if (js->depth < JSON_STREAM_MAX_DEPTH) {
+        strcpy(js->path[js->depth], current_key(js));
+        js->in_array[js->depth] = array;
+    }
+    js->depth++;
+    js->expect_key = !array;
+    js->key[0] = '\0';
+    return true;
+}
+
+static bool close_container(json_stream_t *js, bool array)
+{
+    if (js->depth == 0) {
+        return false;
+    }
+    if (js->depth <= JSON_STREAM_MAX_DEPTH && js->in_array[js->depth - 1] != array) {
+        return false;
+    }
+
+    if (!array && js->on_object_end) {
+        js->on_object_end(js->ctx, js);
+    }
+    js->depth--;
+    js->expect_key = false;
+    js->done = js->depth == 0;
+    return true;
+}
+
+static bool is_literal_char(char c)
+{
+    return (c >= 'a' && c <= 'z');
+}
+
+static bool is_number_char(char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// Handles one character in ST_VALUE; returns false on malformed input
+static bool value_char(json_stream_t *js, char c)
+{
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n':
+            return true;
+        default:
+            break;
+    }
+
+    // Nothing but whitespace may follow the document
+    if (js->done) {
+        return false;
+    }
+
+    switch (c) {
+        case ':':
+            return true;
+        case ',':
+            // In an object, the next string is a key again
+            js->expect_key = js->depth > 0 && js->depth <= JSON_STREAM_MAX_DEPTH &&
+                             !js->in_array[js->depth - 1];
+            return true;
+        case '{':
+            return open_container(js, false);
+        case '[':
+            return open_container(js, true);
+        case '}':
+            return close_container(js, false);
+        case ']':
+            return close_container(js, true);
+        case '"':
+            js->string_is_key = js->expect_key;
+            js->expect_key = false;
+            js->len = 0;
+            js->state = ST_STRING;
+            return true;
+        default:
+            break;
+    }
+
+    js->len = 0;
+    if (is_number_char(c)) {
+        js->state = ST_NUMBER;
+    } else if (is_literal_char(c)) {
+        js->state = ST_LITERAL;
+    } else {
+        return false;
+    }
+    put_char(js, c);
+    return true;
+}
+
+bool json_stream_feed(json_stream_t *js, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !js->error; i++) {
+        const char c = data[i];
+
+        switch (js->state) {
+            case ST_STRING:
+                if (c == '"') {
+                    end_string(js);
+                } else if (c == '\\') {
+                    js->state = ST_ESCAPE;
+                } else {
+                    put_char(js, c);
+                }
+                break;
+
+            case ST_ESCAPE:
+                js->state = ST_STRING;
+                switch (c) {
+                    case 'n': put_char(js, '\n'); break;
+                    case 't': put_char(js, '\t'); break;
+                    case 'r': put_char(js, '\r'); break;
+                    case 'b': put_char(js, '\b'); break;
+                    case 'f': put_char(js, '\f'); break;
+                    case 'u':
+                        js->state = ST_UNICODE;
+                        js->hex_digits = 0;
+                        js->code_point = 0;
+                        break;
+                    default:  put_char(js, c); break;
+                }
+                break;
+
+            case ST_UNICODE: {
+                int digit;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else {
+                    js->error = true;
+                    break;
+                }
+                js->code_point = (uint16_t)((js->code_point << 4) | digit);
+                if (++js->hex_digits == 4) {
+                    put_code_point(js, js->code_point);
+                    js->state = ST_STRING;
+                }
+                break;
+            }
+
+            case ST_NUMBER:
+            case ST_LITERAL:
+                if ((js->state == ST_NUMBER && is_number_char(c)) ||
+                    (js->state == ST_LITERAL && is_literal_char(c))) {
+                    put_char(js, c);
+                    break;
+                }
+                emit(js, js->state == ST_NUMBER ? JSON_STREAM_NUMBER : JSON_STREAM_LITERAL);
+                js->state = ST_VALUE;
+                js->error = !value_char(js, c);
+                break;
+
+            default:
+                js->error = !value_char(js, c);
+                break;
+        }
+    }
+
+    return !js->error;
+}
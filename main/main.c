@@ -4,6 +4,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -17,15 +18,26 @@
 #include "wifi_manager.h"
 #include "camera_manager.h"
 #include "motion_detector.h"
+#include "jpeg_dc.h"
 #include "face_detector.h"
 #include "telegram_bot.h"
 #include "led_control.h"
-#include "img_converters.h" // Needed for RGB565->JPEG conversion
+#include "frame_pool.h"
+#include "zone_store.h"
+#include "spsc_queue.h"
+#include "detection_scheduler.h"
+#include "event_fsm.h"
+#include "object_tracker.h"
+#include "alert_limiter.h"
+#include "notify_spool.h"
 
 static const char *TAG = "main";
 
-// Detection task handle
-static TaskHandle_t s_detection_task_handle = NULL;
+// Quality used when RGB565 frames are encoded in software
+#define SOFT_JPEG_QUALITY 80
+
+// How long detection waits for a free JPEG slot before dropping an event
+#define JPEG_SLOT_WAIT_MS 2000
 
 // Detection event configuration
 typedef enum {
@@ -36,13 +48,21 @@ typedef enum {
 
 typedef struct {
     detection_event_type_t type;
-    camera_fb_t *fb;      // Used if camera provides JPEG natively
-    uint8_t *jpg_buf;     // Used if we did software conversion
-    size_t jpg_len;       // Length of software converted JPEG
+    event_info_t info;      // Event the alert belongs to
+    bool ended;             // End-of-event summary, text only
+    uint16_t track_id;      // Track that describes the event, 0 if none
+    track_direction_t direction;
+    frame_slot_t *jpg_slot; // Pool slot holding the JPEG to send
+    frame_album_t album;    // Used in burst mode, slots owned by the event
+    bool snapshot;          // Requested with /snap; no slot means none was free
 } detection_event_t;
 
 static QueueHandle_t s_detection_queue = NULL;
 
+// Runtime state changed by bot commands; not persisted, so a reboot re-arms
+static volatile bool s_armed = true;
+static volatile bool s_snapshot_requested = false;
+
 // Statistics
 static uint32_t s_motion_count = 0;
 static uint32_t s_face_count = 0;
@@ -76,99 +96,230 @@ static void print_system_info(void)
 #endif
 
     ESP_LOGI(TAG, "Detection Interval: %d ms", CONFIG_DETECTION_INTERVAL_MS);
-    ESP_LOGI(TAG, "Telegram Cooldown: %d sec", CONFIG_TELEGRAM_COOLDOWN_SEC);
+    ESP_LOGI(TAG, "Alert Budget: motion %d + 1/%d sec, face %d + 1/%d sec",
+             CONFIG_ALERT_MOTION_BURST, CONFIG_ALERT_MOTION_REFILL_SEC,
+             CONFIG_ALERT_FACE_BURST, CONFIG_ALERT_FACE_REFILL_SEC);
+#if CONFIG_TELEGRAM_COMMANDS_ENABLE
+    ESP_LOGI(TAG, "Bot Commands: ENABLED (poll %d sec)", CONFIG_TELEGRAM_POLL_TIMEOUT_SEC);
+#else
+    ESP_LOGI(TAG, "Bot Commands: DISABLED");
+#endif
     ESP_LOGI(TAG, "========================================");
 }
 
+/**
+ * @brief Release every buffer owned by a detection event
+ */
+static void detection_event_release(detection_event_t *event)
+{
+    if (event->jpg_slot) {
+        frame_pool_release(event->jpg_slot);
+        event->jpg_slot = NULL;
+    }
+    frame_album_release(&event->album);
+}
+
+static detection_event_type_t detection_event_type(bool motion_detected, bool face_detected)
+{
+    return (motion_detected && face_detected) ? DETECTION_EVENT_BOTH :
+           motion_detected ? DETECTION_EVENT_MOTION : DETECTION_EVENT_FACE;
+}
+
+/**
+ * @brief Format a monotonic time as uptime, hh:mm:ss
+ */
+static void format_uptime(int64_t ms, char *buf, size_t len)
+{
+    uint32_t s = (uint32_t)(ms / 1000);
+    snprintf(buf, len, "%02lu:%02lu:%02lu",
+             (unsigned long)(s / 3600), (unsigned long)(s / 60 % 60), (unsigned long)(s % 60));
+}
+
+/**
+ * @brief Send a notification: a text message, one photo or an album
+ */
+static esp_err_t publish_notification(const char *text, const telegram_photo_t *photos, int count)
+{
+    if (count == 0) {
+        return telegram_bot_send_message(text);
+    }
+    return telegram_bot_send_media_group(photos, count, text);
+}
+
+#if CONFIG_NOTIFY_SPOOL_ENABLE
+static int64_t s_last_replay_us = 0;
+
+/**
+ * @brief Time until the next spooled notification may be replayed
+ *
+ * At most one per replay interval, and never before the client's backoff
+ * or rate limit has expired.
+ */
+static TickType_t spool_replay_wait(void)
+{
+    if (!notify_spool_pending()) {
+        return portMAX_DELAY;
+    }
+    
+    int64_t next_us = s_last_replay_us + (int64_t)CONFIG_NOTIFY_SPOOL_REPLAY_INTERVAL_MS * 1000;
+    int64_t wait_ms = (next_us - esp_timer_get_time()) / 1000;
+    uint32_t retry_ms = telegram_bot_retry_delay_ms();
+    
+    wait_ms = wait_ms > (int64_t)retry_ms ? wait_ms : (int64_t)retry_ms;
+    return wait_ms > 0 ? pdMS_TO_TICKS(wait_ms) : 0;
+}
+
+/**
+ * @brief Replay one spooled notification if one is due
+ *
+ * Called between alerts, so a backlog never delays a live alert by more
+ * than one send. The task waits for the next one on its queue, so retries
+ * never block it.
+ */
+static void spool_replay_due(void)
+{
+    if (!wifi_manager_is_connected() || spool_replay_wait() != 0) {
+        return;
+    }
+    s_last_replay_us = esp_timer_get_time();
+    
+    if (notify_spool_replay_one(publish_notification) == ESP_OK) {
+        s_telegram_sent++;
+    }
+}
+#endif
+
+/**
+ * @brief Send a notification now, or spool it if Telegram cannot be reached
+ */
+static esp_err_t deliver_notification(const char *text, const telegram_photo_t *photos, int count)
+{
+#if CONFIG_NOTIFY_SPOOL_ENABLE
+    esp_err_t err = wifi_manager_is_connected() ? publish_notification(text, photos, count)
+                                                : ESP_ERR_INVALID_STATE;
+    if (telegram_bot_is_retryable(err) && notify_spool_append(text, photos, count) == ESP_OK) {
+        ESP_LOGW(TAG, "Notification spooled, retry in %lu ms",
+                 (unsigned long)telegram_bot_retry_delay_ms());
+    }
+    return err;
+#else
+    return publish_notification(text, photos, count);
+#endif
+}
+
 /**
  * @brief Task to handle Telegram notifications
  */
 static void telegram_notification_task(void *pvParameters)
 {
     detection_event_t event;
+    TickType_t wait = portMAX_DELAY;
     
     ESP_LOGI(TAG, "Telegram notification task started");
     
     while (1) {
-        if (xQueueReceive(s_detection_queue, &event, portMAX_DELAY) == pdTRUE) {
-            // Check cooldown
-            if (!telegram_bot_can_send(CONFIG_TELEGRAM_COOLDOWN_SEC)) {
-                ESP_LOGW(TAG, "Telegram cooldown active, skipping notification");
-                // Cleanup
-                if (event.fb) camera_manager_return_fb(event.fb);
-                if (event.jpg_buf) free(event.jpg_buf);
+#if CONFIG_NOTIFY_SPOOL_ENABLE
+        // Wake up to replay spooled notifications while there are any
+        spool_replay_due();
+        wait = spool_replay_wait();
+        wait = wait == 0 ? pdMS_TO_TICKS(CONFIG_NOTIFY_SPOOL_REPLAY_INTERVAL_MS) : wait;
+#endif
+        if (xQueueReceive(s_detection_queue, &event, wait) == pdTRUE) {
+            char start[16];
+            format_uptime(event.info.start_ms, start, sizeof(start));
+            
+            if (event.ended) {
+                char summary[160];
+                snprintf(summary, sizeof(summary),
+                         "✅ <b>Event #%lu ended</b>\n"
+                         "🕒 Start: %s uptime\n"
+                         "⏱ Duration: %lu.%lu s, %lu frame(s)",
+                         (unsigned long)event.info.id, start,
+                         (unsigned long)(event.info.duration_ms / 1000),
+                         (unsigned long)(event.info.duration_ms % 1000 / 100),
+                         (unsigned long)event.info.trigger_frames);
+                deliver_notification(summary, NULL, 0);
+                continue;
+            }
+            
+            if (event.snapshot) {
+                char caption[96];
+                format_uptime(esp_timer_get_time() / 1000, start, sizeof(start));
+                snprintf(caption, sizeof(caption), "📷 <b>Snapshot</b>\n🕒 %s uptime", start);
+                if (event.jpg_slot) {
+                    telegram_photo_t photo = { event.jpg_slot->buf, event.jpg_slot->len };
+                    deliver_notification(caption, &photo, 1);
+                } else {
+                    telegram_bot_send_message("📷 No free image buffer for a snapshot, try again");
+                }
+                detection_event_release(&event);
                 continue;
             }
             
             // Build message
             char message[256];
+            int n = 0;
             switch (event.type) {
                 case DETECTION_EVENT_MOTION:
-                    snprintf(message, sizeof(message),
-                             "🚨 <b>Motion Detected!</b>\n"
-                             "📅 Time: Detection #%lu\n"
-                             "📸 Image attached",
-                             ++s_motion_count);
+                    n = snprintf(message, sizeof(message),
+                                 "🚨 <b>Motion Detected!</b>\n"
+                                 "📅 Time: Detection #%lu\n",
+                                 ++s_motion_count);
                     break;
                     
                 case DETECTION_EVENT_FACE:
-                    snprintf(message, sizeof(message),
-                             "👤 <b>Face Detected!</b>\n"
-                             "📅 Time: Detection #%lu\n"
-                             "📸 Image attached",
-                             ++s_face_count);
+                    n = snprintf(message, sizeof(message),
+                                 "👤 <b>Face Detected!</b>\n"
+                                 "📅 Time: Detection #%lu\n",
+                                 ++s_face_count);
                     break;
                     
                 case DETECTION_EVENT_BOTH:
-                    snprintf(message, sizeof(message),
-                             "🚨👤 <b>Motion + Face Detected!</b>\n"
-                             "📅 Motion: #%lu, Face: #%lu\n"
-                             "📸 Image attached",
-                             ++s_motion_count, ++s_face_count);
+                    n = snprintf(message, sizeof(message),
+                                 "🚨👤 <b>Motion + Face Detected!</b>\n"
+                                 "📅 Motion: #%lu, Face: #%lu\n",
+                                 ++s_motion_count, ++s_face_count);
                     break;
             }
+            n += snprintf(message + n, sizeof(message) - n,
+                          "🆔 Event #%lu, start %s uptime, %lu.%lu s so far\n",
+                          (unsigned long)event.info.id, start,
+                          (unsigned long)(event.info.duration_ms / 1000),
+                          (unsigned long)(event.info.duration_ms % 1000 / 100));
+            if (event.track_id && n < (int)sizeof(message)) {
+                n += snprintf(message + n, sizeof(message) - n, "🧭 Track #%u, moving %s\n",
+                              event.track_id, object_tracker_direction_name(event.direction));
+            }
+            if (n < (int)sizeof(message)) {
+                snprintf(message + n, sizeof(message) - n, "📸 Image attached");
+            }
             
             // Flash LED
             led_flash_capture();
             
-            // Determine which buffer to use
-            uint8_t *buf_to_send = NULL;
-            size_t len_to_send = 0;
-            
-            if (event.fb) {
-                buf_to_send = event.fb->buf;
-                len_to_send = event.fb->len;
-            } else if (event.jpg_buf) {
-                buf_to_send = event.jpg_buf;
-                len_to_send = event.jpg_len;
+            // Album photos, or the single photo, oldest first
+            telegram_photo_t photos[FRAME_ALBUM_MAX];
+            int count = 0;
+            for (int i = 0; i < event.album.count; i++) {
+                photos[count].data = event.album.slots[i]->buf;
+                photos[count++].len = event.album.slots[i]->len;
+            }
+            if (count == 0 && event.jpg_slot && event.jpg_slot->len > 0) {
+                photos[count].data = event.jpg_slot->buf;
+                photos[count++].len = event.jpg_slot->len;
             }
             
-            if (buf_to_send && len_to_send > 0) {
-                // Send photo with caption
-                esp_err_t err = telegram_bot_send_photo(
-                    buf_to_send,
-                    len_to_send,
-                    message
-                );
-                
-                if (err == ESP_OK) {
-                    s_telegram_sent++;
-                    ESP_LOGI(TAG, "✅ Telegram notification sent (total: %lu)", s_telegram_sent);
-                } else {
-                    ESP_LOGE(TAG, "❌ Failed to send Telegram notification");
-                }
+            // Without a photo (should not happen) this falls back to text
+            if (deliver_notification(message, photos, count) == ESP_OK) {
+                s_telegram_sent++;
+                ESP_LOGI(TAG, "✅ Telegram notification with %d photo(s) sent (total: %lu)",
+                         count, s_telegram_sent);
             } else {
-                // Should not happen, but fallback to text
-                telegram_bot_send_message(message);
+                ESP_LOGE(TAG, "❌ Failed to send Telegram notification");
             }
             
             // Cleanup resources
-            if (event.fb) {
-                camera_manager_return_fb(event.fb);
-            }
-            if (event.jpg_buf) {
-                free(event.jpg_buf); // Generated by frame2jpg
-            }
+            detection_event_release(&event);
             
             // Indicate detection on LED
             led_indicate_detection();
@@ -176,36 +327,713 @@ static void telegram_notification_task(void *pvParameters)
     }
 }
 
+// ===== Detection pipeline =====
+//
+// capture (core 1) -> convert (core 1) -> analyze (core 0) -> encode (core 1)
+//     -> publish (telegram_notification_task, core 0)
+//
+// A fixed set of frames circulates through the stages over SPSC queues and
+// the encode stage hands each one back to capture, so analysis of one frame
+// overlaps the capture and conversion of the next. A stage that has nothing
+// to do sleeps on its task notification.
+
+#define PIPELINE_FRAMES (CAMERA_FB_COUNT - 1)   // Leave one buffer for the driver to fill
+#define PIPELINE_QUEUE_SIZE 4                   // Power of two >= PIPELINE_FRAMES
+#define PIPELINE_STATS_PERIOD_MS 10000
+#define PIPELINE_MAX_FACES 8                    // Face result storage per frame
+
+typedef struct {
+    camera_fb_t *fb;
+    uint8_t *luma;          // Motion luma image, reused by this frame slot
+    size_t luma_size;
+    int luma_width;
+    int luma_height;
+    bool luma_valid;
+    bool motion_detected;
+    bool face_detected;
+    event_action_t event_action;    // Set by the analyze stage from event_fsm
+    bool alert_possible;            // An event starting now could raise an alert
+    event_info_t event;
+    uint16_t track_id;              // Track that describes a starting event, 0 if none
+    track_direction_t direction;
+    face_t faces[PIPELINE_MAX_FACES];
+    face_result_t face_result;  // Bound to faces, filled by the analyze stage
+    int64_t capture_us;     // When capture of this frame started
+    bool still;             // fb is a high-resolution still (NULL if it failed), not analysed
+} pipeline_frame_t;
+
+typedef enum {
+    STAGE_CAPTURE,
+    STAGE_CONVERT,
+    STAGE_ANALYZE,
+    STAGE_ENCODE,
+    STAGE_COUNT
+} pipeline_stage_t;
+
+typedef struct {
+    spsc_queue_t queue;
+    void *storage[PIPELINE_QUEUE_SIZE];
+    TaskHandle_t consumer;
+} stage_link_t;
+
+// Counters are written only by their own stage; the reporter takes deltas.
+// busy_us wraps after about an hour, which the unsigned deltas tolerate.
+typedef struct {
+    uint32_t frames;
+    uint32_t busy_us;
+    uint32_t max_us;        // Cleared by the reporter every period
+} stage_stats_t;
+
+_Static_assert(PIPELINE_FRAMES <= PIPELINE_QUEUE_SIZE, "pipeline queues must hold every frame");
+
+static pipeline_frame_t s_frames[PIPELINE_FRAMES];
+static stage_link_t s_link_free;     // encode  -> capture
+static stage_link_t s_link_convert;  // capture -> convert
+static stage_link_t s_link_analyze;  // convert -> analyze
+static stage_link_t s_link_encode;   // analyze -> encode
+
+static stage_stats_t s_stage_stats[STAGE_COUNT];
+static const char *const s_stage_names[STAGE_COUNT] = { "capture", "convert", "analyze", "encode" };
+static uint32_t s_result_latency_us = 0;   // Capture start to analysis result, summed
+static uint32_t s_result_latency_max_us = 0;
+static volatile bool s_still_requested = false;  // Set by encode, taken by capture
+
+static void link_send(stage_link_t *link, pipeline_frame_t *frame)
+{
+    // Every link can hold all frames, so the push cannot fail
+    spsc_queue_push(&link->queue, frame);
+    xTaskNotifyGive(link->consumer);
+}
+
+static pipeline_frame_t *link_receive(stage_link_t *link)
+{
+    pipeline_frame_t *frame;
+    
+    while ((frame = spsc_queue_pop(&link->queue)) == NULL) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    return frame;
+}
+
+static void stage_account(pipeline_stage_t stage, int64_t start_us)
+{
+    stage_stats_t *stats = &s_stage_stats[stage];
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start_us);
+    
+    stats->frames++;
+    stats->busy_us += elapsed;
+    if (elapsed > stats->max_us) {
+        stats->max_us = elapsed;
+    }
+}
+
 /**
- * @brief Main detection task
+ * @brief Log per-stage throughput and latency every PIPELINE_STATS_PERIOD_MS
  */
-static void detection_task(void *pvParameters)
+static void pipeline_report_stats(void)
 {
-    ESP_LOGI(TAG, "Detection task started on core %d", xPortGetCoreID());
+    static stage_stats_t s_last[STAGE_COUNT];
+    static uint32_t s_last_latency_us = 0;
+    static int64_t s_last_report_us = 0;
     
-    // Allocate grayscale buffer for motion detection
-    const int motion_width = 320;
-    const int motion_height = 240;
-    const size_t gray_size = motion_width * motion_height;
+    int64_t now = esp_timer_get_time();
+    if (s_last_report_us == 0) {
+        s_last_report_us = now;
+        return;
+    }
+    if (now - s_last_report_us < PIPELINE_STATS_PERIOD_MS * 1000LL) {
+        return;
+    }
     
-    uint8_t *gray_buffer = heap_caps_malloc(gray_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!gray_buffer) {
-        gray_buffer = malloc(gray_size);
+    float period_s = (now - s_last_report_us) / 1e6f;
+    s_last_report_us = now;
+    
+    uint32_t analyzed = s_stage_stats[STAGE_ANALYZE].frames - s_last[STAGE_ANALYZE].frames;
+    uint32_t latency_us = s_result_latency_us - s_last_latency_us;
+    s_last_latency_us = s_result_latency_us;
+    
+    ESP_LOGI(TAG, "Pipeline stats (%.0f s):", period_s);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_stats_t *stats = &s_stage_stats[i];
+        uint32_t frames = stats->frames - s_last[i].frames;
+        uint32_t busy_us = stats->busy_us - s_last[i].busy_us;
+        
+        ESP_LOGI(TAG, "  %-8s %5.1f fps  avg %6.1f ms  max %6.1f ms",
+                 s_stage_names[i], frames / period_s,
+                 frames ? busy_us / 1000.0f / frames : 0.0f,
+                 stats->max_us / 1000.0f);
+        
+        s_last[i].frames = stats->frames;
+        s_last[i].busy_us = stats->busy_us;
+        stats->max_us = 0;
     }
     
-    if (!gray_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate grayscale buffer");
-        vTaskDelete(NULL);
-        return;
+    ESP_LOGI(TAG, "  capture->result avg %.1f ms  max %.1f ms",
+             analyzed ? latency_us / 1000.0f / analyzed : 0.0f,
+             s_result_latency_max_us / 1000.0f);
+    s_result_latency_max_us = 0;
+    
+    if (camera_manager_still_supported()) {
+        camera_still_stats_t still;
+        camera_manager_get_still_stats(&still);
+        ESP_LOGI(TAG, "  stills %lu (failed %lu), switch last/max %.0f/%.0f ms, "
+                 "restore last/max %.0f/%.0f ms, %lu frame(s) dropped",
+                 still.stills, still.failures, still.switch_us / 1000.0f, still.switch_max_us / 1000.0f,
+                 still.restore_us / 1000.0f, still.restore_max_us / 1000.0f, still.dropped_frames);
     }
     
-    // Initialize motion detector
+    scheduler_stats_t sched;
+    detection_scheduler_get_stats(&sched);
+    ESP_LOGI(TAG, "  scheduler interval %lu ms, change avg %.1f%%, last %s, "
+             "speed-up/hold/back-off %lu/%lu/%lu, face run/skip %lu/%lu",
+             sched.interval_ms, sched.change_avg,
+             detection_scheduler_decision_name(sched.last_decision),
+             sched.speed_ups, sched.holds, sched.backoffs,
+             sched.face_runs, sched.face_skips);
+}
+
 #if CONFIG_ENABLE_MOTION_DETECTION
-    motion_detector_init(motion_width, motion_height, 
-                         CONFIG_MOTION_THRESHOLD, 
-                         (float)CONFIG_MOTION_PIXEL_THRESHOLD);
+/**
+ * @brief Build the motion luma image for a frame (convert stage)
+ *
+ * RGB565 frames are converted to luma and downsampled in one pass. JPEG
+ * frames are reduced to one pixel per 8x8 block straight from their DC
+ * coefficients, so hardware-JPEG sensors get motion detection without a full
+ * decode.
+ *
+ * @param frame Pipeline frame
+ * @return true if frame->luma holds a valid image
+ */
+static bool frame_to_luma(pipeline_frame_t *frame)
+{
+#if CONFIG_MOTION_RGB565_BIG_ENDIAN
+    const bool rgb565_big_endian = true;
+#else
+    const bool rgb565_big_endian = false;
+#endif
+    const camera_fb_t *fb = frame->fb;
+    int width;
+    int height;
+    
+    if (fb->format == PIXFORMAT_RGB565) {
+        width = fb->width / CONFIG_MOTION_DOWNSCALE;
+        height = fb->height / CONFIG_MOTION_DOWNSCALE;
+    } else if (fb->format == PIXFORMAT_JPEG) {
+        width = (fb->width + 7) / 8;
+        height = (fb->height + 7) / 8;
+    } else {
+        return false;
+    }
+    
+    size_t needed = (size_t)width * height;
+    if (needed > frame->luma_size) {
+        heap_caps_free(frame->luma);
+        frame->luma = heap_caps_malloc(needed, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!frame->luma) {
+            frame->luma = heap_caps_malloc(needed, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+        if (!frame->luma) {
+            ESP_LOGE(TAG, "Failed to allocate motion luma buffer");
+            frame->luma_size = 0;
+            return false;
+        }
+        frame->luma_size = needed;
+    }
+    
+    esp_err_t err;
+    if (fb->format == PIXFORMAT_RGB565) {
+        err = rgb565_to_luma_scaled(fb->buf, fb->width, fb->height, rgb565_big_endian,
+                                    CONFIG_MOTION_DOWNSCALE, frame->luma, frame->luma_size);
+    } else {
+        err = jpeg_dc_thumbnail(fb->buf, fb->len, frame->luma, frame->luma_size,
+                                &width, &height);
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Motion luma extraction failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    
+    frame->luma_width = width;
+    frame->luma_height = height;
+    return true;
+}
+
+/**
+ * @brief Run motion detection on a frame's luma image (analyze stage)
+ *
+ * The detector is re-initialized whenever the luma size changes.
+ */
+static motion_result_t detect_motion(const pipeline_frame_t *frame)
+{
+    motion_result_t none = { .detected = false };
+    static int s_motion_width = 0;
+    static int s_motion_height = 0;
+    
+    if (frame->luma_width != s_motion_width || frame->luma_height != s_motion_height) {
+        if (motion_detector_init(frame->luma_width, frame->luma_height, CONFIG_MOTION_THRESHOLD,
+                                 (float)CONFIG_MOTION_PIXEL_THRESHOLD) != ESP_OK) {
+            return none;
+        }
+        s_motion_width = frame->luma_width;
+        s_motion_height = frame->luma_height;
+    }
+    
+    return motion_detector_process(frame->luma, (size_t)frame->luma_width * frame->luma_height);
+}
+
+/**
+ * @brief Scale the motion blobs of the last analyzed frame to frame pixels
+ *
+ * The blobs become extra face detection regions, so a small moving person
+ * is searched even when the skin proposals miss them, and tracker input.
+ */
+static int motion_regions(const pipeline_frame_t *frame, face_box_t *regions, int max_regions)
+{
+    const motion_map_t *map = motion_detector_get_map();
+    if (!map || frame->luma_width == 0 || frame->luma_height == 0) {
+        return 0;
+    }
+    
+    int sx = frame->fb->width / frame->luma_width;
+    int sy = frame->fb->height / frame->luma_height;
+    int count = 0;
+    
+    for (int i = 0; i < map->blob_count && count < max_regions; i++) {
+        const motion_blob_t *blob = &map->blobs[i];
+        regions[count++] = (face_box_t){
+            .x = blob->x * sx,
+            .y = blob->y * sy,
+            .w = blob->w * sx,
+            .h = blob->h * sy,
+        };
+    }
+    
+    return count;
+}
+#endif
+
+#if CONFIG_CAMERA_HIRES_CAPTURE
+// Detect low, capture high: a starting event asks the capture stage for one
+// high-resolution still, and its alert is held here until the still comes
+// down the pipeline a few frames later. Alerts raised meanwhile are held
+// behind it, so they still reach the notification task in order. Encode
+// stage only.
+#define HELD_EVENTS_MAX 3
+
+static bool s_still_awaited = false;       // Requested and not arrived yet
+static bool s_still_for_snapshot = false;
+static frame_slot_t *s_still_slot = NULL;  // Arrived before its alert was ready
+static detection_event_t s_held_events[HELD_EVENTS_MAX];  // Oldest first
+static int s_held_count = 0;
+
+/**
+ * @brief Ask the capture stage for a still
+ * @return false if the camera cannot take stills
+ */
+static bool still_request(bool for_snapshot)
+{
+    if (!camera_manager_still_supported()) {
+        return false;
+    }
+    s_still_for_snapshot |= for_snapshot;
+    if (!s_still_awaited) {
+        s_still_awaited = true;
+        s_still_requested = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Put the stored still in an alert, after the album or in place of its photo
+ */
+static void still_attach(detection_event_t *event)
+{
+    if (!s_still_slot) {
+        return;
+    }
+    
+    if (event->album.count > 0) {
+        if (event->album.count == FRAME_ALBUM_MAX) {
+            frame_pool_release(event->album.slots[--event->album.count]);
+        }
+        event->album.slots[event->album.count++] = s_still_slot;
+    } else {
+        frame_pool_release(event->jpg_slot);
+        event->jpg_slot = s_still_slot;
+    }
+    s_still_slot = NULL;
+}
+#endif
+
+static void event_queue(detection_event_t *event)
+{
+    if (xQueueSend(s_detection_queue, event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Queue full, dropping event");
+        detection_event_release(event);
+    }
+}
+
+/**
+ * @brief Queue an alert or end summary for the notification task
+ *
+ * With CONFIG_CAMERA_HIRES_CAPTURE, while a still is awaited the event is
+ * held until it arrives, behind any event already held; see still_arrived().
+ */
+static void event_send(detection_event_t *event)
+{
+#if CONFIG_CAMERA_HIRES_CAPTURE
+    if (s_still_awaited) {
+        if (s_held_count == HELD_EVENTS_MAX) {
+            ESP_LOGW(TAG, "Event #%lu: too many alerts waiting for the still, sent without it",
+                     (unsigned long)s_held_events[0].info.id);
+            event_queue(&s_held_events[0]);
+            memmove(&s_held_events[0], &s_held_events[1], (HELD_EVENTS_MAX - 1) * sizeof(s_held_events[0]));
+            s_held_count--;
+        }
+        s_held_events[s_held_count++] = *event;
+        return;
+    }
+    if (!event->ended) {
+        still_attach(event);
+    }
+#endif
+    
+    event_queue(event);
+}
+
+#if CONFIG_BURST_ALBUM_ENABLE
+#define BURST_ALBUM_FRAMES (CONFIG_BURST_PRE_FRAMES + 1 + CONFIG_BURST_POST_FRAMES)
+
+// Album being collected after a trigger
+static detection_event_t s_burst_event;
+static int s_burst_post_remaining = 0;
+
+static void burst_queue_album(void)
+{
+    s_burst_post_remaining = 0;
+    
+    if (s_burst_event.album.count == 0) {
+        ESP_LOGW(TAG, "No frames stored for album, dropping event");
+        return;
+    }
+    
+    s_burst_event.type = detection_event_type(s_burst_event.info.motion, s_burst_event.info.face);
+    event_send(&s_burst_event);
+}
+
+/**
+ * @brief Feed one frame to the pre-trigger ring or the album being collected
+ *
+ * Frames go into the ring until an event starts; the ring's frames then
+ * start an album, and the next CONFIG_BURST_POST_FRAMES frames are appended
+ * to it before it is queued. Frames are copied into pool slots, so the
+ * camera buffer can always be returned by the caller. As for single photos,
+ * the trigger and post-trigger frames wait for a slot when every slot is
+ * still waiting to be sent, which throttles the pipeline; other frames
+ * just reuse the ring's oldest slot.
+ *
+ * While no alert is possible (disarmed, or every budget spent) the ring is
+ * emptied instead of filled: those frames could only be encoded to be
+ * thrown away, and once alerts are possible again they are no longer the
+ * frames just before a trigger.
+ *
+ * @param alert_possible Whether an event starting now could raise an alert
+ */
+static void burst_process_frame(const camera_fb_t *fb, event_action_t action, bool alert_possible,
+                                const event_info_t *info, uint16_t track_id, track_direction_t direction)
+{
+    if (s_burst_post_remaining > 0) {
+        if (frame_album_add(&s_burst_event.album, fb, SOFT_JPEG_QUALITY,
+                            pdMS_TO_TICKS(JPEG_SLOT_WAIT_MS)) != ESP_OK) {
+            ESP_LOGW(TAG, "No slot for post-trigger frame");
+        }
+        s_burst_event.info.motion |= info->motion;
+        s_burst_event.info.face |= info->face;
+        
+        if (--s_burst_post_remaining == 0 || s_burst_event.album.count >= FRAME_ALBUM_MAX) {
+            burst_queue_album();
+        }
+        return;
+    }
+    
+    if (!alert_possible && action != EVENT_ACTION_START) {
+        frame_ring_clear();
+        return;
+    }
+    TickType_t wait = action == EVENT_ACTION_START ? pdMS_TO_TICKS(JPEG_SLOT_WAIT_MS) : 0;
+    if (frame_ring_push(fb, SOFT_JPEG_QUALITY, wait) != ESP_OK && action == EVENT_ACTION_START) {
+        ESP_LOGW(TAG, "No free JPEG slot for the trigger frame");
+    }
+    
+    if (action != EVENT_ACTION_START) {
+        return;
+    }
+    
+    memset(&s_burst_event, 0, sizeof(s_burst_event));
+    s_burst_event.info = *info;
+    s_burst_event.track_id = track_id;
+    s_burst_event.direction = direction;
+    frame_ring_take(&s_burst_event.album);
+    
+    s_burst_post_remaining = CONFIG_BURST_POST_FRAMES;
+    if (s_burst_post_remaining == 0) {
+        burst_queue_album();
+    }
+}
+#endif
+
+#if !CONFIG_BURST_ALBUM_ENABLE
+/**
+ * @brief Queue a single-photo event for a frame that triggered detection
+ *
+ * The frame is stored in a pool slot so the camera buffer goes straight back
+ * to the driver. When every slot is still waiting to be sent, block here
+ * rather than fall back to the heap; that backpressure also throttles the
+ * pipeline.
+ */
+static void queue_detection_event(const camera_fb_t *fb, const event_info_t *info,
+                                  uint16_t track_id, track_direction_t direction)
+{
+    detection_event_t event = {
+        .type = detection_event_type(info->motion, info->face),
+        .info = *info,
+        .track_id = track_id,
+        .direction = direction,
+        .jpg_slot = NULL
+    };
+    
+    frame_slot_t *slot = frame_pool_acquire_wait(pdMS_TO_TICKS(JPEG_SLOT_WAIT_MS));
+    if (!slot) {
+        ESP_LOGW(TAG, "No free JPEG slot, dropping event");
+        return;
+    }
+    
+    // JPEG frames are copied, RGB565 frames encoded into the slot
+    if (frame_pool_store(slot, fb, SOFT_JPEG_QUALITY) != ESP_OK) {
+        ESP_LOGE(TAG, "JPEG conversion failed");
+        frame_pool_release(slot);
+        return;
+    }
+    event.jpg_slot = slot;
+    
+    event_send(&event);
+}
+#endif
+
+/**
+ * @brief Queue the frame requested with /snap
+ *
+ * Unlike an alert this never waits for a slot: a busy pool is reported back
+ * to the chat rather than stalling the pipeline.
+ */
+static void queue_snapshot(const camera_fb_t *fb)
+{
+    detection_event_t event = { .snapshot = true };
+    
+    frame_slot_t *slot = fb ? frame_pool_acquire() : NULL;
+    if (slot && frame_pool_store(slot, fb, SOFT_JPEG_QUALITY) == ESP_OK) {
+        event.jpg_slot = slot;
+    } else {
+        ESP_LOGW(TAG, "No free JPEG slot for snapshot");
+        frame_pool_release(slot);
+    }
+    
+    if (xQueueSend(s_detection_queue, &event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Queue full, dropping snapshot");
+        detection_event_release(&event);
+    }
+}
+
+#if CONFIG_CAMERA_HIRES_CAPTURE
+/**
+ * @brief Hand a still that came down the pipeline to whoever asked for it
+ * @param fb Still, NULL if the camera could not take one
+ */
+static void still_arrived(const camera_fb_t *fb)
+{
+    s_still_awaited = false;
+    
+    if (s_still_for_snapshot) {
+        s_still_for_snapshot = false;
+        queue_snapshot(fb);
+    }
+    
+    // Kept only for an alert that is waiting or still collecting its album
+    frame_pool_release(s_still_slot);
+    s_still_slot = NULL;
+#if CONFIG_BURST_ALBUM_ENABLE
+    bool wanted = s_held_count > 0 || s_burst_post_remaining > 0;
+#else
+    bool wanted = s_held_count > 0;
+#endif
+    if (fb && wanted) {
+        frame_slot_t *slot = frame_pool_acquire();
+        if (slot && frame_pool_store(slot, fb, SOFT_JPEG_QUALITY) == ESP_OK) {
+            s_still_slot = slot;
+        } else {
+            ESP_LOGW(TAG, "No JPEG slot for the %u byte still, sending the analysis frame", fb->len);
+            frame_pool_release(slot);
+        }
+    }
+    
+    // The newest alert gets the still, being closest to it in time; the
+    // held events then go out in the order they were raised
+    int newest = -1;
+    for (int i = 0; i < s_held_count; i++) {
+        if (!s_held_events[i].ended) {
+            newest = i;
+        }
+    }
+    for (int i = 0; i < s_held_count; i++) {
+        if (i == newest) {
+            still_attach(&s_held_events[i]);
+        } else if (!s_held_events[i].ended) {
+            ESP_LOGI(TAG, "Event #%lu: still went to a newer event",
+                     (unsigned long)s_held_events[i].info.id);
+        }
+        event_queue(&s_held_events[i]);
+    }
+    s_held_count = 0;
+}
+#endif
+
+/**
+ * @brief Take the photo requested with /snap, as a still when possible
+ */
+static void snapshot_take(const camera_fb_t *fb)
+{
+#if CONFIG_CAMERA_HIRES_CAPTURE
+    if (still_request(true)) {
+        return;
+    }
 #endif
+    queue_snapshot(fb);
+}
+
+/**
+ * @brief Feed the frame's motion blobs and faces to the tracker
+ */
+static void track_frame(const pipeline_frame_t *frame, const face_box_t *blobs, int blob_count,
+                        int64_t now_ms)
+{
+    tracker_detection_t detections[TRACKER_MAX_DETECTIONS];
+    int count = 0;
+    
+    for (int i = 0; i < blob_count && count < TRACKER_MAX_DETECTIONS; i++) {
+        detections[count++] = (tracker_detection_t){
+            blobs[i].x, blobs[i].y, blobs[i].w, blobs[i].h, TRACK_KIND_MOTION
+        };
+    }
+    for (int i = 0; frame->face_detected && i < frame->face_result.count &&
+                    count < TRACKER_MAX_DETECTIONS; i++) {
+        const face_box_t *box = &frame->face_result.faces[i].box;
+        detections[count++] = (tracker_detection_t){ box->x, box->y, box->w, box->h, TRACK_KIND_FACE };
+    }
+    
+    object_tracker_update(detections, count, now_ms);
+}
+
+/**
+ * @brief Pick the track that describes a starting event
+ *
+ * Claims the confirmed tracks not announced yet, preferring a face. With
+ * CONFIG_EVENT_DEDUPE_TRACKS an event whose tracks were all announced by an
+ * earlier event is the same objects again and raises no alert.
+ *
+ * @return false if the alert should be dropped
+ */
+static bool claim_event_tracks(pipeline_frame_t *frame)
+{
+    tracker_track_t tracks[TRACKER_MAX_TRACKS];
+    int fresh = object_tracker_claim_unreported(tracks, TRACKER_MAX_TRACKS);
+    
+    if (fresh == 0) {
+#if CONFIG_EVENT_DEDUPE_TRACKS
+        return object_tracker_get_tracks(tracks, TRACKER_MAX_TRACKS) == 0;
+#else
+        return true;
+#endif
+    }
+    
+    int best = 0;
+    for (int i = 0; i < fresh; i++) {
+        if (tracks[i].kind == TRACK_KIND_FACE) {
+            best = i;
+            break;
+        }
+    }
+    frame->track_id = tracks[best].id;
+    frame->direction = object_tracker_direction(&tracks[best]);
+    return true;
+}
+
+// Event whose alert was suppressed; its end is not reported either
+static uint32_t s_silenced_event = 0;
 
+/**
+ * @brief Whether an event starting now could raise an alert
+ *
+ * Lets burst mode skip encoding pre-trigger frames that no alert would use.
+ * Runs on the analyze stage, which owns the alert limiter.
+ */
+static bool alert_possible(int64_t now_ms)
+{
+    if (!s_armed) {
+        return false;
+    }
+    if (alert_limiter_wait_ms(ALERT_CLASS_MOTION, now_ms) == 0) {
+        return true;
+    }
+#if CONFIG_ENABLE_FACE_DETECTION
+    return alert_limiter_wait_ms(ALERT_CLASS_FACE, now_ms) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Decide whether a starting event raises an alert
+ *
+ * Runs on the analyze stage, before the triggering frame is encoded, so a
+ * suppressed alert costs no encode or pool slot of its own. The burst
+ * ring's pre-trigger frames are encoded ahead of any event, but only while
+ * alert_possible() holds, so a disarmed camera or a spent budget does not
+ * keep the encoder busy either. The budget is checked before tracks are
+ * claimed, so an object whose alert was suppressed is still announced once
+ * the budget allows.
+ */
+static bool event_alert_allowed(pipeline_frame_t *frame, int64_t now_ms)
+{
+    if (!s_armed) {
+        ESP_LOGI(TAG, "Event #%lu: disarmed, no alert", (unsigned long)frame->event.id);
+        return false;
+    }
+    
+    alert_class_t alert_class = frame->event.face ? ALERT_CLASS_FACE : ALERT_CLASS_MOTION;
+    uint32_t wait_ms = alert_limiter_wait_ms(alert_class, now_ms);
+    
+    if (wait_ms > 0) {
+        alert_limiter_record_suppressed(alert_class);
+        ESP_LOGI(TAG, "Event #%lu: %s alert budget spent for %lu ms, no alert",
+                 (unsigned long)frame->event.id, alert_class_name(alert_class), (unsigned long)wait_ms);
+        return false;
+    }
+    if (!claim_event_tracks(frame)) {
+        ESP_LOGI(TAG, "Event #%lu: every track already reported, no alert",
+                 (unsigned long)frame->event.id);
+        return false;
+    }
+    return alert_limiter_take(alert_class, now_ms);
+}
+
+/**
+ * @brief Capture stage: grab frames at the configured period
+ */
+static void capture_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Capture stage started on core %d", xPortGetCoreID());
+    
     vTaskDelay(pdMS_TO_TICKS(1000));
     
     // Warmup frames
@@ -215,96 +1043,512 @@ static void detection_task(void *pvParameters)
         vTaskDelay(pdMS_TO_TICKS(100));
     }
     
-    ESP_LOGI(TAG, "Detection loop starting...");
+    ESP_LOGI(TAG, "Detection pipeline starting (%d frames in flight)...", PIPELINE_FRAMES);
+    
+    TickType_t last_wake = xTaskGetTickCount();
     
     while (1) {
-        // Capture frame
-        camera_fb_t *fb = camera_manager_capture();
-        if (!fb) {
-            ESP_LOGW(TAG, "Camera capture failed");
-            vTaskDelay(pdMS_TO_TICKS(1000));
+        pipeline_frame_t *frame = link_receive(&s_link_free);
+        
+        frame->fb = NULL;
+        frame->still = false;
+        if (s_still_requested) {
+            // Sent down even if it failed, so the encode stage always hears back
+            s_still_requested = false;
+            frame->still = true;
+            frame->capture_us = esp_timer_get_time();
+            frame->fb = camera_manager_capture_still();
+        }
+        while (!frame->fb && !frame->still) {
+            // The period no longer includes processing time, which now
+            // overlaps with the next capture; if a stage is slower than the
+            // period, capture simply waits for a free frame above. The
+            // scheduler shortens the period while activity rises and
+            // stretches it in a static scene.
+            uint32_t interval_ms = detection_scheduler_interval_ms();
+            if (interval_ms > 0 &&
+                xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(interval_ms)) == pdFALSE) {
+                last_wake = xTaskGetTickCount();
+            }
+            
+            frame->capture_us = esp_timer_get_time();
+            frame->fb = camera_manager_capture();
+            if (!frame->fb) {
+                ESP_LOGW(TAG, "Camera capture failed");
+                vTaskDelay(pdMS_TO_TICKS(1000));
+            }
+        }
+        
+        stage_account(STAGE_CAPTURE, frame->capture_us);
+        link_send(&s_link_convert, frame);
+        
+        pipeline_report_stats();
+    }
+}
+
+/**
+ * @brief Convert stage: build the luma image used by motion detection
+ */
+static void convert_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Convert stage started on core %d", xPortGetCoreID());
+    
+    while (1) {
+        pipeline_frame_t *frame = link_receive(&s_link_convert);
+        int64_t start = esp_timer_get_time();
+        
+        frame->luma_valid = false;
+#if CONFIG_ENABLE_MOTION_DETECTION
+        frame->luma_valid = !frame->still && frame_to_luma(frame);
+#endif
+        
+        stage_account(STAGE_CONVERT, start);
+        link_send(&s_link_analyze, frame);
+    }
+}
+
+/**
+ * @brief Analyze stage: motion and face detection
+ */
+static void analyze_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Analyze stage started on core %d", xPortGetCoreID());
+    
+    while (1) {
+        pipeline_frame_t *frame = link_receive(&s_link_analyze);
+        int64_t start = esp_timer_get_time();
+        
+        if (frame->still) {
+            // Not an analysis sample: a different size, and taken on request
+            frame->event_action = EVENT_ACTION_NONE;
+            link_send(&s_link_encode, frame);
             continue;
         }
         
-        bool motion_detected = false;
-        bool face_detected = false;
+        int64_t now_ms = start / 1000;
+        
+        frame->motion_detected = false;
+        frame->face_detected = false;
+        frame->track_id = 0;
+        frame->direction = TRACK_DIR_NONE;
+        face_box_t regions[MOTION_MAX_BLOBS];
+        int region_count = 0;
         
         // 1. Motion Detection
 #if CONFIG_ENABLE_MOTION_DETECTION
-        if (fb->format == PIXFORMAT_RGB565) {
-            // Convert to grayscale for motion detection
-            // RGB565 stride is 2 bytes/pixel
-            if (rgb565_to_grayscale(fb->buf, fb->len, gray_buffer, gray_size) == ESP_OK) {
-                motion_result_t result = motion_detector_process(gray_buffer, gray_size);
-                motion_detected = result.detected;
-            }
-        } else if (fb->format == PIXFORMAT_JPEG) {
-            // Skip motion detection for JPEG for now, 
-            // or decode to RGB888 then gray... expense.
-            // Assuming RGB565 for GC2145
+        motion_result_t motion = { .detected = false };
+        if (frame->luma_valid) {
+            motion = detect_motion(frame);
+        }
+        frame->motion_detected = motion.detected;
+        detection_scheduler_update(motion.change_percentage, motion.detected, now_ms);
+        if (motion.blob_count > 0) {
+            region_count = motion_regions(frame, regions, MOTION_MAX_BLOBS);
         }
 #endif
 
         // 2. Face Detection
 #if CONFIG_ENABLE_FACE_DETECTION
-        if (fb->format == PIXFORMAT_RGB565) {
-            face_result_t result = face_detector_detect(fb);
-            face_detected = result.detected;
+        if (frame->fb->format == PIXFORMAT_RGB565 &&
+            detection_scheduler_face_due(frame->motion_detected, now_ms)) {
+            frame->face_detected = face_detector_detect_regions(frame->fb, regions, region_count,
+                                                                &frame->face_result) == ESP_OK &&
+                                   frame->face_result.count > 0;
         }
 #endif
+        
+        // 3. Tracking: link moving blobs and faces across frames
+        track_frame(frame, regions, frame->motion_detected ? region_count : 0, now_ms);
+        
+        // 4. Events: only the frame that confirms an event raises an alert
+        frame->alert_possible = alert_possible(now_ms);
+        frame->event_action = event_fsm_update(frame->motion_detected, frame->face_detected,
+                                               now_ms, &frame->event);
+        if (frame->event_action == EVENT_ACTION_START && !event_alert_allowed(frame, now_ms)) {
+            s_silenced_event = frame->event.id;
+            frame->event_action = EVENT_ACTION_NONE;
+        } else if (frame->event_action == EVENT_ACTION_END && frame->event.id == s_silenced_event) {
+            frame->event_action = EVENT_ACTION_NONE;
+        }
+        
+        stage_account(STAGE_ANALYZE, start);
+        
+        uint32_t latency = (uint32_t)(esp_timer_get_time() - frame->capture_us);
+        s_result_latency_us += latency;
+        if (latency > s_result_latency_max_us) {
+            s_result_latency_max_us = latency;
+        }
+        
+        link_send(&s_link_encode, frame);
+    }
+}
 
-        // 3. Handle Detection
-        if (motion_detected || face_detected) {
-            detection_event_t event = {
-                .type = (motion_detected && face_detected) ? DETECTION_EVENT_BOTH :
-                        motion_detected ? DETECTION_EVENT_MOTION : DETECTION_EVENT_FACE,
-                .fb = NULL,
-                .jpg_buf = NULL,
-                .jpg_len = 0
-            };
-
-            // Prepare image for Telegram
-            if (fb->format == PIXFORMAT_JPEG) {
-                // Native JPEG, pass the FB directly
-                // IMPORTANT: We do NOT return the FB here, we pass ownership to the queue
-                event.fb = fb;
-                fb = NULL; // Mark as null so we don't free it at end of loop
-            } 
-            else if (fb->format == PIXFORMAT_RGB565) {
-                // Convert to JPEG
-                uint8_t *jpg_buf = NULL;
-                size_t jpg_len = 0;
-                
-                if (frame2jpg(fb, 80, &jpg_buf, &jpg_len)) {
-                    event.jpg_buf = jpg_buf;
-                    event.jpg_len = jpg_len;
-                    // We keep 'fb' to be returned at end of loop
-                } else {
-                    ESP_LOGE(TAG, "JPEG conversion failed");
-                }
-            }
-            
-            // Queue event
-            if (event.fb || event.jpg_buf) {
-                if (xQueueSend(s_detection_queue, &event, 0) != pdTRUE) {
-                    ESP_LOGW(TAG, "Queue full, dropping event");
-                    if (event.fb) camera_manager_return_fb(event.fb);
-                    if (event.jpg_buf) free(event.jpg_buf);
-                    // If we passed fb ownership to event, we need to recover it 
-                    // if queue failed, but here we just freed it.
-                    // If we kept fb (RGB case), it will be returned below.
-                }
-            }
+/**
+ * @brief Encode stage: store triggered frames as JPEG and queue events
+ *
+ * This is the last stage to touch the camera buffer; it returns it to the
+ * driver and hands the frame back to capture.
+ */
+static void encode_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Encode stage started on core %d", xPortGetCoreID());
+    
+    while (1) {
+        pipeline_frame_t *frame = link_receive(&s_link_encode);
+        int64_t start = esp_timer_get_time();
+        
+        // 4. Handle events
+#if CONFIG_CAMERA_HIRES_CAPTURE
+        if (frame->still) {
+            still_arrived(frame->fb);
+        } else if (frame->event_action == EVENT_ACTION_START) {
+            still_request(false);
+        }
+#endif
+#if CONFIG_BURST_ALBUM_ENABLE
+        if (!frame->still) {
+            burst_process_frame(frame->fb, frame->event_action, frame->alert_possible,
+                                &frame->event, frame->track_id, frame->direction);
+        }
+#else
+        if (frame->event_action == EVENT_ACTION_START) {
+            queue_detection_event(frame->fb, &frame->event, frame->track_id, frame->direction);
         }
+#endif
+#if CONFIG_EVENT_REPORT_END
+        if (frame->event_action == EVENT_ACTION_END) {
+            detection_event_t summary = { .info = frame->event, .ended = true };
+            event_send(&summary);
+        }
+#endif
+        if (s_snapshot_requested && !frame->still) {
+            s_snapshot_requested = false;
+            snapshot_take(frame->fb);
+        }
+        
+        camera_manager_return_fb(frame->fb);
+        frame->fb = NULL;
         
-        // Return frame buffer (if ownership not passed)
-        if (fb) {
-            camera_manager_return_fb(fb);
+        stage_account(STAGE_ENCODE, start);
+        link_send(&s_link_free, frame);
+    }
+}
+
+/**
+ * @brief Configure the capture-rate scheduler from Kconfig
+ */
+static void scheduler_setup(void)
+{
+    scheduler_config_t config = {
+#if CONFIG_ADAPTIVE_SCHEDULER && CONFIG_ENABLE_MOTION_DETECTION
+        .min_interval_ms = CONFIG_DETECTION_MIN_INTERVAL_MS,
+        .base_interval_ms = CONFIG_DETECTION_INTERVAL_MS,
+        .max_interval_ms = CONFIG_DETECTION_MAX_INTERVAL_MS,
+        .backoff_percent = CONFIG_DETECTION_BACKOFF_PERCENT,
+#else
+        .min_interval_ms = CONFIG_DETECTION_INTERVAL_MS,
+        .base_interval_ms = CONFIG_DETECTION_INTERVAL_MS,
+        .max_interval_ms = CONFIG_DETECTION_INTERVAL_MS,
+        .backoff_percent = 200,
+#endif
+#if CONFIG_ENABLE_MOTION_DETECTION
+        // Half the trigger level already counts as activity
+        .activity_threshold = CONFIG_MOTION_PIXEL_THRESHOLD / 2.0f,
+#else
+        .activity_threshold = 0.0f,
+#endif
+#if CONFIG_FACE_POLICY_ON_MOTION
+        .face_policy = FACE_POLICY_ON_MOTION,
+#elif CONFIG_FACE_POLICY_AFTER_MOTION
+        .face_policy = FACE_POLICY_AFTER_MOTION,
+        .face_hold_ms = CONFIG_FACE_POLICY_HOLD_MS,
+#else
+        .face_policy = FACE_POLICY_ALWAYS,
+#endif
+    };
+    
+    if (detection_scheduler_init(&config) != ESP_OK) {
+        ESP_LOGW(TAG, "Invalid scheduler intervals, using a fixed %d ms interval",
+                 CONFIG_DETECTION_INTERVAL_MS);
+        config.min_interval_ms = CONFIG_DETECTION_INTERVAL_MS;
+        config.base_interval_ms = CONFIG_DETECTION_INTERVAL_MS;
+        config.max_interval_ms = CONFIG_DETECTION_INTERVAL_MS;
+        config.backoff_percent = 200;
+        detection_scheduler_init(&config);
+    }
+}
+
+/**
+ * @brief Configure event confirmation from Kconfig
+ */
+static void events_setup(void)
+{
+    event_fsm_config_t config = {
+        .confirm_frames = CONFIG_EVENT_CONFIRM_FRAMES,
+        .window_frames = CONFIG_EVENT_WINDOW_FRAMES,
+        .min_duration_ms = CONFIG_EVENT_MIN_DURATION_MS,
+        .end_quiet_ms = CONFIG_EVENT_END_QUIET_MS,
+        .cooldown_ms = CONFIG_EVENT_COOLDOWN_MS,
+    };
+    
+    const alert_budget_t budgets[ALERT_CLASS_COUNT] = {
+        [ALERT_CLASS_MOTION] = { CONFIG_ALERT_MOTION_BURST, CONFIG_ALERT_MOTION_REFILL_SEC * 1000 },
+        [ALERT_CLASS_FACE] = { CONFIG_ALERT_FACE_BURST, CONFIG_ALERT_FACE_REFILL_SEC * 1000 },
+    };
+    
+    object_tracker_init(NULL);
+    alert_limiter_init(budgets);
+    
+    if (event_fsm_init(&config) != ESP_OK) {
+        ESP_LOGW(TAG, "Confirmation needs %d of %d frames, confirming on every frame",
+                 CONFIG_EVENT_CONFIRM_FRAMES, CONFIG_EVENT_WINDOW_FRAMES);
+        config.confirm_frames = 1;
+        config.window_frames = 1;
+        event_fsm_init(&config);
+    }
+}
+
+/**
+ * @brief Create the pipeline stage tasks and prime capture with free frames
+ */
+static esp_err_t pipeline_start(void)
+{
+    stage_link_t *links[] = { &s_link_free, &s_link_convert, &s_link_analyze, &s_link_encode };
+    for (size_t i = 0; i < sizeof(links) / sizeof(links[0]); i++) {
+        spsc_queue_init(&links[i]->queue, links[i]->storage, PIPELINE_QUEUE_SIZE);
+    }
+    
+    // Consumers must be known before anything is sent to them; capture is
+    // created last, once the other stages exist
+    if (xTaskCreatePinnedToCore(convert_task, "convert_stage", 4 * 1024, NULL, 9,
+                                &s_link_convert.consumer, 1) != pdPASS ||
+        xTaskCreatePinnedToCore(analyze_task, "analyze_stage", 8 * 1024, NULL, 8,
+                                &s_link_analyze.consumer, 0) != pdPASS ||
+        xTaskCreatePinnedToCore(encode_task, "encode_stage", 8 * 1024, NULL, 7,
+                                &s_link_encode.consumer, 1) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create pipeline tasks");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    for (int i = 0; i < PIPELINE_FRAMES; i++) {
+        face_result_init(&s_frames[i].face_result, s_frames[i].faces, PIPELINE_MAX_FACES);
+        spsc_queue_push(&s_link_free.queue, &s_frames[i]);
+    }
+    
+    if (xTaskCreatePinnedToCore(capture_task, "capture_stage", 4 * 1024, NULL, 10,
+                                &s_link_free.consumer, 1) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create capture task");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    return ESP_OK;
+}
+
+#if CONFIG_TELEGRAM_COMMANDS_ENABLE
+// ===== Bot commands =====
+//
+// Handlers run on the polling task. They only flip flags or hand settings to
+// modules that apply them from their own task, so a command never blocks
+// the pipeline.
+
+// Same range as CONFIG_MOTION_THRESHOLD
+#define COMMAND_THRESHOLD_MIN 5
+#define COMMAND_THRESHOLD_MAX 50
+
+typedef struct {
+    const char *name;
+    void (*handler)(const char *args);
+    const char *help;
+} bot_command_t;
+
+static void command_help(const char *args);
+
+static void command_snap(const char *args)
+{
+    s_snapshot_requested = true;
+}
+
+static void command_arm(const char *args)
+{
+    s_armed = true;
+    telegram_bot_send_message("🛡 <b>Armed</b>: alerts are sent again");
+}
+
+static void command_disarm(const char *args)
+{
+    s_armed = false;
+    telegram_bot_send_message("💤 <b>Disarmed</b>: detection keeps running, alerts are muted and dropped until /arm");
+}
+
+static void command_status(const char *args)
+{
+    char uptime[16];
+    char message[384];
+    const char *ip = wifi_manager_get_ip();
+    alert_limiter_stats_t motion, face;
+    
+    format_uptime(esp_timer_get_time() / 1000, uptime, sizeof(uptime));
+    alert_limiter_get_stats(ALERT_CLASS_MOTION, &motion);
+    alert_limiter_get_stats(ALERT_CLASS_FACE, &face);
+    
+    int n = snprintf(message, sizeof(message),
+                     "📊 <b>Status</b>\n"
+                     "%s\n"
+                     "⏱ Uptime: %s\n"
+                     "🌐 IP: %s\n"
+                     "📨 Sent: %lu, suppressed: %lu motion, %lu face\n"
+                     "💾 Heap: %lu, PSRAM: %lu bytes free",
+                     s_armed ? "🛡 Armed" : "💤 Disarmed", uptime, ip ? ip : "Unknown",
+                     (unsigned long)s_telegram_sent, (unsigned long)motion.suppressed,
+                     (unsigned long)face.suppressed, (unsigned long)esp_get_free_heap_size(),
+                     (unsigned long)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+#if CONFIG_ENABLE_MOTION_DETECTION
+    motion_zone_config_t zones;
+    motion_detector_get_zones(&zones);
+    if (n < (int)sizeof(message)) {
+        n += snprintf(message + n, sizeof(message) - n, "\n🎚 Threshold: %d, %u zone(s)",
+                      motion_detector_get_threshold(), zones.zone_count);
+    }
+#endif
+#if CONFIG_NOTIFY_SPOOL_ENABLE
+    notify_spool_stats_t spool;
+    notify_spool_get_stats(&spool);
+    if (n < (int)sizeof(message)) {
+        n += snprintf(message + n, sizeof(message) - n, "\n📦 Spooled: %lu",
+                      (unsigned long)spool.pending);
+    }
+#endif
+    if (camera_manager_still_supported() && n < (int)sizeof(message)) {
+        camera_still_stats_t still;
+        camera_manager_get_still_stats(&still);
+        n += snprintf(message + n, sizeof(message) - n,
+                      "\n🔎 Stills: %lu, switch %lu ms (max %lu), %lu frame(s) dropped",
+                      (unsigned long)still.stills, (unsigned long)(still.switch_us / 1000),
+                      (unsigned long)(still.switch_max_us / 1000), (unsigned long)still.dropped_frames);
+    }
+    (void)n;
+    
+    telegram_bot_send_message(message);
+}
+
+#if CONFIG_ENABLE_MOTION_DETECTION
+static void command_threshold(const char *args)
+{
+    char reply[96];
+    char *end;
+    long threshold = strtol(args, &end, 10);
+    
+    if (end == args || *end != '\0' ||
+        threshold < COMMAND_THRESHOLD_MIN || threshold > COMMAND_THRESHOLD_MAX) {
+        snprintf(reply, sizeof(reply), "🎚 Threshold is %d; give a value from %d to %d",
+                 motion_detector_get_threshold(), COMMAND_THRESHOLD_MIN, COMMAND_THRESHOLD_MAX);
+    } else {
+        // Applied by the analyze stage on its next frame
+        motion_detector_set_threshold((int)threshold);
+        snprintf(reply, sizeof(reply), "🎚 Threshold set to %ld until reboot", threshold);
+    }
+    telegram_bot_send_message(reply);
+}
+
+static void command_zones(const char *args)
+{
+    motion_zone_config_t config;
+    char message[384];
+    int n;
+    
+    motion_detector_get_zones(&config);
+    
+    if (strcmp(args, "clear") == 0) {
+        zone_store_clear();
+        telegram_bot_send_message("🗺 Zones cleared, the whole image is watched");
+        return;
+    }
+    
+    if (strncmp(args, "add ", 4) == 0) {
+        int v[6] = { 0, 0, 0, 0, 0, 100 };
+        int fields = sscanf(args + 4, "%d,%d,%d,%d,%d,%d", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        bool in_range = true;
+        for (int i = 0; i < 6; i++) {
+            in_range &= v[i] >= 0 && v[i] <= 255;
         }
         
-        vTaskDelay(pdMS_TO_TICKS(CONFIG_DETECTION_INTERVAL_MS));
+        if (fields < 4 || !in_range) {
+            telegram_bot_send_message("🗺 Usage: /zones add x,y,w,h[,threshold[,weight]] in percent");
+            return;
+        }
+        if (config.zone_count >= MOTION_MAX_ZONES) {
+            telegram_bot_send_message("🗺 No room for another zone, /zones clear first");
+            return;
+        }
+        config.zones[config.zone_count++] = (motion_zone_t){ v[0], v[1], v[2], v[3], v[4], v[5] };
+        if (zone_store_save(&config) != ESP_OK) {
+            telegram_bot_send_message("🗺 Zone rejected: it must be non-empty and inside the image");
+            return;
+        }
+    } else if (args[0] != '\0') {
+        telegram_bot_send_message("🗺 Usage: /zones, /zones add x,y,w,h[,threshold[,weight]], /zones clear");
+        return;
+    }
+    
+    n = snprintf(message, sizeof(message), "🗺 <b>Zones</b> (weight %u outside them)",
+                 config.default_weight);
+    if (config.zone_count == 0) {
+        n += snprintf(message + n, sizeof(message) - n, "\nNone, the whole image is watched");
+    }
+    for (int i = 0; i < config.zone_count && n < (int)sizeof(message); i++) {
+        const motion_zone_t *zone = &config.zones[i];
+        n += snprintf(message + n, sizeof(message) - n,
+                      "\n%d. x %u, y %u, %ux%u, threshold %u, weight %u", i + 1,
+                      zone->x, zone->y, zone->w, zone->h, zone->threshold, zone->weight);
     }
+    telegram_bot_send_message(message);
 }
+#endif
+
+static const bot_command_t s_commands[] = {
+    { "help",      command_help,      "this list" },
+    { "snap",      command_snap,      "send a photo now" },
+    { "arm",       command_arm,       "send alerts" },
+    { "disarm",    command_disarm,    "mute alerts, keep detecting" },
+    { "status",    command_status,    "uptime, counters and settings" },
+#if CONFIG_ENABLE_MOTION_DETECTION
+    { "threshold", command_threshold, "N: motion pixel threshold" },
+    { "zones",     command_zones,     "list, add x,y,w,h[,t[,wt]] or clear" },
+#endif
+};
+
+#define COMMAND_COUNT (sizeof(s_commands) / sizeof(s_commands[0]))
+
+static void command_help(const char *args)
+{
+    char message[384];
+    int n = snprintf(message, sizeof(message), "🤖 <b>Commands</b>");
+    
+    for (size_t i = 0; i < COMMAND_COUNT && n < (int)sizeof(message); i++) {
+        n += snprintf(message + n, sizeof(message) - n, "\n/%s - %s",
+                      s_commands[i].name, s_commands[i].help);
+    }
+    telegram_bot_send_message(message);
+}
+
+static void handle_command(const char *command, const char *args, void *ctx)
+{
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        if (strcmp(command, s_commands[i].name) == 0) {
+            s_commands[i].handler(args);
+            return;
+        }
+    }
+    
+    // Telegram sends /start when the chat with the bot is opened
+    if (strcmp(command, "start") == 0) {
+        command_help(args);
+        return;
+    }
+    
+    telegram_bot_send_message("Unknown command, see /help");
+}
+#endif
 
 /**
  * @brief Application entry point
@@ -334,28 +1578,75 @@ void app_main(void)
     if (camera_manager_init() != ESP_OK) return;
     
 #if CONFIG_ENABLE_FACE_DETECTION
-    face_detector_init();
+#if CONFIG_MOTION_RGB565_BIG_ENDIAN
+    face_detector_set_byte_order(true);
+#endif
+    if (face_detector_init() == ESP_OK) {
+#if CONFIG_FACE_SKIN_MODEL_YCBCR
+        face_detector_set_skin_model(skin_model_ycbcr, &SKIN_YCBCR_DEFAULT);
+#elif CONFIG_FACE_SKIN_MODEL_HSV
+        face_detector_set_skin_model(skin_model_hsv, &SKIN_HSV_DEFAULT);
+#endif
+    }
 #endif
     
     if (telegram_bot_init(CONFIG_TELEGRAM_BOT_TOKEN, CONFIG_TELEGRAM_CHAT_ID) != ESP_OK) return;
     
+#if CONFIG_NOTIFY_SPOOL_ENABLE
+    // Notifications are still delivered live without the spool
+    notify_spool_init(CONFIG_NOTIFY_SPOOL_MAX_KB * 1024);
+    notify_spool_stats_t spool;
+    notify_spool_get_stats(&spool);
+#endif
+    
     // Send startup notification
-    char message[128];
+    char message[192];
     const char *ip = wifi_manager_get_ip();
-    snprintf(message, sizeof(message), 
-             "🟢 <b>ESP32-S3-CAM Online!</b>\n"
-             "📡 WiFi Connected\n"
-             "🌐 IP: %s\n"
-             "🔍 Ready", 
-             ip ? ip : "Unknown");
+    int n = snprintf(message, sizeof(message), 
+                     "🟢 <b>ESP32-S3-CAM Online!</b>\n"
+                     "📡 WiFi Connected\n"
+                     "🌐 IP: %s\n"
+                     "🔍 Ready", 
+                     ip ? ip : "Unknown");
+#if CONFIG_TELEGRAM_COMMANDS_ENABLE
+    n += snprintf(message + n, sizeof(message) - n, ", /help for commands");
+#endif
+#if CONFIG_NOTIFY_SPOOL_ENABLE
+    if (spool.pending > 0 && n < (int)sizeof(message)) {
+        snprintf(message + n, sizeof(message) - n, "\n📦 %lu spooled notification(s) to follow",
+                 (unsigned long)spool.pending);
+    }
+#else
+    (void)n;
+#endif
              
     telegram_bot_send_message(message);
     
+#if CONFIG_BURST_ALBUM_ENABLE
+    // Room for one album being sent while the next one is collected
+    if (frame_pool_init(2 * BURST_ALBUM_FRAMES, CONFIG_JPEG_SLOT_SIZE_KB * 1024,
+                        CONFIG_BURST_PRE_FRAMES + 1) != ESP_OK) return;
+#else
+    if (frame_pool_init(CONFIG_JPEG_POOL_SLOTS, CONFIG_JPEG_SLOT_SIZE_KB * 1024, 0) != ESP_OK) return;
+#endif
+    
     // Tasks
     s_detection_queue = xQueueCreate(5, sizeof(detection_event_t));
     
     xTaskCreatePinnedToCore(telegram_notification_task, "telegram_task", 6 * 1024, NULL, 5, NULL, 0);
-    xTaskCreatePinnedToCore(detection_task, "detection_task", 8 * 1024, NULL, 10, &s_detection_task_handle, 1);
+    scheduler_setup();
+    events_setup();
+#if CONFIG_ENABLE_MOTION_DETECTION
+#if CONFIG_MOTION_ENGINE_VARIANCE
+    motion_detector_set_engine(MOTION_ENGINE_VARIANCE);
+#endif
+    zone_store_restore();
+#endif
+    if (pipeline_start() != ESP_OK) return;
+    
+#if CONFIG_TELEGRAM_COMMANDS_ENABLE
+    telegram_bot_start_polling(CONFIG_TELEGRAM_POLL_TIMEOUT_SEC, handle_command, NULL);
+#endif
     
     ESP_LOGI(TAG, "System running...");
 }
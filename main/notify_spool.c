@@ -0,0 +1,593 @@
+/**
+ * @file notify_spool.c
+ * @brief Persistent spool of notifications that could not be sent
+ *
+ * The spool is a sequence of numbered segment files. Records are only ever
+ * appended to the newest segment and segments are only ever deleted whole,
+ * once every record in them has been replayed (or when the oldest one has
+ * to make room). Nothing is rewritten in place, which keeps SPIFFS from
+ * relocating pages and spreads the writes over the whole partition.
+ *
+ * Record layout, all little-endian:
+ *
+ *   spool_header_t | caption | uint32 photo lengths[photo_count] | photos
+ *
+ * The CRC covers the header up to the crc field and the whole payload.
+ */
+
+#include "notify_spool.h"
+#include "frame_pool.h"
+#include "esp_log.h"
+#include "esp_spiffs.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <dirent.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *TAG = "notify_spool";
+
+#define SPOOL_BASE_PATH "/spool"
+#define SPOOL_PARTITION "storage"
+#define SPOOL_NVS_NAMESPACE "spool"
+#define SPOOL_NVS_KEY "cursor"
+
+#define SPOOL_MAGIC 0x314C5053u     // "SPL1"
+#define SPOOL_VERSION 1
+
+// A segment is closed once it holds this much; a record never spans two
+#define SPOOL_SEGMENT_BYTES (64 * 1024)
+
+// SPIFFS slows down badly when nearly full; never plan to use more than this
+#define SPOOL_FILL_PERCENT 75
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t payload_len;
+    uint16_t caption_len;
+    uint8_t photo_count;
+    uint8_t version;
+    uint32_t crc;
+} spool_header_t;
+
+// Read position, persisted in NVS so replay resumes after a reboot
+typedef struct {
+    uint32_t seg;
+    uint32_t off;
+} spool_cursor_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static size_t s_max_bytes = 0;
+static spool_cursor_t s_cursor;     // Next record to replay; its segment is the oldest one kept
+static uint32_t s_write_seg = 0;    // Segment new records are appended to
+static uint32_t s_write_off = 0;    // Its size
+static uint32_t s_next_seq = 0;
+static uint32_t s_generation = 0;   // Bumped when the cursor jumps, so a replay in flight does not advance it
+static notify_spool_stats_t s_stats;
+static char s_caption[NOTIFY_SPOOL_MAX_CAPTION];
+static uint32_t s_failed_seq = 0;   // Record whose delivery keeps failing ...
+static uint32_t s_failures = 0;     // ... and how many times in a row
+
+static void segment_path(uint32_t seg, char *path, size_t len)
+{
+    snprintf(path, len, SPOOL_BASE_PATH "/%08lx.seg", (unsigned long)seg);
+}
+
+static uint32_t segment_size(uint32_t seg)
+{
+    char path[32];
+    struct stat st;
+
+    segment_path(seg, path, sizeof(path));
+    return stat(path, &st) == 0 ? (uint32_t)st.st_size : 0;
+}
+
+static void segment_delete(uint32_t seg)
+{
+    char path[32];
+    uint32_t size = segment_size(seg);
+
+    segment_path(seg, path, sizeof(path));
+    unlink(path);
+    s_stats.bytes -= size < s_stats.bytes ? size : s_stats.bytes;
+}
+
+static uint32_t header_crc(const spool_header_t *h)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(spool_header_t, crc));
+}
+
+static bool header_valid(const spool_header_t *h, uint32_t off, uint32_t size)
+{
+    return h->magic == SPOOL_MAGIC && h->version == SPOOL_VERSION &&
+           h->caption_len < NOTIFY_SPOOL_MAX_CAPTION && h->photo_count <= FRAME_ALBUM_MAX &&
+           h->payload_len >= h->caption_len + h->photo_count * sizeof(uint32_t) &&
+           off + sizeof(*h) <= size && h->payload_len <= size - off - sizeof(*h);
+}
+
+static void save_cursor(void)
+{
+    nvs_handle_t handle;
+
+    esp_err_t ret = nvs_open(SPOOL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, SPOOL_NVS_KEY, &s_cursor, sizeof(s_cursor));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save spool position: %s", esp_err_to_name(ret));
+    }
+}
+
+static void load_cursor(void)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(s_cursor);
+
+    memset(&s_cursor, 0, sizeof(s_cursor));
+    if (nvs_open(SPOOL_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        if (nvs_get_blob(handle, SPOOL_NVS_KEY, &s_cursor, &len) != ESP_OK || len != sizeof(s_cursor)) {
+            memset(&s_cursor, 0, sizeof(s_cursor));
+        }
+        nvs_close(handle);
+    }
+}
+
+/**
+ * @brief Walk the record headers of a segment
+ * @param seg Segment
+ * @param off Offset to start at
+ * @param end Output: offset after the last complete record
+ * @param last_seq Output: sequence number of the last complete record (may be NULL)
+ * @return Number of complete records
+ */
+static uint32_t scan_segment(uint32_t seg, uint32_t off, uint32_t *end, uint32_t *last_seq)
+{
+    char path[32];
+    spool_header_t h;
+    uint32_t count = 0;
+    uint32_t size = segment_size(seg);
+
+    *end = off;
+    segment_path(seg, path, sizeof(path));
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    while (fseek(f, off, SEEK_SET) == 0 && fread(&h, sizeof(h), 1, f) == 1 &&
+           header_valid(&h, off, size)) {
+        off += sizeof(h) + h.payload_len;
+        *end = off;
+        if (last_seq) {
+            *last_seq = h.seq;
+        }
+        count++;
+    }
+
+    fclose(f);
+    return count;
+}
+
+/**
+ * @brief Start a new segment for appends
+ *
+ * Also used after an append failed part way, so that nothing is ever
+ * appended behind a torn record.
+ */
+static void rotate_segment(void)
+{
+    s_write_seg++;
+    s_write_off = 0;
+}
+
+/**
+ * @brief Drop the oldest segment and every record left in it
+ * @return false if only the write segment is left
+ */
+static bool drop_oldest_segment(void)
+{
+    if (s_cursor.seg == s_write_seg) {
+        if (s_write_off == 0) {
+            return false;
+        }
+        rotate_segment();
+    }
+
+    uint32_t end;
+    uint32_t lost = scan_segment(s_cursor.seg, s_cursor.off, &end, NULL);
+    segment_delete(s_cursor.seg);
+
+    lost = lost < s_stats.pending ? lost : s_stats.pending;
+    s_stats.pending -= lost;
+    s_stats.dropped += lost;
+    ESP_LOGW(TAG, "Spool full, dropped %lu oldest notification(s)", (unsigned long)lost);
+
+    s_cursor.seg++;
+    s_cursor.off = 0;
+    s_generation++;
+    save_cursor();
+    return true;
+}
+
+/**
+ * @brief Move the cursor past segments that hold nothing more to replay
+ *
+ * Consumed segments are deleted; when everything has been replayed, the
+ * write segment is retired too so that its space is reclaimed at once.
+ */
+static void advance_cursor(void)
+{
+    // With nothing left to replay, whatever is still on disk is consumed or torn
+    const bool drained = s_stats.pending == 0;
+    bool moved = false;
+
+    while (s_cursor.seg < s_write_seg && (drained || s_cursor.off >= segment_size(s_cursor.seg))) {
+        segment_delete(s_cursor.seg);
+        s_cursor.seg++;
+        s_cursor.off = 0;
+        moved = true;
+    }
+    if (s_cursor.seg == s_write_seg && s_write_off > 0 && (drained || s_cursor.off >= s_write_off)) {
+        segment_delete(s_write_seg);
+        rotate_segment();
+        s_cursor.seg = s_write_seg;
+        s_cursor.off = 0;
+        s_stats.pending = 0;
+        moved = true;
+    }
+    if (moved) {
+        s_generation++;
+    }
+}
+
+esp_err_t notify_spool_init(size_t max_bytes)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = SPOOL_BASE_PATH,
+        .partition_label = SPOOL_PARTITION,
+        .max_files = 2,
+        .format_if_mount_failed = true,
+    };
+
+    esp_err_t ret = esp_vfs_spiffs_register(&conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount %s partition: %s", SPOOL_PARTITION, esp_err_to_name(ret));
+        return ret;
+    }
+
+    size_t total = 0, used = 0;
+    if (esp_spiffs_info(SPOOL_PARTITION, &total, &used) == ESP_OK &&
+        max_bytes > total / 100 * SPOOL_FILL_PERCENT) {
+        max_bytes = total / 100 * SPOOL_FILL_PERCENT;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        esp_vfs_spiffs_unregister(SPOOL_PARTITION);
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_max_bytes = max_bytes;
+    load_cursor();
+
+    // Find the oldest and newest segments and delete any that were fully replayed
+    uint32_t oldest = UINT32_MAX;
+    uint32_t newest = s_cursor.seg;
+    DIR *dir = opendir(SPOOL_BASE_PATH);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            unsigned long seg;
+            int n = 0;
+            char path[32];
+            if (sscanf(entry->d_name, "%8lx%n", &seg, &n) != 1 || strcmp(entry->d_name + n, ".seg") != 0) {
+                continue;
+            }
+            if (seg < s_cursor.seg) {
+                segment_path(seg, path, sizeof(path));
+                unlink(path);
+            } else {
+                s_stats.bytes += segment_size(seg);
+                oldest = seg < oldest ? seg : oldest;
+                newest = seg > newest ? seg : newest;
+            }
+        }
+        closedir(dir);
+    }
+    if (oldest != UINT32_MAX && oldest > s_cursor.seg) {
+        s_cursor.seg = oldest;
+        s_cursor.off = 0;
+    }
+
+    // Count what is left to replay; appends continue in the newest segment
+    uint32_t end = 0;
+    for (uint32_t seg = s_cursor.seg; seg <= newest; seg++) {
+        uint32_t size = segment_size(seg);
+        s_stats.pending += scan_segment(seg, seg == s_cursor.seg ? s_cursor.off : 0, &end, &s_next_seq);
+        if (seg == newest) {
+            s_write_seg = seg;
+            s_write_off = size;
+            if (end < size) {
+                ESP_LOGW(TAG, "Segment %lu ends in a torn record, starting a new one",
+                         (unsigned long)seg);
+                rotate_segment();
+            }
+        }
+    }
+    s_next_seq++;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    advance_cursor();
+    xSemaphoreGive(s_lock);
+    save_cursor();
+
+    ESP_LOGI(TAG, "Spool ready: %lu notification(s) pending, %lu of %u KB used",
+             (unsigned long)s_stats.pending, (unsigned long)(s_stats.bytes / 1024),
+             (unsigned)(s_max_bytes / 1024));
+    return ESP_OK;
+}
+
+esp_err_t notify_spool_append(const char *caption, const telegram_photo_t *photos, int count)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count < 0 || count > FRAME_ALBUM_MAX || (count > 0 && !photos)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    spool_header_t h = {
+        .magic = SPOOL_MAGIC,
+        .version = SPOOL_VERSION,
+        .photo_count = (uint8_t)count,
+    };
+    uint32_t lens[FRAME_ALBUM_MAX];
+
+    caption = caption ? caption : "";
+    h.caption_len = (uint16_t)strnlen(caption, NOTIFY_SPOOL_MAX_CAPTION - 1);
+    h.payload_len = h.caption_len + count * sizeof(uint32_t);
+    for (int i = 0; i < count; i++) {
+        lens[i] = (uint32_t)photos[i].len;
+        h.payload_len += lens[i];
+    }
+
+    const uint32_t record_len = sizeof(h) + h.payload_len;
+    if (record_len > s_max_bytes) {
+        ESP_LOGE(TAG, "Notification of %lu bytes exceeds the spool", (unsigned long)record_len);
+        s_stats.dropped++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    while (s_stats.bytes + record_len > s_max_bytes && drop_oldest_segment()) {
+    }
+    if (s_write_off >= SPOOL_SEGMENT_BYTES) {
+        rotate_segment();
+    }
+
+    h.seq = s_next_seq++;
+    h.crc = header_crc(&h);
+    h.crc = esp_rom_crc32_le(h.crc, (const uint8_t *)caption, h.caption_len);
+    h.crc = esp_rom_crc32_le(h.crc, (const uint8_t *)lens, count * sizeof(uint32_t));
+    for (int i = 0; i < count; i++) {
+        h.crc = esp_rom_crc32_le(h.crc, photos[i].data, lens[i]);
+    }
+
+    char path[32];
+    segment_path(s_write_seg, path, sizeof(path));
+    FILE *f = fopen(path, "ab");
+    bool ok = f != NULL;
+    if (ok) {
+        ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(caption, 1, h.caption_len, f) == h.caption_len &&
+             fwrite(lens, sizeof(uint32_t), count, f) == (size_t)count;
+        for (int i = 0; ok && i < count; i++) {
+            ok = fwrite(photos[i].data, 1, lens[i], f) == lens[i];
+        }
+        ok = (fclose(f) == 0) && ok;
+    }
+
+    esp_err_t ret = ESP_OK;
+    uint32_t size = segment_size(s_write_seg);
+    s_stats.bytes += size - s_write_off;
+    if (ok && size == s_write_off + record_len) {
+        s_write_off = size;
+        s_stats.pending++;
+        s_stats.spooled++;
+        ESP_LOGI(TAG, "Spooled notification #%lu (%d photo(s), %lu bytes), %lu pending",
+                 (unsigned long)h.seq, count, (unsigned long)record_len,
+                 (unsigned long)s_stats.pending);
+    } else {
+        ESP_LOGE(TAG, "Failed to write notification to spool");
+        s_stats.dropped++;
+        if (size != s_write_off) {
+            rotate_segment();
+        }
+        ret = ESP_FAIL;
+    }
+
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+bool notify_spool_pending(void)
+{
+    return s_lock && s_stats.pending > 0;
+}
+
+/**
+ * @brief Read the record at the cursor into pool slots
+ * @return ESP_OK, ESP_ERR_NOT_FOUND at the end of a segment, ESP_ERR_NO_MEM
+ *         while too few slots are free, ESP_ERR_INVALID_SIZE for a record with
+ *         more photos than the pool has slots (spooled before the pool was
+ *         made smaller), or ESP_ERR_INVALID_CRC for a damaged record
+ */
+static esp_err_t read_record(FILE *f, uint32_t size, spool_header_t *h, frame_album_t *album)
+{
+    uint32_t lens[FRAME_ALBUM_MAX];
+
+    if (fseek(f, s_cursor.off, SEEK_SET) != 0 || fread(h, sizeof(*h), 1, f) != 1 ||
+        !header_valid(h, s_cursor.off, size)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (h->photo_count > frame_pool_slot_count()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (frame_pool_free_count() < h->photo_count) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t crc = header_crc(h);
+    bool ok = fread(s_caption, 1, h->caption_len, f) == h->caption_len &&
+              fread(lens, sizeof(uint32_t), h->photo_count, f) == h->photo_count;
+    s_caption[ok ? h->caption_len : 0] = '\0';
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)s_caption, h->caption_len);
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)lens, h->photo_count * sizeof(uint32_t));
+
+    album->count = 0;
+    for (int i = 0; ok && i < h->photo_count; i++) {
+        frame_slot_t *slot = frame_pool_acquire();
+        if (!slot) {
+            frame_album_release(album);
+            return ESP_ERR_NO_MEM;
+        }
+        album->slots[album->count++] = slot;
+        ok = lens[i] <= slot->capacity && fread(slot->buf, 1, lens[i], f) == lens[i];
+        if (ok) {
+            slot->len = lens[i];
+            crc = esp_rom_crc32_le(crc, slot->buf, lens[i]);
+        }
+    }
+
+    if (!ok || crc != h->crc) {
+        frame_album_release(album);
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+esp_err_t notify_spool_replay_one(notify_spool_send_fn send)
+{
+    telegram_photo_t photos[FRAME_ALBUM_MAX];
+    frame_album_t album = { 0 };
+    spool_header_t h;
+    esp_err_t ret;
+
+    if (!s_lock || !send) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    while (1) {
+        advance_cursor();
+        if (s_stats.pending == 0) {
+            ret = ESP_ERR_NOT_FOUND;
+            break;
+        }
+
+        char path[32];
+        uint32_t size = s_cursor.seg == s_write_seg ? s_write_off : segment_size(s_cursor.seg);
+        segment_path(s_cursor.seg, path, sizeof(path));
+        FILE *f = fopen(path, "rb");
+        ret = f ? read_record(f, size, &h, &album) : ESP_ERR_NOT_FOUND;
+        if (f) {
+            fclose(f);
+        }
+
+        if (ret == ESP_ERR_NOT_FOUND) {
+            // Nothing readable left in this segment
+            ESP_LOGW(TAG, "Skipping unreadable end of segment %lu", (unsigned long)s_cursor.seg);
+            s_cursor.off = size;
+            if (s_cursor.seg == s_write_seg) {
+                s_stats.pending = 0;
+            }
+            save_cursor();
+            continue;
+        }
+        if (ret == ESP_ERR_INVALID_CRC || ret == ESP_ERR_INVALID_SIZE) {
+            // Neither will ever read back, and waiting would hold up the rest
+            if (ret == ESP_ERR_INVALID_SIZE) {
+                ESP_LOGE(TAG, "Dropping notification #%lu: %u photos, but only %d JPEG slots",
+                         (unsigned long)h.seq, h.photo_count, frame_pool_slot_count());
+            } else {
+                ESP_LOGW(TAG, "Dropping unreadable notification #%lu", (unsigned long)h.seq);
+            }
+            s_cursor.off += sizeof(h) + h.payload_len;
+            s_stats.pending--;
+            s_stats.dropped++;
+            save_cursor();
+            continue;
+        }
+        break;
+    }
+
+    const uint32_t generation = s_generation;
+    const uint32_t next_off = s_cursor.off + sizeof(h) + h.payload_len;
+    xSemaphoreGive(s_lock);
+
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Send without the lock, so that appends are not held up by the network
+    for (int i = 0; i < album.count; i++) {
+        photos[i].data = album.slots[i]->buf;
+        photos[i].len = album.slots[i]->len;
+    }
+    ret = send(s_caption, photos, album.count);
+    frame_album_release(&album);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (generation == s_generation) {
+        if (ret == ESP_OK) {
+            s_stats.replayed++;
+            ESP_LOGI(TAG, "Replayed notification #%lu, %lu pending",
+                     (unsigned long)h.seq, (unsigned long)(s_stats.pending - 1));
+        } else if (ret == ESP_ERR_INVALID_RESPONSE) {
+            s_failures = NOTIFY_SPOOL_MAX_ATTEMPTS;
+        } else if (ret != ESP_ERR_NOT_FINISHED) {
+            s_failures = h.seq == s_failed_seq ? s_failures + 1 : 1;
+            s_failed_seq = h.seq;
+        }
+        // A record that is never accepted must not hold up the rest
+        if (ret == ESP_OK || s_failures >= NOTIFY_SPOOL_MAX_ATTEMPTS) {
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Giving up on notification #%lu: %s",
+                         (unsigned long)h.seq, esp_err_to_name(ret));
+                s_stats.dropped++;
+                s_failures = 0;
+            }
+            s_cursor.off = next_off;
+            s_stats.pending--;
+            advance_cursor();
+            save_cursor();
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    return ret;
+}
+
+void notify_spool_get_stats(notify_spool_stats_t *stats)
+{
+    if (s_lock) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+    *stats = s_stats;
+    if (s_lock) {
+        xSemaphoreGive(s_lock);
+    }
+}
@@ -4,17 +4,20 @@
  */
 
 #include "telegram_bot.h"
+#include "telegram_updates.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
-#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "cJSON.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
-#include <sys/time.h>
 
 static const char *TAG = "telegram_bot";
 
@@ -22,11 +25,63 @@ static const char *TAG = "telegram_bot";
 #define MAX_HTTP_OUTPUT_BUFFER 2048
 #define HTTP_TIMEOUT_MS 30000
 
+// Backoff after retryable failures: doubles per failure, with equal jitter
+#define RETRY_BACKOFF_BASE_MS 1000
+#define RETRY_BACKOFF_MAX_MS 60000
+#define RETRY_AFTER_DEFAULT_S 5
+
+// sendMediaGroup limits and the sizes of its text parts
+#define TELEGRAM_MEDIA_GROUP_MAX 10
+#define MEDIA_CAPTION_ESCAPED_SIZE 512
+#define MESSAGE_BODY_SIZE 768
+#define MEDIA_PREAMBLE_SIZE 1280
+#define MEDIA_PHOTO_HEADER_SIZE 160
+#define MEDIA_GROUP_SCRATCH_SIZE (MEDIA_CAPTION_ESCAPED_SIZE + MEDIA_PREAMBLE_SIZE + \
+                                  TELEGRAM_MEDIA_GROUP_MAX * MEDIA_PHOTO_HEADER_SIZE)
+
 static char s_bot_token[64] = {0};
 static char s_chat_id[32] = {0};
-static time_t s_last_notification_time = 0;
 static bool s_initialized = false;
 
+// One long-lived client keeps the TCP/TLS connection to the API open between
+// requests; the lock serialises the tasks that share it
+static esp_http_client_handle_t s_client = NULL;
+static SemaphoreHandle_t s_client_lock = NULL;
+static bool s_connected = false;
+static bool s_server_closing = false;
+static uint32_t s_connect_count = 0;
+
+// Error body of the last failed request, read while holding the client lock
+static char s_response[MAX_HTTP_OUTPUT_BUFFER];
+
+// Retry scheduling, in esp_timer milliseconds (wrapping, compared as differences)
+static volatile uint32_t s_rate_limited_until_ms = 0;
+static volatile uint32_t s_backoff_until_ms = 0;
+static uint32_t s_failures = 0;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+} http_part_t;
+
+// Command polling
+#define POLL_READ_CHUNK 256
+#define POLL_TASK_STACK (8 * 1024)      // Handlers send replies, which may need a TLS handshake
+#define POLL_TASK_PRIORITY 2
+#define POLL_BACKOFF_BASE_MS 2000
+#define POLL_BACKOFF_MAX_MS 30000
+#define POLL_CONFLICT_WAIT_MS 30000
+#define POLL_REJECTED_WAIT_MS (10 * 60 * 1000)
+
+static TaskHandle_t s_poll_task = NULL;
+static volatile bool s_poll_stop = false;
+static SemaphoreHandle_t s_poll_wake = NULL;    // Given to cut a backoff wait short
+static SemaphoreHandle_t s_poll_exited = NULL;  // Given by the poll task as it exits
+static int s_poll_timeout_s = 0;
+static telegram_command_handler_t s_poll_handler = NULL;
+static void *s_poll_ctx = NULL;
+static telegram_updates_t s_updates;
+
 // Root CA certificate for Telegram API (api.telegram.org)
 // This is the ISRG Root X1 certificate used by Let's Encrypt
 extern const uint8_t telegram_root_cert_pem_start[] asm("_binary_telegram_root_cert_pem_start");
@@ -39,13 +94,19 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
             break;
         case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+            s_connected = true;
+            s_connect_count++;
+            ESP_LOGI(TAG, "Connected to %s (connection #%lu)", TELEGRAM_API_HOST, s_connect_count);
             break;
         case HTTP_EVENT_HEADER_SENT:
             ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER: %s: %s", evt->header_key, evt->header_value);
+            if (strcasecmp(evt->header_key, "Connection") == 0 &&
+                strcasecmp(evt->header_value, "close") == 0) {
+                s_server_closing = true;
+            }
             break;
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
@@ -55,6 +116,7 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_DISCONNECTED:
             ESP_LOGD(TAG, "HTTP_EVENT_DISCONNECTED");
+            s_connected = false;
             break;
         case HTTP_EVENT_REDIRECT:
             ESP_LOGD(TAG, "HTTP_EVENT_REDIRECT");
@@ -63,6 +125,200 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+/**
+ * @brief Write a buffer to an open request, looping over partial writes
+ */
+static esp_err_t http_write_all(esp_http_client_handle_t client, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        int written = esp_http_client_write(client, (const char *)data, len);
+        if (written <= 0) {
+            return ESP_FAIL;
+        }
+        data += written;
+        len -= written;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Send one POST over the shared client and read the response status
+ * @param response_started Output: true once response headers have been read
+ */
+static esp_err_t telegram_post_once(const http_part_t *parts, size_t part_count,
+                                    size_t total_len, int *status, bool *response_started)
+{
+    *response_started = false;
+    s_server_closing = false;
+    
+    esp_err_t err = esp_http_client_open(s_client, total_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    for (size_t i = 0; i < part_count; i++) {
+        if (http_write_all(s_client, parts[i].data, parts[i].len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    
+    if (esp_http_client_fetch_headers(s_client) < 0) {
+        return ESP_FAIL;
+    }
+    *response_started = true;
+    
+    *status = esp_http_client_get_status_code(s_client);
+    s_response[0] = '\0';
+    if (*status != 200) {
+        // Keep the error description; it says whether a retry can succeed
+        int len = esp_http_client_read_response(s_client, s_response, sizeof(s_response) - 1);
+        s_response[len > 0 ? len : 0] = '\0';
+    }
+    // Drain the body so the connection is ready for the next request
+    esp_http_client_flush_response(s_client, NULL);
+    return ESP_OK;
+}
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static uint32_t remaining_ms(uint32_t until_ms)
+{
+    int32_t left = (int32_t)(until_ms - now_ms());
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+/**
+ * @brief Classify a Bot API error response
+ *
+ * Telegram answers errors with {"ok":false,"error_code":N,"description":...},
+ * adding "parameters":{"retry_after":S} when the bot is being rate limited.
+ *
+ * @return ESP_ERR_NOT_FINISHED when rate limited, ESP_FAIL for a server-side
+ *         failure worth retrying, ESP_ERR_INVALID_RESPONSE when the request
+ *         itself was rejected and would fail again
+ */
+static esp_err_t classify_error(const char *method, int status)
+{
+    int code = status;
+    int retry_after = 0;
+    const char *description = "no description";
+    
+    cJSON *root = cJSON_Parse(s_response);
+    if (root) {
+        cJSON *item = cJSON_GetObjectItem(root, "error_code");
+        if (cJSON_IsNumber(item)) {
+            code = item->valueint;
+        }
+        item = cJSON_GetObjectItem(root, "description");
+        if (cJSON_IsString(item)) {
+            description = item->valuestring;
+        }
+        cJSON *params = cJSON_GetObjectItem(root, "parameters");
+        item = params ? cJSON_GetObjectItem(params, "retry_after") : NULL;
+        if (cJSON_IsNumber(item)) {
+            retry_after = item->valueint;
+        }
+    }
+    
+    esp_err_t err;
+    if (code == 429) {
+        retry_after = retry_after > 0 ? retry_after : RETRY_AFTER_DEFAULT_S;
+        s_rate_limited_until_ms = now_ms() + (uint32_t)retry_after * 1000;
+        ESP_LOGW(TAG, "%s rate limited, holding all requests for %d s", method, retry_after);
+        err = ESP_ERR_NOT_FINISHED;
+    } else if (code >= 500 || code == 408) {
+        ESP_LOGW(TAG, "%s failed with %d (%s), will retry", method, code, description);
+        err = ESP_FAIL;
+    } else {
+        ESP_LOGE(TAG, "%s rejected with %d: %s", method, code, description);
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    
+    cJSON_Delete(root);
+    return err;
+}
+
+/**
+ * @brief Update the backoff after a request
+ */
+static void schedule_retry(esp_err_t err)
+{
+    if (err == ESP_OK || err == ESP_ERR_INVALID_RESPONSE) {
+        // The API answered; nothing to back off from
+        s_failures = 0;
+        s_backoff_until_ms = now_ms();
+        return;
+    }
+    
+    uint32_t delay = RETRY_BACKOFF_BASE_MS << (s_failures < 6 ? s_failures : 6);
+    delay = delay < RETRY_BACKOFF_MAX_MS ? delay : RETRY_BACKOFF_MAX_MS;
+    // Equal jitter: half fixed, half random, so retries from a burst spread out
+    delay = delay / 2 + esp_random() % (delay / 2 + 1);
+    s_failures++;
+    s_backoff_until_ms = now_ms() + delay;
+    ESP_LOGD(TAG, "Retry %lu not before %lu ms", (unsigned long)s_failures, (unsigned long)delay);
+}
+
+/**
+ * @brief POST a body made of several parts to a Bot API method
+ *
+ * The request goes over the kept-alive connection when there is one. If that
+ * connection turns out to be dead before any response arrives (the server
+ * drops idle connections), it is reopened and the request is sent once more;
+ * the new handshake resumes the previous TLS session when tickets are enabled.
+ */
+static esp_err_t telegram_post(const char *method, const char *content_type,
+                               const http_part_t *parts, size_t part_count, int *status)
+{
+    // A rate limit applies to the whole bot, so nothing is sent until it ends
+    if (remaining_ms(s_rate_limited_until_ms) > 0) {
+        ESP_LOGW(TAG, "%s deferred, rate limited for %lu ms", method,
+                 (unsigned long)remaining_ms(s_rate_limited_until_ms));
+        return ESP_ERR_NOT_FINISHED;
+    }
+    
+    char url[256];
+    snprintf(url, sizeof(url), "https://%s/bot%s/%s",
+             TELEGRAM_API_HOST, s_bot_token, method);
+    
+    size_t total_len = 0;
+    for (size_t i = 0; i < part_count; i++) {
+        total_len += parts[i].len;
+    }
+    
+    xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    
+    esp_http_client_set_url(s_client, url);
+    esp_http_client_set_method(s_client, HTTP_METHOD_POST);
+    esp_http_client_set_header(s_client, "Content-Type", content_type);
+    
+    bool reused = s_connected;
+    bool response_started = false;
+    esp_err_t err = telegram_post_once(parts, part_count, total_len, status, &response_started);
+    if (err != ESP_OK && reused && !response_started) {
+        ESP_LOGW(TAG, "Kept-alive connection lost (%s), reconnecting", esp_err_to_name(err));
+        esp_http_client_close(s_client);
+        err = telegram_post_once(parts, part_count, total_len, status, &response_started);
+    }
+    
+    if (err != ESP_OK || s_server_closing) {
+        esp_http_client_close(s_client);
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s request failed: %s", method, esp_err_to_name(err));
+    } else if (*status != 200) {
+        err = classify_error(method, *status);
+    }
+    schedule_retry(err);
+    
+    xSemaphoreGive(s_client_lock);
+    return err;
+}
+
 esp_err_t telegram_bot_init(const char *bot_token, const char *chat_id)
 {
     if (!bot_token || !chat_id) {
@@ -73,12 +329,78 @@ esp_err_t telegram_bot_init(const char *bot_token, const char *chat_id)
     strncpy(s_bot_token, bot_token, sizeof(s_bot_token) - 1);
     strncpy(s_chat_id, chat_id, sizeof(s_chat_id) - 1);
     
+    if (!s_client_lock) {
+        s_client_lock = xSemaphoreCreateMutex();
+        if (!s_client_lock) {
+            ESP_LOGE(TAG, "Failed to create client lock");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    if (!s_client) {
+        esp_http_client_config_t config = {
+            .url = "https://" TELEGRAM_API_HOST "/",
+            .event_handler = http_event_handler,
+            .timeout_ms = HTTP_TIMEOUT_MS,
+            .crt_bundle_attach = esp_crt_bundle_attach,
+            .keep_alive_enable = true,
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+            .save_client_session = true,
+#endif
+        };
+        
+        s_client = esp_http_client_init(&config);
+        if (!s_client) {
+            ESP_LOGE(TAG, "Failed to initialize HTTP client");
+            return ESP_FAIL;
+        }
+    }
+    
     s_initialized = true;
     ESP_LOGI(TAG, "Telegram bot initialized");
     
     return ESP_OK;
 }
 
+/**
+ * @brief Copy a string into a JSON string literal body, escaping as needed
+ *
+ * Output is truncated on an escape boundary and always NUL-terminated.
+ */
+static void json_escape(char *dst, size_t dst_size, const char *src)
+{
+    size_t pos = 0;
+
+    for (; *src; src++) {
+        char esc[7];
+        unsigned char c = (unsigned char)*src;
+
+        switch (c) {
+            case '"':  strcpy(esc, "\\\""); break;
+            case '\\': strcpy(esc, "\\\\"); break;
+            case '\n': strcpy(esc, "\\n"); break;
+            case '\r': strcpy(esc, "\\r"); break;
+            case '\t': strcpy(esc, "\\t"); break;
+            default:
+                if (c < 0x20) {
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                } else {
+                    esc[0] = (char)c;
+                    esc[1] = '\0';
+                }
+                break;
+        }
+
+        size_t esc_len = strlen(esc);
+        if (pos + esc_len >= dst_size) {
+            break;
+        }
+        memcpy(dst + pos, esc, esc_len);
+        pos += esc_len;
+    }
+    dst[pos] = '\0';
+}
+
 esp_err_t telegram_bot_send_message(const char *message)
 {
     if (!s_initialized) {
@@ -92,49 +414,24 @@ esp_err_t telegram_bot_send_message(const char *message)
     
     ESP_LOGI(TAG, "Sending message to Telegram...");
     
-    // Build URL
-    char url[256];
-    snprintf(url, sizeof(url), "https://%s/bot%s/sendMessage",
-             TELEGRAM_API_HOST, s_bot_token);
-    
-    // Build JSON body
-    char body[512];
-    snprintf(body, sizeof(body), 
-             "{\"chat_id\":\"%s\",\"text\":\"%s\",\"parse_mode\":\"HTML\"}",
-             s_chat_id, message);
+    // Build JSON body; the text may hold newlines and quotes
+    static const char suffix[] = "\",\"parse_mode\":\"HTML\"}";
+    char body[MESSAGE_BODY_SIZE];
+    int pos = snprintf(body, sizeof(body), "{\"chat_id\":\"%s\",\"text\":\"", s_chat_id);
+    json_escape(body + pos, sizeof(body) - pos - (sizeof(suffix) - 1), message);
+    strcat(body, suffix);
     
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .timeout_ms = HTTP_TIMEOUT_MS,
-        .crt_bundle_attach = esp_crt_bundle_attach,
+    const http_part_t parts[] = {
+        { (const uint8_t *)body, strlen(body) },
     };
     
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
-    }
-    
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, body, strlen(body));
-    
-    esp_err_t err = esp_http_client_perform(client);
+    int status = 0;
+    esp_err_t err = telegram_post("sendMessage", "application/json", parts, 1, &status);
     
     if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
         ESP_LOGI(TAG, "Message sent, HTTP status = %d", status);
-        
-        if (status != 200) {
-            ESP_LOGW(TAG, "Telegram API returned non-200 status");
-            err = ESP_FAIL;
-        }
-    } else {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
     }
     
-    esp_http_client_cleanup(client);
     return err;
 }
 
@@ -151,16 +448,10 @@ esp_err_t telegram_bot_send_photo(const uint8_t *photo_data, size_t photo_size,
     
     ESP_LOGI(TAG, "Sending photo to Telegram (%u bytes)...", photo_size);
     
-    // Build URL
-    char url[256];
-    snprintf(url, sizeof(url), "https://%s/bot%s/sendPhoto",
-             TELEGRAM_API_HOST, s_bot_token);
-    
     // Create multipart form data
     // Boundary for multipart
     const char *boundary = "----ESP32CamBoundary";
     
-    // Calculate total size
     char header_part[512];
     snprintf(header_part, sizeof(header_part),
              "--%s\r\n"
@@ -183,96 +474,348 @@ esp_err_t telegram_bot_send_photo(const uint8_t *photo_data, size_t photo_size,
     char footer_part[64];
     snprintf(footer_part, sizeof(footer_part), "\r\n--%s--\r\n", boundary);
     
-    size_t header_len = strlen(header_part);
-    size_t caption_len = strlen(caption_part);
-    size_t footer_len = strlen(footer_part);
-    size_t total_len = header_len + photo_size + caption_len + footer_len;
+    // Create content type header
+    char content_type[64];
+    snprintf(content_type, sizeof(content_type), "multipart/form-data; boundary=%s", boundary);
+    
+    // Stream the body part by part; the photo is written straight from the
+    // caller's buffer, so no copy of the JPEG is ever made
+    const http_part_t parts[] = {
+        { (const uint8_t *)header_part, strlen(header_part) },
+        { photo_data, photo_size },
+        { (const uint8_t *)caption_part, strlen(caption_part) },
+        { (const uint8_t *)footer_part, strlen(footer_part) },
+    };
+    
+    int status = 0;
+    esp_err_t err = telegram_post("sendPhoto", content_type, parts,
+                                  sizeof(parts) / sizeof(parts[0]), &status);
+    
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Photo sent, HTTP status = %d", status);
+    }
+    
+    return err;
+}
+
+esp_err_t telegram_bot_send_media_group(const telegram_photo_t *photos, size_t count, const char *caption)
+{
+    if (!s_initialized) {
+        ESP_LOGE(TAG, "Telegram bot not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (!photos || count == 0 || count > TELEGRAM_MEDIA_GROUP_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    // Allocate buffer for multipart data
-    uint8_t *body = heap_caps_malloc(total_len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!body) {
-        body = malloc(total_len);
+    // sendMediaGroup needs at least two items
+    if (count == 1) {
+        return telegram_bot_send_photo(photos[0].data, photos[0].len, caption);
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (!photos[i].data || photos[i].len == 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
     }
     
-    if (!body) {
-        ESP_LOGE(TAG, "Failed to allocate memory for HTTP body");
+    ESP_LOGI(TAG, "Sending album of %u photos to Telegram...", count);
+    
+    const char *boundary = "----ESP32CamBoundary";
+    
+    // Text parts only; the photos themselves are streamed from the caller
+    char *scratch = malloc(MEDIA_GROUP_SCRATCH_SIZE);
+    if (!scratch) {
+        ESP_LOGE(TAG, "Failed to allocate album headers");
         return ESP_ERR_NO_MEM;
     }
     
-    // Build body
-    size_t offset = 0;
-    memcpy(body + offset, header_part, header_len);
-    offset += header_len;
-    memcpy(body + offset, photo_data, photo_size);
-    offset += photo_size;
-    memcpy(body + offset, caption_part, caption_len);
-    offset += caption_len;
-    memcpy(body + offset, footer_part, footer_len);
+    char *escaped = scratch;
+    char *preamble = escaped + MEDIA_CAPTION_ESCAPED_SIZE;
+    char *photo_headers = preamble + MEDIA_PREAMBLE_SIZE;
+    
+    escaped[0] = '\0';
+    if (caption) {
+        json_escape(escaped, MEDIA_CAPTION_ESCAPED_SIZE, caption);
+    }
+    
+    // The caption goes on the first item, which Telegram shows for the album
+    int pos = snprintf(preamble, MEDIA_PREAMBLE_SIZE,
+                       "--%s\r\n"
+                       "Content-Disposition: form-data; name=\"chat_id\"\r\n\r\n"
+                       "%s\r\n"
+                       "--%s\r\n"
+                       "Content-Disposition: form-data; name=\"media\"\r\n\r\n"
+                       "[{\"type\":\"photo\",\"media\":\"attach://photo0\","
+                       "\"caption\":\"%s\",\"parse_mode\":\"HTML\"}",
+                       boundary, s_chat_id, boundary, escaped);
+    for (size_t i = 1; i < count && pos < MEDIA_PREAMBLE_SIZE; i++) {
+        pos += snprintf(preamble + pos, MEDIA_PREAMBLE_SIZE - pos,
+                        ",{\"type\":\"photo\",\"media\":\"attach://photo%u\"}", i);
+    }
+    if (pos < MEDIA_PREAMBLE_SIZE) {
+        pos += snprintf(preamble + pos, MEDIA_PREAMBLE_SIZE - pos, "]");
+    }
+    if (pos >= MEDIA_PREAMBLE_SIZE) {
+        ESP_LOGE(TAG, "Album preamble too long");
+        free(scratch);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    http_part_t parts[2 + 2 * TELEGRAM_MEDIA_GROUP_MAX];
+    size_t part_count = 0;
+    parts[part_count++] = (http_part_t){ (const uint8_t *)preamble, (size_t)pos };
+    
+    for (size_t i = 0; i < count; i++) {
+        char *header = photo_headers + i * MEDIA_PHOTO_HEADER_SIZE;
+        int len = snprintf(header, MEDIA_PHOTO_HEADER_SIZE,
+                           "\r\n--%s\r\n"
+                           "Content-Disposition: form-data; name=\"photo%u\"; filename=\"photo%u.jpg\"\r\n"
+                           "Content-Type: image/jpeg\r\n\r\n",
+                           boundary, i, i);
+        parts[part_count++] = (http_part_t){ (const uint8_t *)header, (size_t)len };
+        parts[part_count++] = (http_part_t){ photos[i].data, photos[i].len };
+    }
+    
+    char footer_part[64];
+    snprintf(footer_part, sizeof(footer_part), "\r\n--%s--\r\n", boundary);
+    parts[part_count++] = (http_part_t){ (const uint8_t *)footer_part, strlen(footer_part) };
     
-    // Create content type header
     char content_type[64];
     snprintf(content_type, sizeof(content_type), "multipart/form-data; boundary=%s", boundary);
     
+    int status = 0;
+    esp_err_t err = telegram_post("sendMediaGroup", content_type, parts, part_count, &status);
+    free(scratch);
+    
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Album sent, HTTP status = %d", status);
+    }
+    
+    return err;
+}
+
+/**
+ * @brief Split "/name@bot args" and pass it to the handler
+ */
+static void dispatch_command(char *text)
+{
+    char *name = text + 1;
+    char *args = name + strcspn(name, " \n");
+    
+    if (*args) {
+        *args++ = '\0';
+        args += strspn(args, " \n");
+    }
+    char *at = strchr(name, '@');
+    if (at) {
+        *at = '\0';
+    }
+    
+    ESP_LOGI(TAG, "Command /%s %s", name, args);
+    s_poll_handler(name, args, s_poll_ctx);
+}
+
+/**
+ * @brief Send one getUpdates long poll and parse the response as it arrives
+ *
+ * The offset is left alone here; the caller accepts the response with
+ * telegram_updates_finish() once the whole body has arrived.
+ *
+ * @param status Output: HTTP status, 0 if no response arrived
+ */
+static esp_err_t poll_once(esp_http_client_handle_t client, int *status)
+{
+    const long long offset = telegram_updates_request_offset(&s_updates);
+    
+    char url[256];
+    snprintf(url, sizeof(url),
+             "https://%s/bot%s/getUpdates?offset=%lld&limit=%d&timeout=%d"
+             "&allowed_updates=%%5B%%22message%%22%%5D",
+             TELEGRAM_API_HOST, s_bot_token, offset, TELEGRAM_UPDATES_LIMIT,
+             offset < 0 ? 0 : s_poll_timeout_s);
+    
+    telegram_updates_begin(&s_updates);
+    *status = 0;
+    
+    esp_http_client_set_url(client, url);
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (esp_http_client_fetch_headers(client) < 0) {
+        return ESP_FAIL;
+    }
+    *status = esp_http_client_get_status_code(client);
+    
+    // The body is never held whole: each chunk goes straight to the parser
+    char chunk[POLL_READ_CHUNK];
+    int len;
+    while ((len = esp_http_client_read(client, chunk, sizeof(chunk))) > 0) {
+        if (!telegram_updates_feed(&s_updates, chunk, len)) {
+            ESP_LOGW(TAG, "Malformed getUpdates response");
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    if (len < 0 || !esp_http_client_is_complete_data_received(client)) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief End the poll task, letting telegram_bot_deinit() know it is gone
+ */
+static void poll_task_exit(void)
+{
+    s_poll_task = NULL;
+    xSemaphoreGive(s_poll_exited);
+    vTaskDelete(NULL);
+}
+
+static void telegram_poll_task(void *arg)
+{
     esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .timeout_ms = HTTP_TIMEOUT_MS,
+        .url = "https://" TELEGRAM_API_HOST "/",
+        .timeout_ms = (s_poll_timeout_s + 10) * 1000,
         .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
     };
-    
     esp_http_client_handle_t client = esp_http_client_init(&config);
     if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        free(body);
-        return ESP_FAIL;
+        ESP_LOGE(TAG, "Failed to initialize polling client");
+        poll_task_exit();
+        return;
     }
+    esp_http_client_set_method(client, HTTP_METHOD_GET);
     
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", content_type);
-    esp_http_client_set_post_field(client, (const char *)body, total_len);
+    uint32_t failures = 0;
     
-    esp_err_t err = esp_http_client_perform(client);
+    ESP_LOGI(TAG, "Polling for commands (timeout %d s)", s_poll_timeout_s);
     
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Photo sent, HTTP status = %d", status);
+    while (!s_poll_stop) {
+        int status = 0;
+        esp_err_t err = poll_once(client, &status);
+        uint32_t wait_ms = 0;
         
-        if (status != 200) {
-            ESP_LOGW(TAG, "Telegram API returned non-200 status");
-            err = ESP_FAIL;
+        if (err == ESP_OK && status == 200 && telegram_updates_finish(&s_updates)) {
+            failures = 0;
+            for (int i = 0; i < s_updates.count && !s_poll_stop; i++) {
+                dispatch_command(s_updates.commands[i]);
+            }
         } else {
-            // Update last notification time
-            time(&s_last_notification_time);
+            // Whatever went wrong, start the next poll on a fresh connection
+            esp_http_client_close(client);
+            failures++;
+            
+            if (status == 401 || status == 404) {
+                ESP_LOGE(TAG, "getUpdates rejected with %d: %s", status, s_updates.description);
+                wait_ms = POLL_REJECTED_WAIT_MS;
+            } else if (status == 409) {
+                // A webhook is set or another client is polling this bot
+                ESP_LOGW(TAG, "getUpdates conflict: %s", s_updates.description);
+                wait_ms = POLL_CONFLICT_WAIT_MS;
+            } else if (status == 429) {
+                int retry_after = s_updates.retry_after > 0 ? s_updates.retry_after : RETRY_AFTER_DEFAULT_S;
+                wait_ms = (uint32_t)retry_after * 1000;
+            } else if (failures > 1) {
+                // The first failure retries at once: a kept-alive connection
+                // may simply have been dropped while idle
+                wait_ms = POLL_BACKOFF_BASE_MS << (failures < 6 ? failures - 2 : 4);
+                wait_ms = wait_ms < POLL_BACKOFF_MAX_MS ? wait_ms : POLL_BACKOFF_MAX_MS;
+            }
+            if (wait_ms > 0) {
+                ESP_LOGW(TAG, "getUpdates failed (%s, HTTP %d), next poll in %lu ms",
+                         esp_err_to_name(err), status, (unsigned long)wait_ms);
+            }
+        }
+        
+        if (wait_ms > 0) {
+            xSemaphoreTake(s_poll_wake, pdMS_TO_TICKS(wait_ms));
         }
-    } else {
-        ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
     }
     
     esp_http_client_cleanup(client);
-    free(body);
-    
-    return err;
+    poll_task_exit();
 }
 
-bool telegram_bot_can_send(int cooldown_sec)
+esp_err_t telegram_bot_start_polling(int poll_timeout_s, telegram_command_handler_t handler, void *ctx)
 {
-    time_t now;
-    time(&now);
-    
-    if (s_last_notification_time == 0) {
-        return true;
+    if (!s_initialized || s_poll_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!handler || poll_timeout_s < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_poll_wake) {
+        s_poll_wake = xSemaphoreCreateBinary();
+    }
+    if (!s_poll_exited) {
+        s_poll_exited = xSemaphoreCreateBinary();
+    }
+    if (!s_poll_wake || !s_poll_exited) {
+        ESP_LOGE(TAG, "Failed to create polling semaphores");
+        return ESP_ERR_NO_MEM;
+    }
+    // Left given if an earlier poll task exited without being waited for
+    xSemaphoreTake(s_poll_wake, 0);
+    xSemaphoreTake(s_poll_exited, 0);
+    
+    s_poll_timeout_s = poll_timeout_s;
+    s_poll_handler = handler;
+    s_poll_ctx = ctx;
+    s_poll_stop = false;
+    telegram_updates_init(&s_updates, s_chat_id);
+    
+    // Not pinned: it spends its life blocked on the socket
+    if (xTaskCreate(telegram_poll_task, "telegram_poll", POLL_TASK_STACK, NULL,
+                    POLL_TASK_PRIORITY, &s_poll_task) != pdPASS) {
+        s_poll_task = NULL;
+        ESP_LOGE(TAG, "Failed to create polling task");
+        return ESP_ERR_NO_MEM;
     }
     
-    return (now - s_last_notification_time) >= cooldown_sec;
+    return ESP_OK;
+}
+
+bool telegram_bot_is_retryable(esp_err_t err)
+{
+    return err != ESP_OK && err != ESP_ERR_INVALID_RESPONSE &&
+           err != ESP_ERR_INVALID_ARG && err != ESP_ERR_INVALID_SIZE;
 }
 
-void telegram_bot_reset_cooldown(void)
+uint32_t telegram_bot_retry_delay_ms(void)
 {
-    s_last_notification_time = 0;
+    uint32_t rate_limit = remaining_ms(s_rate_limited_until_ms);
+    uint32_t backoff = remaining_ms(s_backoff_until_ms);
+    return rate_limit > backoff ? rate_limit : backoff;
 }
 
 void telegram_bot_deinit(void)
 {
+    s_poll_stop = true;
+    
+    // Wait for the poll task before clearing what it uses. From a command
+    // handler, the poll task itself stops once the handler returns.
+    if (s_poll_task && s_poll_task != xTaskGetCurrentTaskHandle()) {
+        ESP_LOGI(TAG, "Waiting for the command poll to end");
+        xSemaphoreGive(s_poll_wake);
+        xSemaphoreTake(s_poll_exited, portMAX_DELAY);
+    }
+    
+    if (s_client_lock) {
+        xSemaphoreTake(s_client_lock, portMAX_DELAY);
+    }
+    if (s_client) {
+        esp_http_client_cleanup(s_client);
+        s_client = NULL;
+        s_connected = false;
+    }
+    if (s_client_lock) {
+        xSemaphoreGive(s_client_lock);
+    }
+    
     memset(s_bot_token, 0, sizeof(s_bot_token));
     memset(s_chat_id, 0, sizeof(s_chat_id));
     s_initialized = false;
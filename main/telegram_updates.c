@@ -0,0 +1,125 @@
+/**
+ * @file telegram_updates.c
+ * @brief getUpdates response parsing and offset bookkeeping for command polling
+ */
+
+#include "telegram_updates.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "telegram_updates";
+
+static void copy_field(char *dst, size_t dst_size, const char *src)
+{
+    strncpy(dst, src, dst_size - 1);
+    dst[dst_size - 1] = '\0';
+}
+
+/*
+ * getUpdates response, by depth:
+ *   1  {"ok":true,"description":...,"parameters":{"retry_after":N}}
+ *   2  "result":[
+ *   3    {"update_id":N,
+ *   4     "message":{"text":"/cmd args",
+ *   5                "chat":{"id":N}}}]
+ */
+static void on_value(void *ctx, const json_stream_t *js, const char *key,
+                     json_stream_type_t type, const char *value)
+{
+    telegram_updates_t *st = ctx;
+
+    if (js->depth == 1) {
+        if (strcmp(key, "ok") == 0) {
+            st->ok = strcmp(value, "true") == 0;
+        } else if (strcmp(key, "description") == 0) {
+            copy_field(st->description, sizeof(st->description), value);
+        }
+    } else if (js->depth == 2) {
+        if (strcmp(json_stream_container(js, 2), "parameters") == 0 &&
+            strcmp(key, "retry_after") == 0) {
+            st->retry_after = atoi(value);
+        }
+    } else if (strcmp(json_stream_container(js, 2), "result") == 0) {
+        if (js->depth == 3 && strcmp(key, "update_id") == 0) {
+            long long next = strtoll(value, NULL, 10) + 1;
+            st->next_offset = next > st->next_offset ? next : st->next_offset;
+        } else if (js->depth == 4 && type == JSON_STREAM_STRING &&
+                   strcmp(json_stream_container(js, 4), "message") == 0 &&
+                   strcmp(key, "text") == 0) {
+            copy_field(st->text, sizeof(st->text), value);
+        } else if (js->depth == 5 && strcmp(json_stream_container(js, 4), "message") == 0 &&
+                   strcmp(json_stream_container(js, 5), "chat") == 0 &&
+                   strcmp(key, "id") == 0) {
+            copy_field(st->chat, sizeof(st->chat), value);
+        }
+    }
+}
+
+static void on_object_end(void *ctx, const json_stream_t *js)
+{
+    telegram_updates_t *st = ctx;
+
+    if (js->depth != 3 || strcmp(json_stream_container(js, 2), "result") != 0) {
+        return;
+    }
+
+    // An update is complete; keep it if it is a command from our chat
+    if (st->text[0] == '/') {
+        if (strcmp(st->chat, st->chat_id) != 0) {
+            ESP_LOGW(TAG, "Ignoring command from chat %s", st->chat);
+        } else if (st->count < TELEGRAM_UPDATES_LIMIT) {
+            memcpy(st->commands[st->count++], st->text, sizeof(st->text));
+        }
+    }
+    st->chat[0] = '\0';
+    st->text[0] = '\0';
+}
+
+void telegram_updates_init(telegram_updates_t *updates, const char *chat_id)
+{
+    memset(updates, 0, sizeof(*updates));
+    updates->chat_id = chat_id;
+}
+
+long long telegram_updates_request_offset(const telegram_updates_t *updates)
+{
+    return updates->synced ? updates->offset : -1;
+}
+
+void telegram_updates_begin(telegram_updates_t *updates)
+{
+    const char *chat_id = updates->chat_id;
+    const long long offset = updates->offset;
+    const bool synced = updates->synced;
+
+    memset(updates, 0, sizeof(*updates));
+    updates->chat_id = chat_id;
+    updates->offset = offset;
+    updates->synced = synced;
+    json_stream_init(&updates->parser, on_value, on_object_end, updates);
+}
+
+bool telegram_updates_feed(telegram_updates_t *updates, const char *data, size_t len)
+{
+    return json_stream_feed(&updates->parser, data, len);
+}
+
+bool telegram_updates_finish(telegram_updates_t *updates)
+{
+    if (!json_stream_complete(&updates->parser) || !updates->ok) {
+        return false;
+    }
+
+    if (updates->next_offset > updates->offset) {
+        updates->offset = updates->next_offset;
+    }
+    if (!updates->synced) {
+        updates->synced = true;
+        if (updates->count > 0) {
+            ESP_LOGW(TAG, "Dropped commands sent before startup");
+        }
+        updates->count = 0;
+    }
+    return true;
+}
@@ -24,6 +24,7 @@ static const char *TAG = "wifi_manager";
 static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num = 0;
 static bool s_is_connected = false;
+static bool s_was_connected = false;
 static char s_ip_addr[16] = {0};
 static esp_netif_t *s_sta_netif = NULL;
 
@@ -34,10 +35,15 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         s_is_connected = false;
-        if (s_retry_num < WIFI_MAX_RETRY) {
+        // Once connected, keep trying for good so an outage is ridden out
+        if (s_was_connected || s_retry_num < WIFI_MAX_RETRY) {
             esp_wifi_connect();
             s_retry_num++;
-            ESP_LOGI(TAG, "Retrying WiFi connection (%d/%d)...", s_retry_num, WIFI_MAX_RETRY);
+            if (s_was_connected) {
+                ESP_LOGI(TAG, "Retrying WiFi connection (attempt %d)...", s_retry_num);
+            } else {
+                ESP_LOGI(TAG, "Retrying WiFi connection (%d/%d)...", s_retry_num, WIFI_MAX_RETRY);
+            }
         } else {
             xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
         }
@@ -48,6 +54,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "Got IP: %s", s_ip_addr);
         s_retry_num = 0;
         s_is_connected = true;
+        s_was_connected = true;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
@@ -0,0 +1,113 @@
+/**
+ * @file zone_store.c
+ * @brief Motion zones persisted in NVS
+ */
+
+#include "zone_store.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "zone_store";
+
+#define ZONE_NVS_NAMESPACE "motion"
+#define ZONE_NVS_KEY "zones"
+#define ZONE_BLOB_VERSION 1
+
+// Layout of the NVS blob; bump ZONE_BLOB_VERSION when it changes
+typedef struct {
+    uint8_t version;
+    motion_zone_config_t config;
+} zone_blob_t;
+
+esp_err_t zone_store_restore(void)
+{
+    nvs_handle_t handle;
+    zone_blob_t blob;
+    size_t len = sizeof(blob);
+    
+    esp_err_t ret = nvs_open(ZONE_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_get_blob(handle, ZONE_NVS_KEY, &blob, &len);
+        nvs_close(handle);
+    }
+    
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to read motion zones: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    if (len != sizeof(blob) || blob.version != ZONE_BLOB_VERSION) {
+        ESP_LOGW(TAG, "Ignoring saved motion zones with unknown layout");
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    ret = motion_detector_set_zones(&blob.config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Ignoring invalid saved motion zones");
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Restored %d motion zone(s)", blob.config.zone_count);
+    return ESP_OK;
+}
+
+esp_err_t zone_store_save(const motion_zone_config_t *config)
+{
+    nvs_handle_t handle;
+    zone_blob_t blob;
+    
+    esp_err_t ret = motion_detector_set_zones(config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    memset(&blob, 0, sizeof(blob));
+    blob.version = ZONE_BLOB_VERSION;
+    blob.config = *config;
+    
+    ret = nvs_open(ZONE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ret = nvs_set_blob(handle, ZONE_NVS_KEY, &blob, sizeof(blob));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save motion zones: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Saved %d motion zone(s)", config->zone_count);
+    return ESP_OK;
+}
+
+esp_err_t zone_store_clear(void)
+{
+    nvs_handle_t handle;
+    
+    motion_detector_set_zones(NULL);
+    
+    esp_err_t ret = nvs_open(ZONE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ret = nvs_erase_key(handle, ZONE_NVS_KEY);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = ESP_OK;
+    }
+    nvs_close(handle);
+    
+    return ret;
+}